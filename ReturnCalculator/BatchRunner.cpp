@@ -0,0 +1,282 @@
+//
+//  BatchRunner.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "BatchRunner.h"
+#include "PanelData.h"
+#include "MonthlyData.h"
+#include "CsvIO.h"
+#include "Resampling.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "ResultWriter.h"
+
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of BatchRunner class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This helper writes a number for a JSON status line, where NaN and infinity
+ * become null.
+ *
+ */
+static string number(double value) {
+	
+	if (!isfinite(value)) {
+		return "null";
+	}
+	
+	ostringstream written;
+	written << setprecision(17) << value;
+	return written.str();
+
+}
+
+/**
+ *
+ * This is default constructor of a batch without any job.
+ *
+ * @param s: settings shared by all jobs.
+ * @param directory: existing directory which output files are written into.
+ *
+ */
+BatchRunner::BatchRunner(const BatchSettings& s, const string& directory) {
+	
+	settings = s;
+	outputDirectory = directory;
+
+}
+
+/**
+ *
+ * This method adds a job for an input file. Output file is named after input file
+ * without directory and extension, and the job number is added if another job
+ * already uses the name. It ends as "result.csv" would in the output format,
+ * e.g. "_result.jsonl".
+ *
+ * @param inputFileName: path of input file.
+ *
+ */
+void BatchRunner::addInput(const string& inputFileName) {
+	
+	string stem = inputFileName.substr(inputFileName.find_last_of('/') + 1);
+	if (stem.find('.') != string::npos && stem.find_last_of('.') > 0) {
+		stem = stem.substr(0, stem.find_last_of('.'));
+	}
+	
+	BatchJob job;
+	job.inputFileName = inputFileName;
+	string suffix = getOutputSuffix(settings.format);
+	job.outputFileName = outputDirectory + "/" + stem + "_result" + suffix;
+	
+	for (const BatchJob& other : jobs) {
+		if (other.outputFileName == job.outputFileName) {
+			job.outputFileName = outputDirectory + "/" + stem + "_" + to_string(jobs.size() + 1) + "_result" + suffix;
+			break;
+		}
+	}
+	
+	jobs.push_back(job);
+
+}
+
+/**
+ *
+ * This method adds a job for every input file listed in a manifest file, one path
+ * per line. Empty lines and lines starting with "#" are skipped.
+ *
+ * @param manifestFileName: path of manifest file.
+ *
+ * return false if manifest file cannot be opened.
+ *
+ */
+bool BatchRunner::addManifest(const string& manifestFileName) {
+	
+	ifstream manifest(manifestFileName);
+	if (!manifest.is_open()) {
+		return false;
+	}
+	
+	string line;
+	while (getline(manifest, line)) {
+		
+		// Tolerate files saved with Windows line breaks.
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		
+		if (!line.empty() && line[0] != '#') {
+			addInput(line);
+		}
+	
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method is inspector to get number of jobs.
+ *
+ * return number of jobs added so far.
+ *
+ */
+unsigned long BatchRunner::size() const {
+	
+	return jobs.size();
+
+}
+
+/**
+ *
+ * This method is private. It runs one job from input file to output file, and
+ * prints its status line.
+ *
+ * @param index: index of the job.
+ * @param status: the stream receiving status lines.
+ *
+ * return true if output file was written.
+ *
+ */
+bool BatchRunner::runJob(unsigned long index, ostream& status) {
+	
+	const BatchJob& job = jobs[index];
+	auto start = chrono::steady_clock::now();
+	
+	vector<PeriodResult> results;
+	string message;
+	bool succeeded = false;
+	
+	try {
+		
+		PanelData panel;
+		
+		if (settings.longFormat) {
+			
+			LongCsvReader reader(job.inputFileName);
+			if (!reader.isOpen()) {
+				throw runtime_error("can't open " + job.inputFileName);
+			}
+			
+			LongMonth latest;
+			processLongInput(reader, settings.numBuckets, settings.allBuckets, results, latest);
+		
+		} else {
+			
+			PanelCache cache(job.inputFileName);
+			unsigned long inputSize = 0;
+			PanelSource source = loadPanel(job.inputFileName, settings.useStreamParser, settings.useCache ? &cache : nullptr, panel, inputSize);
+			
+			// A cache which can't be written only slows down later runs.
+			if (settings.useCache && source != PANEL_CACHE && !cache.save(panel)) {
+				message = "can't write panel cache " + cache.getCacheName();
+			}
+			
+			results = calculatePeriods(panel, settings.numBuckets, settings.allBuckets, nullptr, nullptr, nullptr, settings.strategy);
+		
+		}
+		
+		ResultWriter writer;
+		if (!writer.open(job.outputFileName)) {
+			throw runtime_error("can't write " + job.outputFileName);
+		}
+		
+		writeResults(writer, settings.format, results, settings.numBuckets, settings.allBuckets);
+		
+		if (!settings.longFormat && (settings.numBootstrap > 0 || settings.numPermutations > 0)) {
+			
+			Resampling resampling(panel, settings.numBuckets, results);
+			resampling.setBlockLength(settings.blockLength);
+			resampling.setSeed(settings.seed);
+			
+			if (settings.numBootstrap > 0) {
+				resampling.bootstrap(settings.numBootstrap, nullptr);
+			}
+			if (settings.numPermutations > 0) {
+				resampling.permute(settings.numPermutations, nullptr);
+			}
+			
+			resampling.writeCsv(writer, results.size() + 1);
+		}
+		
+		if (!writer.close()) {
+			throw runtime_error("can't write " + job.outputFileName);
+		}
+		
+		succeeded = true;
+	
+	} catch (const exception& error) {
+		message = error.what();
+	}
+	
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	
+	double average = 0;
+	for (const PeriodResult& result : results) {
+		average += result.average;
+	}
+	average /= static_cast<double>(results.size());
+	
+	ostringstream line;
+	line << "{\"job\":" << index + 1 << ",\"input\":" << quoteJson(job.inputFileName) << ",\"output\":" << quoteJson(job.outputFileName);
+	line << ",\"status\":" << (succeeded ? "\"ok\"" : "\"error\"") << ",\"message\":" << quoteJson(message);
+	line << ",\"periods\":" << results.size() << ",\"average\":" << (succeeded ? number(average) : "null");
+	line << ",\"seconds\":" << number(elapsed.count()) << "}\n";
+	
+	lock_guard<mutex> lock(statusMutex);
+	status << line.str() << flush;
+	
+	return succeeded;
+
+}
+
+/**
+ *
+ * This method runs all jobs. Workers take the next job as soon as they finish
+ * one, so at most numWorkers files are processed at a time.
+ *
+ * @param numWorkers: number of worker threads, at least 1.
+ * @param status: the stream receiving one status line per job, in order of completion.
+ *
+ * return number of failed jobs.
+ *
+ */
+unsigned long BatchRunner::run(unsigned long numWorkers, ostream& status) {
+	
+	vector<unsigned char> succeeded(jobs.size(), 0);
+	
+	ThreadPool pool(max(1UL, numWorkers));
+	pool.parallelFor(jobs.size(), [this, &succeeded, &status](unsigned long index) {
+		succeeded[index] = runJob(index, status);
+	});
+	
+	unsigned long failed = 0;
+	for (const unsigned char& ok : succeeded) {
+		if (!ok) {
+			failed++;
+		}
+	}
+	
+	return failed;
+
+}
@@ -0,0 +1,118 @@
+//
+//  BatchRunner.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef BatchRunner_h
+#define BatchRunner_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <mutex>
+#include "ResultWriter.h"
+#include "Strategy.h"
+
+using namespace std;
+
+/**
+ *
+ * Batch runner class header code:
+ *
+ * This header file defines the runner which processes many input files in one
+ * run without any prompt, e.g. one file per universe of stocks.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This struct keeps settings shared by all jobs of a batch.
+ *
+ */
+struct BatchSettings {
+	
+	// Input format and how wide format input is loaded.
+	bool longFormat;
+	bool useStreamParser;
+	bool useCache;
+	
+	// Number of buckets, and whether results of every bucket are written.
+	unsigned long numBuckets;
+	bool allBuckets;
+	
+	// Direction and legs of the portfolio built from top and bottom buckets.
+	Strategy strategy;
+	
+	// Significance tests, none if numbers of replications are 0.
+	unsigned long numBootstrap;
+	unsigned long numPermutations;
+	unsigned long blockLength;
+	unsigned long seed;
+	
+	// Format of output files.
+	OutputFormat format;
+
+};
+
+
+/**
+ *
+ * This class runs one job per input file on a bounded number of worker threads.
+ *
+ * Each job reads its input file, calculates results of every period and writes
+ *	them into its own output file, so jobs never share output. While one job
+ *	waits for its file to be read, other workers keep computing, so file I/O of
+ *	one job overlaps computation of another.
+ * A job processes its months serially, as jobs already keep all workers busy.
+ * When a job ends, one status line in JSON is printed, with fields "job", "input",
+ *	"output", "status" ("ok" or "error"), "message", "periods", "average" and
+ *	"seconds". A failed job does not stop the others.
+ *
+ */
+class BatchRunner {
+
+private:
+	
+	// One input file and its output file.
+	struct BatchJob {
+		string inputFileName;
+		string outputFileName;
+	};
+	
+	BatchSettings settings;
+	string outputDirectory;
+	vector<BatchJob> jobs;
+	
+	// Serializes status lines of jobs ending at the same time.
+	mutex statusMutex;
+	
+	// The method runs one job, returns true if it succeeded.
+	bool runJob(unsigned long index, ostream& status);
+
+public:
+	
+	// A default constructor specifying settings of all jobs and directory of output files.
+	BatchRunner(const BatchSettings& s, const string& directory);
+	
+	// The method adds a job, whose output is e.g. "<input file name without extension>_result.csv".
+	void addInput(const string& inputFileName);
+	
+	// The method adds a job for every line of a manifest file, returns false if it can't be read.
+	bool addManifest(const string& manifestFileName);
+	
+	// Inspector for number of jobs.
+	unsigned long size() const;
+	
+	// The method runs all jobs on numWorkers threads, returns number of failed jobs.
+	unsigned long run(unsigned long numWorkers, ostream& status);
+
+};
+
+
+#endif /* BatchRunner_h */
@@ -0,0 +1,319 @@
+//
+//  Benchmark.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <sys/resource.h>
+#include "PanelData.h"
+#include "MonthlyData.h"
+#include "CsvReader.h"
+#include "CsvIO.h"
+#include "PanelGenerator.h"
+
+using namespace std;
+
+/**
+ *
+ * This file contains the benchmark of the whole process on synthetic panels.
+ *
+ * For each panel size, a panel is generated and written as an input csv file.
+ * Then stages of the program are timed separately: line based parsing by
+ * parseInput(), memory-mapped parsing, ranking and looking up next month's return
+ * rates of selected stocks by MonthlyData::getMonthReturn(), and writeResults(). Throughput of
+ * each stage, number of heap allocations made by memory-mapped parsing, and peak
+ * resident memory of the process so far are reported.
+ *
+ * Usage: returnBench [--symbols N --months M] [--missing R] [--dist normal|t|uniform]
+ *                    [--decimals D] [--seed S] [--buckets N] [--write FILE]
+ * Without "--symbols" and "--months", a suite of sizes is run. With "--write FILE",
+ * the generated panel is only written into FILE, so it can be fed to returnCalc.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Temporary files of the benchmark, removed after each size.
+static const char* inputFileName = "./bench_input.csv";
+static const char* outputFileName = "./bench_result.csv";
+
+
+// Number of heap allocations made through operator new so far.
+static atomic<unsigned long> numAllocations(0);
+
+
+/**
+ *
+ * Global operator new and delete of the benchmark count allocations, so stages
+ * which allocate per symbol or per cell show up. Array forms call these ones.
+ *
+ */
+void* operator new(size_t size) {
+	
+	numAllocations.fetch_add(1, memory_order_relaxed);
+	
+	if (void* memory = malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw bad_alloc();
+
+}
+
+// Both deletes free memory of the operator new above. GCC sees free() called on a
+// pointer of the library's operator new once they are inlined into containers, and
+// warns about a mismatch, which doesn't apply to a replaced pair.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* memory) noexcept {
+	
+	free(memory);
+
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	
+	free(memory);
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+/**
+ *
+ * This function gets peak resident memory of the process.
+ *
+ * return peak resident memory in MB.
+ *
+ */
+double peakMemory() {
+	
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+	// Reported in bytes on macOS.
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	// Reported in KB on Linux.
+	return usage.ru_maxrss / 1024.0;
+#endif
+
+}
+
+
+/**
+ *
+ * This function returns seconds elapsed since a start time.
+ *
+ */
+double secondsSince(chrono::steady_clock::time_point start) {
+	
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+
+/**
+ *
+ * This function benchmarks all stages on one generated panel, and prints one line
+ * of results.
+ *
+ * @param generator: generator of the panel.
+ * @param numSymbols: number of symbols of the panel.
+ * @param numMonths: number of months of the panel.
+ * @param numBuckets: number of buckets.
+ * @param allBuckets: whether to calculate results of every bucket.
+ *
+ * return false if a temporary file cannot be written or read.
+ *
+ */
+bool runSize(const PanelGenerator& generator, unsigned long numSymbols, unsigned long numMonths, unsigned long numBuckets, bool allBuckets) {
+	
+	{
+		ofstream input(inputFileName);
+		if (!input.is_open()) {
+			return false;
+		}
+		generator.writeCsv(input);
+	}
+	
+	// Line based parser.
+	PanelData streamPanel;
+	ifstream input(inputFileName);
+	if (!input.is_open()) {
+		return false;
+	}
+	
+	auto start = chrono::steady_clock::now();
+	parseInput(input, streamPanel);
+	double streamTime = secondsSince(start);
+	
+	input.clear();
+	input.seekg(0, ios::end);
+	double megabytes = static_cast<double>(input.tellg()) / (1024.0 * 1024.0);
+	input.close();
+	
+	// Memory-mapped parser, whose panel is used by following stages.
+	PanelData panel;
+	CsvReader reader(inputFileName);
+	if (!reader.isOpen()) {
+		return false;
+	}
+	
+	unsigned long startAllocations = numAllocations.load();
+	start = chrono::steady_clock::now();
+	reader.parse(panel);
+	double mmapTime = secondsSince(start);
+	unsigned long parseAllocations = numAllocations.load() - startAllocations;
+	
+	vector<MonthlyData> allData;
+	for (unsigned long m = 0; m < panel.getNumMonths(); m++) {
+		allData.push_back(MonthlyData(panel, m));
+		allData.back().setBuckets(numBuckets, allBuckets);
+	}
+	
+	// Ranking and lookup of every formation month, as run by the program.
+	start = chrono::steady_clock::now();
+	for (unsigned long m = 0; m + 1 < allData.size(); m++) {
+		allData[m].getMonthReturn(allData[m + 1]);
+	}
+	double monthTime = secondsSince(start);
+	
+	vector<PeriodResult> results;
+	for (unsigned long m = 0; m + 1 < allData.size(); m++) {
+		results.push_back(allData[m].getResult());
+	}
+	
+	ResultWriter writer;
+	if (!writer.open(outputFileName)) {
+		return false;
+	}
+	
+	start = chrono::steady_clock::now();
+	writeResults(writer, CSV_OUTPUT, results, numBuckets, allBuckets);
+	writer.close();
+	double writeTime = secondsSince(start);
+	
+	remove(inputFileName);
+	remove(outputFileName);
+	
+	// Stocks ranked, in millions.
+	double stocks = numSymbols * (numMonths - 1) / 1e6;
+	
+	cout << setw(8) << numSymbols << setw(8) << numMonths << setw(10) << megabytes;
+	cout << setw(12) << megabytes / streamTime << setw(12) << megabytes / mmapTime;
+	cout << setw(12) << stocks / monthTime;
+	cout << setw(12) << results.size() / writeTime << setw(14) << parseAllocations << setw(10) << peakMemory() << endl;
+	
+	return true;
+
+}
+
+
+// Main entry point of the benchmark.
+int main(int argc, const char * argv[]) {
+	
+	// Suite of panel sizes, from provided input file size to a large universe.
+	vector<pair<unsigned long, unsigned long>> sizes = {{500, 60}, {2000, 120}, {5000, 240}, {20000, 360}};
+	
+	unsigned long numSymbols = 0, numMonths = 0, numBuckets = 10, seed = 2016;
+	bool allBuckets = false;
+	double missingRate = 0.02;
+	int decimals = 4;
+	PanelGenerator::Distribution distribution = PanelGenerator::NORMAL;
+	string writeFileName;
+	
+	for (int i = 1; i < argc; i++) {
+		
+		string option = argv[i];
+		
+		if (option == "--symbols" && i + 1 < argc) {
+			numSymbols = stoul(argv[++i]);
+		} else if (option == "--months" && i + 1 < argc) {
+			numMonths = stoul(argv[++i]);
+		} else if (option == "--missing" && i + 1 < argc) {
+			missingRate = stod(argv[++i]);
+		} else if (option == "--dist" && i + 1 < argc) {
+			if (!PanelGenerator::parseDistribution(argv[++i], distribution)) {
+				cout << "Unknown distribution: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (option == "--decimals" && i + 1 < argc) {
+			decimals = stoi(argv[++i]);
+		} else if (option == "--seed" && i + 1 < argc) {
+			seed = stoul(argv[++i]);
+		} else if (option == "--buckets" && i + 1 < argc) {
+			numBuckets = max(1UL, stoul(argv[++i]));
+			allBuckets = true;
+		} else if (option == "--write" && i + 1 < argc) {
+			writeFileName = argv[++i];
+		} else {
+			cout << "Unknown option: " << option << endl;
+			return 1;
+		}
+	
+	}
+	
+	if (numSymbols > 0 || numMonths > 0) {
+		sizes = {{max(1UL, numSymbols), max(2UL, numMonths)}};
+	}
+	
+	// All sizes share the same settings.
+	auto makeGenerator = [&](const pair<unsigned long, unsigned long>& size) {
+		PanelGenerator generator(size.first, size.second);
+		generator.setMissingRate(missingRate);
+		generator.setDistribution(distribution, 0.1, 0.05);
+		generator.setDecimals(decimals);
+		generator.setSeed(seed);
+		return generator;
+	};
+	
+	if (!writeFileName.empty()) {
+		
+		PanelGenerator generator = makeGenerator(sizes.front());
+		
+		ofstream output(writeFileName);
+		if (!output.is_open()) {
+			cout << "Can't write output file: " << writeFileName << endl;
+			return 1;
+		}
+		
+		generator.writeCsv(output);
+		return 0;
+	}
+	
+	cout << setw(8) << "symbols" << setw(8) << "months" << setw(10) << "MB";
+	cout << setw(12) << "stream MB/s" << setw(12) << "mmap MB/s";
+	cout << setw(12) << "month M/s";
+	cout << setw(12) << "write per/s" << setw(14) << "parse allocs" << setw(10) << "peak MB" << endl;
+	cout << fixed << setprecision(1);
+	
+	for (const pair<unsigned long, unsigned long>& size : sizes) {
+		
+		if (!runSize(makeGenerator(size), size.first, size.second, numBuckets, allBuckets)) {
+			cout << "Can't write temporary files under current directory." << endl;
+			return 1;
+		}
+	
+	}
+	
+	return 0;
+}
@@ -0,0 +1,404 @@
+//
+//  Calendar.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Calendar.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of Calendar class, and parsing and formatting of dates.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Abbreviated month names used by monthly input files.
+static const char* monthNames[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+/**
+ *
+ * This helper reads a number of at most maxDigits digits.
+ *
+ * @param cur: start of the number, moved past its digits.
+ * @param last: end of the text.
+ * @param maxDigits: largest number of digits.
+ * @param value: output parameter receiving the number.
+ *
+ * return number of digits read, 0 if there is no digit.
+ *
+ */
+static unsigned long readDigits(const char*& cur, const char* last, unsigned long maxDigits, unsigned long& value) {
+	
+	unsigned long numDigits = 0;
+	value = 0;
+	
+	while (cur < last && numDigits < maxDigits && isdigit(static_cast<unsigned char>(*cur))) {
+		value = value * 10 + (*cur - '0');
+		++cur;
+		++numDigits;
+	}
+	
+	return numDigits;
+
+}
+
+/**
+ *
+ * This helper gets number of days in a month of the Gregorian calendar.
+ *
+ */
+static unsigned long daysInMonth(unsigned long year, unsigned long month) {
+	
+	static const unsigned long days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	
+	return month == 2 && leap ? 29 : days[month - 1];
+
+}
+
+/**
+ *
+ * This helper counts days from 1970-01-01 to a date, negative before it. The first
+ * day of the month is taken for monthly dates.
+ *
+ */
+static long dayNumber(CalendarDate date) {
+	
+	long year = date / 10000;
+	long month = date / 100 % 100;
+	long day = max(1L, static_cast<long>(date % 100));
+	
+	// Years start in March, so the leap day is the last day of a year.
+	year -= month <= 2 ? 1 : 0;
+	long era = (year >= 0 ? year : year - 399) / 400;
+	long yearOfEra = year - era * 400;
+	long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	
+	return era * 146097 + dayOfEra - 719468;
+
+}
+
+/**
+ *
+ * This function parses a date cell. Monthly dates are "16-Mar", where a year of two
+ * digits is in 1969 to 2068 as by strptime(), or "2016-03". Daily and weekly dates
+ * are "2016-03-16". Months and days may have one digit.
+ *
+ * @param first: start of the cell.
+ * @param last: end of the cell.
+ * @param date: output parameter receiving the date.
+ *
+ * return false if the cell is not a valid date.
+ *
+ */
+bool parseDate(const char* first, const char* last, CalendarDate& date) {
+	
+	const char* cur = first;
+	unsigned long year = 0, month = 0, day = 0;
+	
+	unsigned long yearDigits = readDigits(cur, last, 4, year);
+	if (yearDigits == 0 || yearDigits == 3 || cur == last || *cur != '-') {
+		return false;
+	}
+	++cur;
+	
+	if (yearDigits <= 2) {
+		
+		if (last - cur != 3) {
+			return false;
+		}
+		
+		for (unsigned long m = 0; m < 12 && month == 0; m++) {
+			if (tolower(cur[0]) == tolower(monthNames[m][0]) && tolower(cur[1]) == tolower(monthNames[m][1]) && tolower(cur[2]) == tolower(monthNames[m][2])) {
+				month = m + 1;
+			}
+		}
+		
+		year += year < 69 ? 2000 : 1900;
+	
+	} else {
+		
+		if (readDigits(cur, last, 2, month) == 0 || month < 1 || month > 12) {
+			return false;
+		}
+		
+		if (cur < last) {
+			
+			if (*cur != '-' || readDigits(++cur, last, 2, day) == 0 || day < 1 || day > daysInMonth(year, month)) {
+				return false;
+			}
+		
+		}
+		
+		if (cur != last) {
+			return false;
+		}
+	
+	}
+	
+	if (month == 0) {
+		return false;
+	}
+	
+	date = static_cast<CalendarDate>(year * 10000 + month * 100 + day);
+	
+	return true;
+
+}
+
+/**
+ *
+ * This function formats a date for output files.
+ *
+ * @param date: the date.
+ *
+ * return "16-Mar" for a monthly date, or "2016-03-16" otherwise.
+ *
+ */
+string formatDate(CalendarDate date) {
+	
+	unsigned long year = date / 10000;
+	unsigned long month = date / 100 % 100;
+	unsigned long day = date % 100;
+	
+	char text[16];
+	if (day == 0) {
+		snprintf(text, sizeof(text), "%02lu-%s", year % 100, monthNames[(month + 11) % 12]);
+	} else {
+		snprintf(text, sizeof(text), "%04lu-%02lu-%02lu", year, month, day);
+	}
+	
+	return text;
+
+}
+
+/**
+ *
+ * This function parses the rebalancing frequency given on command line.
+ *
+ * @param name: "weekly", "monthly", "quarterly", "yearly", or a positive number N
+ *			to rebalance every N periods of input data.
+ * @param frequency: output parameter receiving the frequency.
+ * @param every: output parameter receiving N, or 1 for calendar frequencies.
+ *
+ * return false if the name is not a frequency.
+ *
+ */
+bool parseRebalance(const string& name, RebalanceFrequency& frequency, unsigned long& every) {
+	
+	every = 1;
+	
+	if (name == "weekly") {
+		frequency = WEEKLY_REBALANCE;
+	} else if (name == "monthly") {
+		frequency = MONTHLY_REBALANCE;
+	} else if (name == "quarterly") {
+		frequency = QUARTERLY_REBALANCE;
+	} else if (name == "yearly") {
+		frequency = YEARLY_REBALANCE;
+	} else {
+		
+		const char* cur = name.c_str();
+		if (readDigits(cur, cur + name.size(), 9, every) != name.size() || every == 0) {
+			return false;
+		}
+		
+		frequency = PERIOD_REBALANCE;
+	
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This is default constructor of a calendar without any period.
+ *
+ */
+Calendar::Calendar() {
+	
+	increasing = true;
+
+}
+
+/**
+ *
+ * This method appends the date of a period after all existing periods.
+ *
+ * @param date: the date.
+ *
+ * return index of the period.
+ *
+ */
+unsigned long Calendar::add(CalendarDate date) {
+	
+	if (!dates.empty() && date <= dates.back()) {
+		increasing = false;
+	}
+	
+	dates.push_back(date);
+	
+	return dates.size() - 1;
+
+}
+
+/**
+ *
+ * These methods are inspectors for number of periods, and date and formatted label
+ * of a period.
+ *
+ */
+unsigned long Calendar::size() const {
+	
+	return dates.size();
+
+}
+
+CalendarDate Calendar::getDate(unsigned long index) const {
+	
+	return dates[index];
+
+}
+
+string Calendar::getLabel(unsigned long index) const {
+	
+	return formatDate(dates[index]);
+
+}
+
+/**
+ *
+ * This method finds the period of a date.
+ *
+ * @param date: the date.
+ * @param index: output parameter receiving index of the period.
+ *
+ * return false if no period has the date.
+ *
+ */
+bool Calendar::find(CalendarDate date, unsigned long& index) const {
+	
+	vector<CalendarDate>::const_iterator found;
+	if (increasing) {
+		found = lower_bound(dates.begin(), dates.end(), date);
+	} else {
+		found = std::find(dates.begin(), dates.end(), date);
+	}
+	
+	if (found == dates.end() || *found != date) {
+		return false;
+	}
+	
+	index = found - dates.begin();
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method splits the periods into rebalancing periods, each ending at its last
+ * period. Calendar frequencies end a rebalancing period wherever the next date is in
+ * another week (starting on Monday), month, quarter or year, and the latest one ends
+ * at the latest date. Every N periods counts from the earliest period, and periods
+ * after the last full N are left out.
+ *
+ * @param frequency: the rebalancing frequency.
+ * @param every: N for PERIOD_REBALANCE.
+ *
+ * return indexes of the last period of every rebalancing period, in increasing order.
+ *
+ */
+vector<unsigned long> Calendar::getRebalanceEnds(RebalanceFrequency frequency, unsigned long every) const {
+	
+	vector<unsigned long> ends;
+	
+	if (frequency == PERIOD_REBALANCE) {
+		
+		for (unsigned long i = max(1UL, every); i <= dates.size(); i += max(1UL, every)) {
+			ends.push_back(i - 1);
+		}
+		
+		return ends;
+	}
+	
+	// Key of the rebalancing period of a date, equal for dates in the same one.
+	auto key = [frequency](CalendarDate date) {
+		
+		long year = date / 10000;
+		long month = date / 100 % 100;
+		
+		switch (frequency) {
+			case WEEKLY_REBALANCE:
+				// 1970-01-01 was a Thursday, and whole weeks keep the key positive.
+				return (dayNumber(date) + 3 + 7 * 1000000L) / 7;
+			case QUARTERLY_REBALANCE:
+				return year * 4 + (month - 1) / 3;
+			case YEARLY_REBALANCE:
+				return year;
+			default:
+				return year * 12 + month;
+		}
+	
+	};
+	
+	for (unsigned long i = 0; i < dates.size(); i++) {
+		if (i + 1 == dates.size() || key(dates[i]) != key(dates[i + 1])) {
+			ends.push_back(i);
+		}
+	}
+	
+	return ends;
+
+}
+
+/**
+ *
+ * This method estimates how many periods there are in a year, to annualize
+ * statistics. The median number of days between consecutive dates is matched to
+ * trading days (252 per year), weeks, months, quarters or years.
+ *
+ * return periods per year, 12 if there are less than two dates.
+ *
+ */
+double Calendar::getPeriodsPerYear() const {
+	
+	if (dates.size() < 2) {
+		return 12;
+	}
+	
+	vector<long> gaps;
+	gaps.reserve(dates.size() - 1);
+	for (unsigned long i = 1; i < dates.size(); i++) {
+		gaps.push_back(labs(dayNumber(dates[i]) - dayNumber(dates[i - 1])));
+	}
+	
+	nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+	long gap = gaps[gaps.size() / 2];
+	
+	if (gap <= 4) {
+		return 252;
+	} else if (gap <= 10) {
+		return 52;
+	} else if (gap <= 45) {
+		return 12;
+	} else if (gap <= 135) {
+		return 4;
+	}
+	
+	return 1;
+
+}
@@ -0,0 +1,101 @@
+//
+//  Calendar.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Calendar_h
+#define Calendar_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ *
+ * Calendar class header code:
+ *
+ * This header file defines dates of periods as compact integers, and the
+ * calendar of all periods of a panel, which may be monthly, weekly or daily.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+// A date as integer yyyymmdd, e.g. 20160316. Dates of monthly data have day 0,
+// e.g. "16-Mar" is 20160300, so dates of any frequency compare as integers.
+typedef uint32_t CalendarDate;
+
+// Frequencies stocks can be rebalanced at, either every N periods of input data or
+// at the last period of every calendar week, month, quarter or year.
+enum RebalanceFrequency {
+	PERIOD_REBALANCE,
+	WEEKLY_REBALANCE,
+	MONTHLY_REBALANCE,
+	QUARTERLY_REBALANCE,
+	YEARLY_REBALANCE
+};
+
+// The function parses a date in format of "16-Mar", "2016-03" or "2016-03-16", returns false if it is none of them.
+bool parseDate(const char* first, const char* last, CalendarDate& date);
+
+// The function formats a date, monthly ones as "16-Mar" and daily ones as "2016-03-16".
+string formatDate(CalendarDate date);
+
+// The function parses "weekly", "monthly", "quarterly", "yearly" or a number of periods, returns false otherwise.
+bool parseRebalance(const string& name, RebalanceFrequency& frequency, unsigned long& every);
+
+
+/**
+ *
+ * This class keeps dates of all periods of a panel in chronological order, four
+ * bytes per period, so tens of thousands of daily periods are cheap to keep,
+ * compare and look up. Labels are only formatted when written.
+ *
+ * A date is found by binary search as long as dates are added in increasing
+ *	order, otherwise by scanning all dates.
+ * Periods are grouped into rebalancing periods by calendar, e.g. every month of
+ *	daily data ends at its last trading day in the data.
+ *
+ */
+class Calendar {
+
+private:
+	
+	// Date of every period, earliest first.
+	vector<CalendarDate> dates;
+	
+	// Whether every date is later than the one before.
+	bool increasing;
+
+public:
+	
+	// A default constructor of a calendar without any period.
+	Calendar();
+	
+	// The mutator to append the date of a new latest period, returns its index.
+	unsigned long add(CalendarDate date);
+	
+	// Inspectors for number of periods, and date and label of a period.
+	unsigned long size() const;
+	CalendarDate getDate(unsigned long index) const;
+	string getLabel(unsigned long index) const;
+	
+	// The method finds the period of a date, returns false if there is none.
+	bool find(CalendarDate date, unsigned long& index) const;
+	
+	// The method lists indexes of the last period of every rebalancing period.
+	vector<unsigned long> getRebalanceEnds(RebalanceFrequency frequency, unsigned long every) const;
+	
+	// The method estimates number of periods per year from typical distance between dates.
+	double getPeriodsPerYear() const;
+
+};
+
+
+#endif /* Calendar_h */
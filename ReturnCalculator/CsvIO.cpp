@@ -0,0 +1,665 @@
+//
+//  CsvIO.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/2.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "CsvIO.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include "CsvReader.h"
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains the input parsers and the writers of result files,
+ * which are shared by main program, batch jobs and benchmark.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Magic bytes of binary result files, including format version.
+static const char resultMagic[8] = {'R', 'C', 'R', 'E', 'S', 'L', 'T', '1'};
+
+/**
+ *
+ * This function accepts input file stream and parse the text data, converts 
+ * data into a panel of return rates. Input file lists latest month first, while
+ * the panel keeps months in chronological order.
+ *
+ * @param inputFile: an opened ifstream object. This function does not check if 
+ *			it is open or not, please check it in main function.
+ * @param panel: an empty panel to be filled with parsed data.
+ *
+ * This function does not return any value.
+ *
+ */
+void parseInput(ifstream& inputFile, PanelData& panel) {
+	
+	PROFILE_STAGE(PARSE);
+	
+	// Template string stores each line in csv file.
+	string line;
+	unsigned long numRows = 0, numCells = 0, numMissing = 0;
+	
+	// Dates are parsed the same as by the memory-mapped parser, which also adds
+	// them backwards, as input columns run from latest to earliest month.
+	getline(inputFile, line);
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	
+	CsvReader::parseHeader(line.data(), line.data() + line.size(), panel);
+	unsigned long numMonths = panel.getNumMonths();
+	int lineSize;
+	
+	// Process of real data till to the end of input file.
+	while (getline(inputFile, line)) {
+		int left = 0, right = 0;
+		lineSize = static_cast<int>(line.size());
+		
+		// Skip empty lines.
+		if (line.empty() || line[0] == ',') {
+			continue;
+		}
+		
+		bool hasSymbol = false;
+		unsigned long symbolId = 0;
+		unsigned long column = 0;
+		while (right <= lineSize) {
+			
+			if (right == lineSize || line[right] == ',') {
+				
+				string content = line.substr(left, right - left);
+				
+				// Handle different new line character in Windows and Linux/Unix.
+				if (!content.empty() && content.back() == '\r') {
+					content.pop_back();
+				}
+				
+				// Set stock symbol or return rate.
+				if (!hasSymbol) {
+					symbolId = panel.addSymbol(content);
+					hasSymbol = true;
+					++numRows;
+				} else if (column < numMonths) {
+					
+					// Insert parsed data into the panel, first column is the latest month.
+					// Data marked as "#N/A" and empty cells are kept as 0 and marked missing.
+					if (!content.empty() && content != "#N/A") {
+						// Return rate conversion.
+						panel.setReturn(symbolId, numMonths - 1 - column, stod(content));
+					} else {
+						panel.setMissing(symbolId, numMonths - 1 - column);
+						++numMissing;
+					}
+					++column;
+					++numCells;
+				}
+				
+				left = ++right;
+			
+			} else {
+				right++;
+			}
+		}
+	}
+	
+	PROFILE_COUNT(ROWS_PARSED, numRows);
+	PROFILE_COUNT(CELLS_PARSED, numCells);
+	PROFILE_COUNT(MISSING_CELLS, numMissing);
+	
+	panel.transpose();
+}
+
+
+/**
+ *
+ * This function fills a panel from a valid cache of input file if there is one,
+ * otherwise by parsing input file with the selected parser. The cache is not
+ * saved here, so callers decide how to report a failure.
+ *
+ * @param inputFileName: path of wide format input file.
+ * @param useStreamParser: true for the line based parser, false for the memory-mapped one.
+ * @param cache: the cache of input file to be tried first, or null.
+ * @param panel: an empty panel to be filled.
+ * @param inputSize: receives number of bytes read, for throughput report.
+ *
+ * return how the panel was loaded. It throws runtime_error if input file cannot be
+ * opened or is malformed.
+ *
+ */
+PanelSource loadPanel(const string& inputFileName, bool useStreamParser, PanelCache* cache, PanelData& panel, unsigned long& inputSize) {
+	
+	if (cache != nullptr && cache->load(panel)) {
+		inputSize = cache->getSize();
+		return PANEL_CACHE;
+	}
+	
+	if (useStreamParser) {
+		
+		ifstream inputFile(inputFileName);
+		if (!inputFile.is_open()) {
+			throw runtime_error("can't open " + inputFileName);
+		}
+		
+		parseInput(inputFile, panel);
+		
+		inputFile.clear();
+		inputFile.seekg(0, ios::end);
+		inputSize = static_cast<unsigned long>(inputFile.tellg());
+		
+		return STREAM_PARSER;
+	}
+	
+	CsvReader reader(inputFileName);
+	if (!reader.isOpen()) {
+		throw runtime_error("can't map " + inputFileName);
+	}
+	
+	reader.parse(panel);
+	inputSize = reader.getSize();
+	
+	return MMAP_PARSER;
+
+}
+
+
+/**
+ *
+ * This function reads long format input month by month. As soon as the month after
+ * a formation month is read, both are put into a panel of two months, and results
+ * of the formation month are calculated and kept. Then the panel is released and
+ * the month after becomes next formation month.
+ *
+ * @param reader: an opened reader of long format input. This function does not check
+ *			if it is open or not, please check it in main function.
+ * @param numBuckets: number of buckets stocks are split into.
+ * @param allBuckets: whether to calculate results of every bucket.
+ * @param results: receives results of every period in chronological order.
+ * @param latest: receives return rates of the latest month.
+ *
+ * This function does not return any value. It throws runtime_error on malformed input.
+ *
+ */
+void processLongInput(LongCsvReader& reader, unsigned long numBuckets, bool allBuckets, vector<PeriodResult>& results, LongMonth& latest) {
+	
+	vector<long> holdingSlots;
+	
+	LongMonth& formation = latest;
+	LongMonth holding;
+	if (!reader.readMonth(formation)) {
+		return;
+	}
+	
+	while (reader.readMonth(holding)) {
+		
+		PanelData window;
+		LongCsvReader::makeWindow(reader.getSymbols(), formation, holding, window, holdingSlots);
+		
+		MonthlyData formationMonth(window, 0), holdingMonth(window, 1);
+		formationMonth.setBuckets(numBuckets, allBuckets);
+		formationMonth.getMonthReturn(holdingMonth);
+		results.push_back(formationMonth.getResult());
+		
+		swap(formation, holding);
+	}
+
+}
+
+
+/**
+ *
+ * This function is private to this file. It writes a double for JSON, where NaN
+ * and infinity become null.
+ *
+ */
+static void appendJsonNumber(ResultWriter& writer, double value) {
+	
+	if (isfinite(value)) {
+		writer.appendNumber(value);
+	} else {
+		writer.append("null", 4);
+	}
+
+}
+
+/**
+ *
+ * This funciton accepts results of processed months and output file stream to write csv file.
+ * Every row is one series, e.g. average return of top bucket, and every column
+ * one period.
+ *
+ * @param writer: the writer of output file. This function does not check if it
+ *			is opened, please check in main function.
+ * @param results: results of every period with calculated average return rates, in
+ *			chronological order. Latest month has no period, as it has no next month.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param allBuckets: whether results of every bucket were calculated.
+ *
+ * This function does not return any value.
+ *
+ */
+static void writeCsv(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets) {
+	
+	// All data are generated by prevously appointed csv format.
+	int numMonth = static_cast<int>(results.size()) + 1;
+	
+	// Please note latest month is omitted since average cannot be
+	// generated without a later month's data. Months are written from
+	// latest to earliest, matching the input file.
+	writer.append("Period");
+	for (int m = numMonth - 2; m >= 0; m--) {
+		writer.append(',');
+		writer.append(results[m].date);
+	}
+	writer.append('\n');
+	
+	// Bucket size in percent, e.g. "10" with default ten buckets.
+	ostringstream percent;
+	percent << 100.0 / numBuckets;
+	
+	writer.append("Average return of first " + percent.str() + "% percentile/each period");
+	for (int m = numMonth - 2; m >= 0; m--) {
+		writer.append(',');
+		writer.appendNumber(results[m].topAverage);
+	}
+	writer.append('\n');
+	
+	writer.append("Average return of last " + percent.str() + "% percentile/each period");
+	for (int m = numMonth - 2; m >= 0; m--) {
+		writer.append(',');
+		writer.appendNumber(results[m].bottomAverage);
+	}
+	writer.append('\n');
+	
+	double finalAverage = 0;
+	
+	writer.append("Total average return/each period");
+	for (int m = numMonth - 2; m >= 0; m--) {
+		writer.append(',');
+		writer.appendNumber(results[m].average);
+		finalAverage += results[m].average;
+	}
+	writer.append('\n');
+	
+	for (int i = 1; i < numMonth; i++) {
+		writer.append(',');
+	}
+	writer.append('\n');
+	
+	finalAverage /= numMonth - 1;
+	writer.append("Total average return of all period,");
+	writer.appendNumber(finalAverage);
+	
+	for (int i = 2; i < numMonth; i++) {
+		writer.append(',');
+	}
+	writer.append('\n');
+	
+	// Results of every bucket, bucket 1 has highest return rates in formation month.
+	if (!allBuckets) {
+		return;
+	}
+	
+	for (int i = 1; i < numMonth; i++) {
+		writer.append(',');
+	}
+	writer.append('\n');
+	
+	string ofBuckets = " of " + to_string(numBuckets) + "/each period";
+	
+	for (unsigned long b = 0; b < numBuckets; b++) {
+		
+		writer.append("Average return of bucket " + to_string(b + 1) + ofBuckets);
+		for (int m = numMonth - 2; m >= 0; m--) {
+			writer.append(',');
+			writer.appendNumber(results[m].bucketAverages[b]);
+		}
+		writer.append('\n');
+	
+	}
+	
+	for (unsigned long b = 0; b < numBuckets; b++) {
+		
+		writer.append("Number of stocks in bucket " + to_string(b + 1) + ofBuckets);
+		for (int m = numMonth - 2; m >= 0; m--) {
+			writer.append(',');
+			writer.appendNumber(results[m].bucketCounts[b]);
+		}
+		writer.append('\n');
+	
+	}
+
+}
+
+/**
+ *
+ * This function writes results as long format csv, with one row per period and
+ * series: "Period,Series,Value". Series are "top", "bottom", "average", and
+ * "bucket b" and "count b" of every bucket b if requested. A last row "all,average"
+ * holds total average return of all periods.
+ *
+ */
+static void writeLongCsv(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets) {
+	
+	writer.append("Period,Series,Value\n");
+	
+	double finalAverage = 0;
+	
+	for (unsigned long m = results.size(); m-- > 0;) {
+		
+		const PeriodResult& result = results[m];
+		
+		writer.append(result.date);
+		writer.append(",top,");
+		writer.appendNumber(result.topAverage);
+		writer.append('\n');
+		
+		writer.append(result.date);
+		writer.append(",bottom,");
+		writer.appendNumber(result.bottomAverage);
+		writer.append('\n');
+		
+		writer.append(result.date);
+		writer.append(",average,");
+		writer.appendNumber(result.average);
+		writer.append('\n');
+		
+		finalAverage += result.average;
+		
+		if (!allBuckets) {
+			continue;
+		}
+		
+		for (unsigned long b = 0; b < numBuckets; b++) {
+			writer.append(result.date);
+			writer.append(",bucket ");
+			writer.appendNumber(b + 1);
+			writer.append(',');
+			writer.appendNumber(result.bucketAverages[b]);
+			writer.append('\n');
+		}
+		
+		for (unsigned long b = 0; b < numBuckets; b++) {
+			writer.append(result.date);
+			writer.append(",count ");
+			writer.appendNumber(b + 1);
+			writer.append(',');
+			writer.appendNumber(result.bucketCounts[b]);
+			writer.append('\n');
+		}
+	
+	}
+	
+	writer.append("all,average,");
+	writer.appendNumber(finalAverage / static_cast<double>(results.size()));
+	writer.append('\n');
+
+}
+
+/**
+ *
+ * This function writes results as JSON lines, one object per period, e.g.
+ * {"period":"16-Jan","top":-0.0098,"bottom":0.0164,"average":0.0262}, with arrays
+ * "buckets" and "counts" if every bucket is requested. The last line is
+ * {"period":"all","periods":<number of periods>,"average":<total average return>}.
+ * NaN is written as null.
+ *
+ */
+static void writeJsonLines(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets) {
+	
+	double finalAverage = 0;
+	
+	for (unsigned long m = results.size(); m-- > 0;) {
+		
+		const PeriodResult& result = results[m];
+		
+		writer.append("{\"period\":");
+		writer.append(quoteJson(result.date));
+		writer.append(",\"top\":");
+		appendJsonNumber(writer, result.topAverage);
+		writer.append(",\"bottom\":");
+		appendJsonNumber(writer, result.bottomAverage);
+		writer.append(",\"average\":");
+		appendJsonNumber(writer, result.average);
+		
+		finalAverage += result.average;
+		
+		if (allBuckets) {
+			
+			writer.append(",\"buckets\":[");
+			for (unsigned long b = 0; b < numBuckets; b++) {
+				if (b > 0) {
+					writer.append(',');
+				}
+				appendJsonNumber(writer, result.bucketAverages[b]);
+			}
+			
+			writer.append("],\"counts\":[");
+			for (unsigned long b = 0; b < numBuckets; b++) {
+				if (b > 0) {
+					writer.append(',');
+				}
+				writer.appendNumber(result.bucketCounts[b]);
+			}
+			writer.append(']');
+		
+		}
+		
+		writer.append("}\n");
+	}
+	
+	writer.append("{\"period\":\"all\",\"periods\":");
+	writer.appendNumber(static_cast<unsigned long>(results.size()));
+	writer.append(",\"average\":");
+	appendJsonNumber(writer, finalAverage / static_cast<double>(results.size()));
+	writer.append("}\n");
+
+}
+
+/**
+ *
+ * This function writes results in binary, with integers as uint64 and numbers as
+ * doubles in the byte order of this machine:
+ *
+ *     "RCRESLT1" <number of periods> <number of buckets> <1 if every bucket is kept, otherwise 0>
+ *     then for every period:
+ *     <length of date> <date> <top> <bottom> <average> [<bucket averages>] [<bucket counts>]
+ *
+ * Doubles are written in full precision.
+ *
+ */
+static void writeBinary(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets) {
+	
+	uint64_t header[3] = {results.size(), numBuckets, allBuckets ? 1UL : 0UL};
+	writer.append(resultMagic, sizeof(resultMagic));
+	writer.appendBytes(header, sizeof(header));
+	
+	for (unsigned long m = results.size(); m-- > 0;) {
+		
+		const PeriodResult& result = results[m];
+		
+		uint64_t dateLength = result.date.size();
+		writer.appendBytes(&dateLength, sizeof(dateLength));
+		writer.append(result.date);
+		
+		double averages[3] = {result.topAverage, result.bottomAverage, result.average};
+		writer.appendBytes(averages, sizeof(averages));
+		
+		if (allBuckets) {
+			
+			writer.appendBytes(result.bucketAverages.data(), numBuckets * sizeof(double));
+			
+			for (const unsigned long& count : result.bucketCounts) {
+				uint64_t value = count;
+				writer.appendBytes(&value, sizeof(value));
+			}
+		
+		}
+	
+	}
+
+}
+
+/**
+ *
+ * This function writes results of all periods in a format. Periods are listed
+ * from latest to earliest in every format, the same as the input file.
+ *
+ * @param writer: the writer of output file, already opened.
+ * @param format: the format.
+ * @param results: results of every period, in chronological order.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param allBuckets: whether results of every bucket were calculated.
+ *
+ * This function does not return any value.
+ *
+ */
+void writeResults(ResultWriter& writer, OutputFormat format, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets) {
+	
+	PROFILE_STAGE(WRITE);
+	
+	uint64_t startBytes = writer.getBytesWritten();
+	
+	switch (format) {
+		case LONG_OUTPUT:
+			writeLongCsv(writer, results, numBuckets, allBuckets);
+			break;
+		case JSONL_OUTPUT:
+			writeJsonLines(writer, results, numBuckets, allBuckets);
+			break;
+		case BINARY_OUTPUT:
+			writeBinary(writer, results, numBuckets, allBuckets);
+			break;
+		default:
+			writeCsv(writer, results, numBuckets, allBuckets);
+			break;
+	}
+	
+	PROFILE_COUNT(BYTES_WRITTEN, writer.getBytesWritten() - startBytes);
+
+}
+
+/**
+ *
+ * This function is private to this file. It writes one csv row of a series, with
+ * periods from latest to earliest as in "result.csv".
+ *
+ */
+template <typename Value>
+static void writeCostRow(ResultWriter& writer, const string& name, const vector<PeriodResult>& results, Value value) {
+	
+	writer.append(name);
+	for (unsigned long m = results.size(); m-- > 0;) {
+		writer.append(',');
+		writer.appendNumber(value(results[m]));
+	}
+	writer.append('\n');
+
+}
+
+/**
+ *
+ * This function writes "costs.csv": turnover of top and bottom buckets in every
+ * period, and average returns net of trading costs next to gross ones. Trading
+ * costs of a bucket are costBps basis points per unit of turnover, so replacing
+ * the whole bucket costs costBps / 10000 of its value. Total return pays costs of
+ * the buckets held by the strategy, i.e. both of a long-short one and one of a
+ * long-only or short-only one. If all buckets are requested, turnover of every
+ * bucket follows.
+ *
+ * @param writer: the writer of output file, already opened.
+ * @param results: results of every period, in chronological order.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param allBuckets: whether results of every bucket were calculated.
+ * @param costBps: trading costs in basis points per unit of turnover.
+ * @param strategy: the strategy results were calculated with, which tells the traded buckets.
+ *
+ * This function does not return any value.
+ *
+ */
+void writeCosts(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets, double costBps, const Strategy& strategy) {
+	
+	PROFILE_STAGE(WRITE);
+	
+	uint64_t startBytes = writer.getBytesWritten();
+	double cost = costBps / 10000;
+	
+	writer.append("Period");
+	for (unsigned long m = results.size(); m-- > 0;) {
+		writer.append(',');
+		writer.append(results[m].date);
+	}
+	writer.append('\n');
+	
+	ostringstream percent;
+	percent << 100.0 / numBuckets;
+	string first = "first " + percent.str() + "% percentile/each period";
+	string last = "last " + percent.str() + "% percentile/each period";
+	
+	writeCostRow(writer, "Turnover of " + first, results, [](const PeriodResult& result) {
+		return result.topTurnover;
+	});
+	writeCostRow(writer, "Turnover of " + last, results, [](const PeriodResult& result) {
+		return result.bottomTurnover;
+	});
+	writeCostRow(writer, "Net average return of " + first, results, [cost](const PeriodResult& result) {
+		return result.topAverage - cost * result.topTurnover;
+	});
+	writeCostRow(writer, "Net average return of " + last, results, [cost](const PeriodResult& result) {
+		return result.bottomAverage - cost * result.bottomTurnover;
+	});
+	
+	// Turnover of the buckets the strategy trades.
+	bool holdsTop = strategy.holdsTop(), holdsBottom = strategy.holdsBottom();
+	auto traded = [holdsTop, holdsBottom](const PeriodResult& result) {
+		return (holdsTop ? result.topTurnover : 0) + (holdsBottom ? result.bottomTurnover : 0);
+	};
+	
+	writeCostRow(writer, "Net total average return/each period", results, [cost, &traded](const PeriodResult& result) {
+		return result.average - cost * traded(result);
+	});
+	
+	double grossAverage = 0, netAverage = 0, topTurnover = 0, bottomTurnover = 0;
+	for (const PeriodResult& result : results) {
+		grossAverage += result.average;
+		netAverage += result.average - cost * traded(result);
+		topTurnover += result.topTurnover;
+		bottomTurnover += result.bottomTurnover;
+	}
+	
+	double numPeriods = static_cast<double>(results.size());
+	string summaries[4] = {"Total average return of all period,", "Net total average return of all period,",
+		"Average turnover of first " + percent.str() + "% percentile,", "Average turnover of last " + percent.str() + "% percentile,"};
+	double values[4] = {grossAverage / numPeriods, netAverage / numPeriods, topTurnover / numPeriods, bottomTurnover / numPeriods};
+	
+	writer.append('\n');
+	for (unsigned long i = 0; i < 4; i++) {
+		writer.append(summaries[i]);
+		writer.appendNumber(values[i]);
+		writer.append('\n');
+	}
+	
+	if (allBuckets) {
+		
+		writer.append('\n');
+		for (unsigned long b = 0; b < numBuckets; b++) {
+			writeCostRow(writer, "Turnover of bucket " + to_string(b + 1) + " of " + to_string(numBuckets) + "/each period", results, [b](const PeriodResult& result) {
+				return b < result.bucketTurnovers.size() ? result.bucketTurnovers[b] : 1.0;
+			});
+		}
+	
+	}
+	
+	PROFILE_COUNT(BYTES_WRITTEN, writer.getBytesWritten() - startBytes);
+
+}
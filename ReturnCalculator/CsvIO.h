@@ -0,0 +1,46 @@
+//
+//  CsvIO.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/2.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef CsvIO_h
+#define CsvIO_h
+
+#include <fstream>
+#include <vector>
+#include "PanelData.h"
+#include "MonthlyData.h"
+#include "PanelCache.h"
+#include "LongCsvReader.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+/**
+ *
+ * Csv input and output header code:
+ *
+ * This header file declares the parsers of input csv files and the writer of
+ * result files, so that they can be called from main program, batch jobs and
+ * benchmark alike.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+// Ways a panel can be loaded.
+enum PanelSource {MMAP_PARSER, STREAM_PARSER, PANEL_CACHE};
+
+// Signatures for input and output sub programs.
+void parseInput(ifstream& inputFile, PanelData& panel);
+PanelSource loadPanel(const string& inputFileName, bool useStreamParser, PanelCache* cache, PanelData& panel, unsigned long& inputSize);
+void processLongInput(LongCsvReader& reader, unsigned long numBuckets, bool allBuckets, vector<PeriodResult>& results, LongMonth& latest);
+void writeResults(ResultWriter& writer, OutputFormat format, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets);
+void writeCosts(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets, double costBps, const Strategy& strategy = Strategy());
+
+
+#endif /* CsvIO_h */
@@ -0,0 +1,241 @@
+//
+//  CsvReader.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "CsvReader.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of CsvReader class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This helper finds next occurrence of a character in [first, last).
+ *
+ * return address of the character, or last if it is not found.
+ *
+ */
+static const char* findChar(const char* first, const char* last, char c) {
+	
+	const void* found = memchr(first, c, last - first);
+	return found == nullptr ? last : static_cast<const char*>(found);
+
+}
+
+/**
+ *
+ * This is default constructor which maps the input file.
+ *
+ * @param fileName: path of input csv file.
+ *
+ */
+CsvReader::CsvReader(const string& fileName) : file(fileName) {
+	
+	lineNumber = 0;
+
+}
+
+/**
+ *
+ * This method is inspector to check whether input file is mapped.
+ *
+ * return true if the file was opened successfully.
+ *
+ */
+bool CsvReader::isOpen() const {
+	
+	return file.isOpen();
+
+}
+
+/**
+ *
+ * This method is inspector to get input file size.
+ *
+ * return number of bytes in the file.
+ *
+ */
+unsigned long CsvReader::getSize() const {
+	
+	return file.getSize();
+
+}
+
+/**
+ *
+ * This method splits header line by commas and parses each date cell, e.g.
+ * "16-Mar" of monthly data or "2016-03-16" of daily data, into an integer date.
+ * The first cell is the empty corner above symbols, and trailing empty cells are
+ * ignored.
+ * Input file lists latest month first, so months are added into panel backwards
+ * to keep panel in chronological order.
+ *
+ * @param first: start of header line.
+ * @param last: end of header line, excluding line break.
+ * @param panel: the panel receiving months.
+ *
+ */
+void CsvReader::parseHeader(const char* first, const char* last, PanelData& panel) {
+	
+	vector<CalendarDate> dates;
+	
+	const char* cell = findChar(first, last, ',');
+	while (cell < last) {
+		
+		++cell;
+		const char* cellEnd = findChar(cell, last, ',');
+		
+		if (cellEnd > cell) {
+			
+			CalendarDate date;
+			if (!parseDate(cell, cellEnd, date)) {
+				throw runtime_error("line 1: date \"" + string(cell, cellEnd) + "\" is not in format of \"16-Mar\" or \"2016-03-16\"");
+			}
+			
+			dates.push_back(date);
+		
+		}
+		
+		cell = cellEnd;
+	}
+	
+	for (unsigned long m = dates.size(); m > 0; m--) {
+		panel.addMonth(dates[m - 1]);
+	}
+
+}
+
+/**
+ *
+ * This method converts a cell into a return rate without allocating. Cells
+ * marked as "#N/A" and empty cells are missing, the same as stream based parsing.
+ *
+ * @param first: start of the cell.
+ * @param last: end of the cell.
+ * @param lineNumber: line number of the cell, for error messages.
+ * @param value: output parameter receiving parsed return rate, 0 if missing.
+ *
+ * return false if the cell is missing.
+ *
+ */
+bool CsvReader::parseReturn(const char* first, const char* last, unsigned long lineNumber, double& value) {
+	
+	while (first < last && *first == ' ') {
+		++first;
+	}
+	while (last > first && last[-1] == ' ') {
+		--last;
+	}
+	
+	value = 0;
+	if (first == last || (last - first == 4 && memcmp(first, "#N/A", 4) == 0)) {
+		return false;
+	}
+	
+	// from_chars() does not accept an explicit plus sign.
+	if (*first == '+') {
+		++first;
+	}
+	
+	from_chars_result result = from_chars(first, last, value);
+	if (result.ec != errc() || result.ptr != last) {
+		throw runtime_error("line " + to_string(lineNumber) + ": invalid return rate \"" + string(first, last) + "\"");
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method scans whole mapped file line by line and fills the panel. Lines
+ * that are empty or start with a comma are skipped. Cells beyond the number of
+ * months in header are ignored.
+ *
+ * @param panel: an empty panel to be filled with parsed data.
+ *
+ * This method does not return any value. It throws runtime_error on malformed input.
+ *
+ */
+void CsvReader::parse(PanelData& panel) {
+	
+	PROFILE_STAGE(PARSE);
+	
+	const char* cur = file.getData();
+	const char* end = cur + file.getSize();
+	
+	lineNumber = 0;
+	unsigned long numMonths = 0;
+	unsigned long numRows = 0, numCells = 0, numMissing = 0;
+	
+	while (cur < end) {
+		
+		const char* lineEnd = findChar(cur, end, '\n');
+		++lineNumber;
+		
+		// Handle different new line character in Windows and Linux/Unix.
+		const char* last = lineEnd;
+		if (last > cur && last[-1] == '\r') {
+			--last;
+		}
+		
+		if (lineNumber == 1) {
+			
+			parseHeader(cur, last, panel);
+			numMonths = panel.getNumMonths();
+		
+		} else if (last > cur && *cur != ',') {
+			
+			// First cell is the stock symbol, and remaining cells are return rates
+			// starting from latest month.
+			const char* cell = findChar(cur, last, ',');
+			unsigned long symbolId = panel.addSymbol(string_view(cur, cell - cur));
+			++numRows;
+			
+			unsigned long column = 0;
+			while (cell < last && column < numMonths) {
+				
+				++cell;
+				const char* cellEnd = findChar(cell, last, ',');
+				
+				double value;
+				if (parseReturn(cell, cellEnd, lineNumber, value)) {
+					panel.setReturn(symbolId, numMonths - 1 - column, value);
+				} else {
+					panel.setMissing(symbolId, numMonths - 1 - column);
+					++numMissing;
+				}
+				++column;
+				++numCells;
+				
+				cell = cellEnd;
+			}
+		
+		}
+		
+		cur = lineEnd < end ? lineEnd + 1 : end;
+	}
+	
+	PROFILE_COUNT(ROWS_PARSED, numRows);
+	PROFILE_COUNT(CELLS_PARSED, numCells);
+	PROFILE_COUNT(MISSING_CELLS, numMissing);
+	
+	panel.transpose();
+
+}
@@ -0,0 +1,72 @@
+//
+//  CsvReader.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef CsvReader_h
+#define CsvReader_h
+
+#include <string>
+#include "MappedFile.h"
+#include "PanelData.h"
+
+using namespace std;
+
+/**
+ *
+ * Csv reader class header code:
+ *
+ * This header file defines the memory-mapped parser of input csv file, which
+ * has the same format as provided file "SP50_test.csv".
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class scans a mapped input file in place and fills a panel.
+ *
+ * Cells are located with memchr() and numbers are converted by from_chars(),
+ *	so no string is built except one per company symbol.
+ * The header line is split by commas, and each date is parsed into an integer,
+ *	so dates are not assumed to have fixed width, and may be monthly or daily.
+ * Malformed return rates raise runtime_error with the line number.
+ *
+ */
+class CsvReader {
+
+private:
+	
+	// The mapped input file.
+	MappedFile file;
+	
+	// Line number of the line being parsed, for error messages.
+	unsigned long lineNumber;
+
+public:
+	
+	// A default constructor mapping the input file.
+	CsvReader(const string& fileName);
+	
+	// Inspectors for file state and size in bytes.
+	bool isOpen() const;
+	unsigned long getSize() const;
+	
+	// The method parses whole file into an empty panel.
+	void parse(PanelData& panel);
+	
+	// The method parses the header line and adds its months into the panel.
+	static void parseHeader(const char* first, const char* last, PanelData& panel);
+	
+	// The method converts one cell into a return rate, "#N/A" and empty cells are missing.
+	static bool parseReturn(const char* first, const char* last, unsigned long lineNumber, double& value);
+
+};
+
+
+#endif /* CsvReader_h */
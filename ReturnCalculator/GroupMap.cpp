@@ -0,0 +1,138 @@
+//
+//  GroupMap.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "GroupMap.h"
+
+#include <fstream>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of GroupMap class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This is default constructor of a map without any group.
+ *
+ */
+GroupMap::GroupMap() {
+	
+	numMapped = 0;
+
+}
+
+/**
+ *
+ * This method reads the group of every symbol of a panel from a csv file. Every
+ * line holds a symbol and its group separated by a comma, and a later line of the
+ * same symbol overrides earlier ones. Lines without a comma or with an empty group
+ * are skipped.
+ *
+ * @param fileName: path of the group file.
+ * @param symbols: symbols of the panel whose stocks are ranked within groups.
+ *
+ * return false if the file can't be opened.
+ *
+ */
+bool GroupMap::load(const string& fileName, const SymbolTable& symbols) {
+	
+	ifstream groupFile(fileName);
+	if (!groupFile.is_open()) {
+		return false;
+	}
+	
+	symbolGroups.assign(symbols.size(), NO_GROUP);
+	
+	string line;
+	while (getline(groupFile, line)) {
+		
+		// Tolerate files saved with Windows line breaks.
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		
+		size_t comma = line.find(',');
+		if (comma == string::npos || comma + 1 == line.size()) {
+			continue;
+		}
+		
+		unsigned long symbolId;
+		if (symbols.find(line.substr(0, comma), symbolId)) {
+			symbolGroups[symbolId] = groupNames.intern(line.substr(comma + 1));
+		}
+	
+	}
+	
+	numMapped = 0;
+	for (const unsigned long& group : symbolGroups) {
+		if (group != NO_GROUP) {
+			numMapped++;
+		}
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * These methods are inspectors for number of groups, name of a group, and number
+ * of symbols of the panel that belong to a group.
+ *
+ */
+unsigned long GroupMap::getNumGroups() const {
+	
+	return groupNames.size();
+
+}
+
+string_view GroupMap::getGroupName(unsigned long group) const {
+	
+	return groupNames.getSymbol(group);
+
+}
+
+unsigned long GroupMap::getNumMapped() const {
+	
+	return numMapped;
+
+}
+
+/**
+ *
+ * This method is inspector to get the group of a symbol.
+ *
+ * @param symbolId: ID of the symbol in the panel.
+ *
+ * return ID of its group, or NO_GROUP.
+ *
+ */
+unsigned long GroupMap::getGroup(unsigned long symbolId) const {
+	
+	return symbolId < symbolGroups.size() ? symbolGroups[symbolId] : NO_GROUP;
+
+}
+
+/**
+ *
+ * This method is inspector to get groups of all symbols at once.
+ *
+ * return array of group IDs indexed by symbol ID, as long as the panel has symbols.
+ *
+ */
+const unsigned long* GroupMap::getGroups() const {
+	
+	return symbolGroups.data();
+
+}
@@ -0,0 +1,78 @@
+//
+//  GroupMap.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef GroupMap_h
+#define GroupMap_h
+
+#include <string>
+#include <vector>
+#include "PanelData.h"
+
+using namespace std;
+
+/**
+ *
+ * Group map class header code:
+ *
+ * This header file defines the mapping from company symbols to groups, e.g.
+ * sectors or industries, which stocks are ranked within.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps the group of every symbol of a panel, read from a csv file with
+ * one "symbol,group" line per company.
+ *
+ * Group names are interned to dense IDs in order of first appearance, the same way
+ *	as symbols, and the group ID of each symbol is stored in an array indexed by
+ *	symbol ID, so a month is partitioned by group without any hashing.
+ * Symbols of the file that are not in the panel are ignored, which also skips a
+ *	header line. Symbols of the panel that are not in the file belong to no group.
+ *
+ */
+class GroupMap {
+
+private:
+	
+	// Group names and their IDs.
+	SymbolTable groupNames;
+	
+	// Group ID of every symbol ID of the panel, or NO_GROUP.
+	vector<unsigned long> symbolGroups;
+	
+	// Number of symbols of the panel that belong to a group.
+	unsigned long numMapped;
+
+public:
+	
+	// Group ID of symbols that belong to no group.
+	static constexpr unsigned long NO_GROUP = ~0UL;
+	
+	// A default constructor of a map without any group.
+	GroupMap();
+	
+	// The mutator to read groups of the symbols of a panel, returns false if the file can't be opened.
+	bool load(const string& fileName, const SymbolTable& symbols);
+	
+	// Inspectors for number of groups, name of a group, and number of symbols in any group.
+	unsigned long getNumGroups() const;
+	string_view getGroupName(unsigned long group) const;
+	unsigned long getNumMapped() const;
+	
+	// Inspectors for group ID of a symbol ID, and of all symbol IDs as an array.
+	unsigned long getGroup(unsigned long symbolId) const;
+	const unsigned long* getGroups() const;
+
+};
+
+
+#endif /* GroupMap_h */
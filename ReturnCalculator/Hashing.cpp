@@ -0,0 +1,125 @@
+//
+//  Hashing.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Hashing.h"
+
+#include <cstring>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement hashBytes().
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Large odd constants mixing bits of each word.
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+/**
+ *
+ * This helper rotates bits of a word left.
+ *
+ */
+static inline uint64_t rotateLeft(uint64_t x, int r) {
+	
+	return (x << r) | (x >> (64 - r));
+
+}
+
+/**
+ *
+ * This helper reads a word from an address of any alignment.
+ *
+ */
+static inline uint64_t readWord(const char* p) {
+	
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+
+}
+
+/**
+ *
+ * This helper spreads every input bit over the whole word, which is the final
+ * step of 64 bit MurmurHash3.
+ *
+ */
+static inline uint64_t finalMix(uint64_t h) {
+	
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	
+	return h;
+
+}
+
+/**
+ *
+ * This function hashes a byte range. Blocks of 32 bytes are folded into 4 lanes
+ * which do not depend on each other, then remaining words and bytes are folded
+ * into the combined value.
+ *
+ * @param data: start of the bytes, may be null if size is 0.
+ * @param size: number of bytes.
+ * @param seed: initial value, different seeds give unrelated hash values.
+ *
+ * return 64 bit hash value.
+ *
+ */
+uint64_t hashBytes(const char* data, unsigned long size, uint64_t seed) {
+	
+	uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+	unsigned long i = 0;
+	
+	for (; i + 32 <= size; i += 32) {
+		for (int l = 0; l < 4; l++) {
+			lanes[l] = rotateLeft(lanes[l] + readWord(data + i + 8 * l) * prime2, 31) * prime1;
+		}
+	}
+	
+	uint64_t h = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+	h += size;
+	
+	for (; i + 8 <= size; i += 8) {
+		h ^= rotateLeft(readWord(data + i) * prime2, 31) * prime1;
+		h = rotateLeft(h, 27) * prime1 + prime2;
+	}
+	
+	for (; i < size; i++) {
+		h ^= static_cast<unsigned char>(data[i]) * prime1;
+		h = rotateLeft(h, 11) * prime2;
+	}
+	
+	return finalMix(h);
+
+}
+
+/**
+ *
+ * This function hashes one word with the final step of MurmurHash3. Different
+ * words always give different hash values, so hashes of a counter are usable as
+ * a stream of random numbers.
+ *
+ * @param word: the word to be hashed.
+ *
+ * return 64 bit hash value.
+ *
+ */
+uint64_t hashWord(uint64_t word) {
+	
+	return finalMix(word);
+
+}
@@ -0,0 +1,38 @@
+//
+//  Hashing.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Hashing_h
+#define Hashing_h
+
+#include <cstdint>
+
+using namespace std;
+
+/**
+ *
+ * Hashing header code:
+ *
+ * This header file declares a fast non-cryptographic 64 bit hash of a byte range,
+ * which detects changes of input files without comparing them byte by byte.
+ *
+ * Bytes are consumed 8 at a time in 4 independent lanes, so a large file is
+ * hashed at memory speed. Hash values depend on byte order of the machine.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+// Hash value of size bytes starting at data.
+uint64_t hashBytes(const char* data, unsigned long size, uint64_t seed = 0);
+
+// Hash value of one 64 bit word, a bijection which spreads every bit over the word.
+uint64_t hashWord(uint64_t word);
+
+
+#endif /* Hashing_h */
@@ -0,0 +1,293 @@
+//
+//  LongCsvReader.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "LongCsvReader.h"
+#include "Profiler.h"
+#include "CsvReader.h"
+
+#include <cctype>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of LongMonth and LongCsvReader classes.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This method empties the month. Capacity of vectors is kept, so reading the
+ * next month into it does not allocate again.
+ *
+ */
+void LongMonth::clear() {
+	
+	date.clear();
+	parsedDate = 0;
+	symbolIds.clear();
+	rates.clear();
+	valid.clear();
+
+}
+
+/**
+ *
+ * This is default constructor which opens the input file.
+ *
+ * @param fileName: path of input csv file in long format.
+ *
+ */
+LongCsvReader::LongCsvReader(const string& fileName) : input(fileName) {
+	
+	lineNumber = 0;
+	bytesRead = 0;
+	
+	hasPrevious = false;
+	previousDate = 0;
+	
+	hasPending = false;
+	pendingLine = 0;
+	pendingId = 0;
+	pendingRate = 0;
+	pendingValid = false;
+
+}
+
+/**
+ *
+ * This method is inspector to check whether input file is opened.
+ *
+ * return true if the file was opened successfully.
+ *
+ */
+bool LongCsvReader::isOpen() const {
+	
+	return input.is_open();
+
+}
+
+/**
+ *
+ * This method is inspector to get number of bytes consumed so far.
+ *
+ * return number of bytes, including line breaks.
+ *
+ */
+unsigned long LongCsvReader::getBytesRead() const {
+	
+	return bytesRead;
+
+}
+
+/**
+ *
+ * This method is inspector to get the table of symbols seen so far.
+ *
+ * return a constant reference of symbol table.
+ *
+ */
+const SymbolTable& LongCsvReader::getSymbols() const {
+	
+	return symbols;
+
+}
+
+/**
+ *
+ * This method reads lines until a line of another date or the end of input file.
+ * The line of another date is kept, and starts the month returned by next call.
+ * Empty lines are skipped.
+ *
+ * @param month: a month to be overwritten by the month read.
+ *
+ * return false if there is no more month. It throws runtime_error on malformed input,
+ * or if the month is not after the month returned by previous call.
+ *
+ */
+bool LongCsvReader::readMonth(LongMonth& month) {
+	
+	PROFILE_STAGE(PARSE);
+	
+	month.clear();
+	
+	// Line number of the first line of the month.
+	unsigned long monthLine = 0;
+	
+	if (hasPending) {
+		
+		monthLine = pendingLine;
+		month.date = pendingDate;
+		month.symbolIds.push_back(pendingId);
+		month.rates.push_back(pendingRate);
+		month.valid.push_back(pendingValid);
+		hasPending = false;
+	
+	}
+	
+	string line;
+	unsigned long numLines = 0, numMissing = 0;
+	while (getline(input, line)) {
+		
+		++lineNumber;
+		bytesRead += line.size() + 1;
+		
+		// Handle different new line character in Windows and Linux/Unix.
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty()) {
+			continue;
+		}
+		
+		const char* first = line.data();
+		const char* last = first + line.size();
+		const char* comma1 = static_cast<const char*>(memchr(first, ',', last - first));
+		const char* comma2 = comma1 == nullptr ? nullptr : static_cast<const char*>(memchr(comma1 + 1, ',', last - comma1 - 1));
+		
+		if (comma2 == nullptr) {
+			throw runtime_error("line " + to_string(lineNumber) + ": expected \"date,symbol,return\"");
+		}
+		
+		// Trailing cells after return rate are ignored.
+		const char* cellEnd = static_cast<const char*>(memchr(comma2 + 1, ',', last - comma2 - 1));
+		if (cellEnd == nullptr) {
+			cellEnd = last;
+		}
+		
+		const char* rate = comma2 + 1;
+		while (rate < cellEnd && *rate == ' ') {
+			++rate;
+		}
+		if (lineNumber == 1 && rate < cellEnd && isalpha(static_cast<unsigned char>(*rate))) {
+			continue;
+		}
+		
+		double value;
+		bool valid = CsvReader::parseReturn(comma2 + 1, cellEnd, lineNumber, value);
+		++numLines;
+		numMissing += valid ? 0 : 1;
+		unsigned long symbolId = symbols.intern(string_view(comma1 + 1, comma2 - comma1 - 1));
+		
+		// A line of another date ends current month.
+		if (!month.symbolIds.empty() && line.compare(0, comma1 - first, month.date) != 0) {
+			
+			hasPending = true;
+			pendingLine = lineNumber;
+			pendingDate.assign(first, comma1);
+			pendingId = symbolId;
+			pendingRate = value;
+			pendingValid = valid;
+			break;
+		
+		}
+		
+		if (month.symbolIds.empty()) {
+			monthLine = lineNumber;
+			month.date.assign(first, comma1);
+		}
+		
+		month.symbolIds.push_back(symbolId);
+		month.rates.push_back(value);
+		month.valid.push_back(valid);
+	}
+	
+	// Every line holds one return rate.
+	PROFILE_COUNT(ROWS_PARSED, numLines);
+	PROFILE_COUNT(CELLS_PARSED, numLines);
+	PROFILE_COUNT(MISSING_CELLS, numMissing);
+	
+	if (month.symbolIds.empty()) {
+		return false;
+	}
+	
+	if (!parseDate(month.date.data(), month.date.data() + month.date.size(), month.parsedDate)) {
+		throw runtime_error("line " + to_string(lineNumber) + ": date \"" + month.date + "\" is not in format of \"16-Mar\" or \"2016-03-16\"");
+	}
+	
+	if (hasPrevious && month.parsedDate <= previousDate) {
+		throw runtime_error("line " + to_string(monthLine) + ": date \"" + month.date + "\" is not after \"" + previousLabel + "\"");
+	}
+	
+	hasPrevious = true;
+	previousDate = month.parsedDate;
+	previousLabel = month.date;
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method builds a panel of two months, a formation month and the month after
+ * it, over symbols listed in formation month. Symbols are added in order of their
+ * IDs, so ties are broken the same as in a panel of the whole input file. Symbols
+ * not listed in holding month are missing there, and symbols only listed in
+ * holding month are left out, as they are never ranked.
+ *
+ * @param symbols: the table which IDs of both months refer to.
+ * @param formation: the earlier month, whose return rates are ranked.
+ * @param holding: the month after formation month.
+ * @param window: an empty panel to be filled.
+ * @param holdingSlots: scratch space kept by caller between windows, either empty
+ *			or filled with -1.
+ *
+ */
+void LongCsvReader::makeWindow(const SymbolTable& symbols, const LongMonth& formation, const LongMonth& holding, PanelData& window, vector<long>& holdingSlots) {
+	
+	window.addMonth(formation.parsedDate);
+	window.addMonth(holding.parsedDate);
+	
+	holdingSlots.resize(symbols.size(), -1);
+	for (unsigned long i = 0; i < holding.symbolIds.size(); i++) {
+		holdingSlots[holding.symbolIds[i]] = static_cast<long>(i);
+	}
+	
+	// Months usually list symbols in the same order, then IDs are already ascending.
+	vector<unsigned long> order(formation.symbolIds.size());
+	iota(order.begin(), order.end(), 0);
+	if (!is_sorted(formation.symbolIds.begin(), formation.symbolIds.end())) {
+		stable_sort(order.begin(), order.end(), [&formation](unsigned long a, unsigned long b) {
+			return formation.symbolIds[a] < formation.symbolIds[b];
+		});
+	}
+	
+	for (unsigned long i : order) {
+		
+		unsigned long global = formation.symbolIds[i];
+		unsigned long id = window.addSymbol(symbols.getSymbol(global));
+		
+		if (formation.valid[i]) {
+			window.setReturn(id, 0, formation.rates[i]);
+		} else {
+			window.setMissing(id, 0);
+		}
+		
+		long slot = holdingSlots[global];
+		if (slot >= 0 && holding.valid[slot]) {
+			window.setReturn(id, 1, holding.rates[slot]);
+		} else {
+			window.setMissing(id, 1);
+		}
+	
+	}
+	
+	for (unsigned long i = 0; i < holding.symbolIds.size(); i++) {
+		holdingSlots[holding.symbolIds[i]] = -1;
+	}
+	
+	window.transpose();
+
+}
@@ -0,0 +1,120 @@
+//
+//  LongCsvReader.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef LongCsvReader_h
+#define LongCsvReader_h
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "PanelData.h"
+
+using namespace std;
+
+/**
+ *
+ * Long csv reader class header code:
+ *
+ * This header file defines the streaming parser of long format input, which has
+ * one return rate per line instead of one symbol per line:
+ *
+ *     date,symbol,return
+ *     16-Jan,GT,-0.13
+ *     16-Jan,BWA,-0.32
+ *     16-Feb,GT,0.06
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This struct keeps return rates of all companies listed in one month of long
+ * format input, in the order they are listed.
+ *
+ */
+struct LongMonth {
+	
+	// Date of the month as written in input file, and parsed the same as header of wide input.
+	string date;
+	CalendarDate parsedDate;
+	
+	// Symbol IDs from the reader's symbol table, return rates and their validity.
+	vector<unsigned long> symbolIds;
+	vector<double> rates;
+	vector<unsigned char> valid;
+	
+	// The method empties the month but keeps its memory for reuse.
+	void clear();
+
+};
+
+
+/**
+ *
+ * This class reads long format input line by line and returns one month at a time,
+ * so memory does not grow with number of months in input file.
+ *
+ * Lines have to be grouped by date with the earliest month first, and a month ends
+ *	at the first line of another date. A month whose date is not after the month
+ *	before, e.g. input with latest month first or a date listed again later, raises
+ *	runtime_error. A first line whose return rate starts with
+ *	a letter is regarded as header and skipped.
+ * Symbols get IDs in order of first appearance, which decides ties in ranking the
+ *	same way as row order of wide input.
+ * Malformed lines raise runtime_error with the line number.
+ *
+ */
+class LongCsvReader {
+
+private:
+	
+	// The input file, and line number of the line being parsed for error messages.
+	ifstream input;
+	unsigned long lineNumber;
+	
+	// Number of bytes consumed, for throughput report.
+	unsigned long bytesRead;
+	
+	// All symbols seen so far.
+	SymbolTable symbols;
+	
+	// Date of the month returned last, which next month has to be after.
+	bool hasPrevious;
+	CalendarDate previousDate;
+	string previousLabel;
+	
+	// The first line of next month and its line number, read before current month was known to end.
+	bool hasPending;
+	unsigned long pendingLine;
+	string pendingDate;
+	unsigned long pendingId;
+	double pendingRate;
+	bool pendingValid;
+
+public:
+	
+	// A default constructor opening the input file.
+	LongCsvReader(const string& fileName);
+	
+	// Inspectors for file state, bytes consumed and symbols seen.
+	bool isOpen() const;
+	unsigned long getBytesRead() const;
+	const SymbolTable& getSymbols() const;
+	
+	// The method reads next month, returns false at the end of input file.
+	bool readMonth(LongMonth& month);
+	
+	// The method fills an empty panel with a formation month and its holding month.
+	static void makeWindow(const SymbolTable& symbols, const LongMonth& formation, const LongMonth& holding, PanelData& window, vector<long>& holdingSlots);
+
+};
+
+
+#endif /* LongCsvReader_h */
@@ -0,0 +1,127 @@
+//
+//  MappedFile.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of MappedFile class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This is default constructor which maps the whole file read-only. The file
+ * descriptor is closed right after mapping, as the mapping keeps file alive.
+ *
+ * @param fileName: path of the file to be mapped.
+ *
+ * If the file cannot be opened or mapped, isOpen() returns false.
+ *
+ */
+MappedFile::MappedFile(const string& fileName) {
+	
+	data = nullptr;
+	size = 0;
+	open = false;
+	
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	
+	struct stat status;
+	if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+		close(fd);
+		return;
+	}
+	
+	size = static_cast<unsigned long>(status.st_size);
+	
+	// Mapping zero bytes is not allowed, an empty file simply has no data.
+	if (size > 0) {
+		
+		void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address == MAP_FAILED) {
+			close(fd);
+			size = 0;
+			return;
+		}
+		
+		// Input is scanned from front to back once, so let kernel read ahead.
+		madvise(address, size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(address);
+	
+	}
+	
+	close(fd);
+	open = true;
+
+}
+
+/**
+ *
+ * This is destructor which unmaps the file.
+ *
+ */
+MappedFile::~MappedFile() {
+	
+	if (data != nullptr) {
+		munmap(const_cast<char*>(data), size);
+	}
+
+}
+
+/**
+ *
+ * This method is inspector to check whether file is mapped.
+ *
+ * return true if the file was opened successfully.
+ *
+ */
+bool MappedFile::isOpen() const {
+	
+	return open;
+
+}
+
+/**
+ *
+ * This method is inspector to get start address of file content.
+ *
+ * return pointer to the first byte, or null for an empty file.
+ *
+ */
+const char* MappedFile::getData() const {
+	
+	return data;
+
+}
+
+/**
+ *
+ * This method is inspector to get file size.
+ *
+ * return number of bytes in the file.
+ *
+ */
+unsigned long MappedFile::getSize() const {
+	
+	return size;
+
+}
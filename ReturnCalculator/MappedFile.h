@@ -0,0 +1,63 @@
+//
+//  MappedFile.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <string>
+
+using namespace std;
+
+/**
+ *
+ * Mapped file class header code:
+ *
+ * This header file defines a read-only memory mapping of a whole file, so that
+ * input can be scanned in place without copying it into stream buffers.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class maps a file into memory on construction and unmaps it on destruction.
+ * An empty file is regarded as open with no data.
+ * Objects are not copyable, since they own the mapping.
+ *
+ */
+class MappedFile {
+
+private:
+	
+	// Start address and length of the mapping.
+	const char* data;
+	unsigned long size;
+	
+	// Whether the file was opened successfully.
+	bool open;
+
+public:
+	
+	// A default constructor mapping the file of input name.
+	MappedFile(const string& fileName);
+	~MappedFile();
+	
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+	
+	// Inspectors for mapping state and content.
+	bool isOpen() const;
+	const char* getData() const;
+	unsigned long getSize() const;
+
+};
+
+
+#endif /* MappedFile_h */
@@ -7,6 +7,10 @@
 //
 
 #include "MonthlyData.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -21,243 +25,540 @@ using namespace std;
 
 /**
  *
- * This is default constructor specifying year and month information.
+ * This is default constructor specifying the panel and month information.
  *
- * @param y: a string represents current year.
- * @param m: a string represents current month.
+ * @param p: the panel which stores return rates of all months.
+ * @param m: index of current month in the panel.
  *
  * Other class members are initialized to empty or zero.
  *
  */
-MonthlyData::MonthlyData(const string& y, const string& m) {
+MonthlyData::MonthlyData(const PanelData& p, unsigned long m) {
+	
+	panel = &p;
+	monthIndex = m;
 	
-	year = y;
-	month = m;
+	numBuckets = 10;
+	allBuckets = false;
+	weights = nullptr;
+	groups = nullptr;
+	groupPool = nullptr;
+	rankedSelection = nullptr;
 	
 	tenPercentSize = 0;
-	topTenPercentAverage = 0;
-	bottomTenPercentAverage = 0;
+	topTurnover = 1;
+	bottomTurnover = 1;
 	monthAverage = 0;
 
 }
 
+
 /**
  *
- * This is the copy constructor of MonthlyData.
+ * This method is a mutator to change number of buckets that stocks are split into.
+ * This method is supposed to be called before getMonthReturn().
  *
- * @param copy: input object to be fully copied.
- *
- * All class members are initialized to have identical values
- * as the input object members.
+ * @param n: number of buckets, at least 1. Default is 10.
+ * @param all: true to calculate results of every bucket, false to calculate only
+ *			top and bottom buckets.
  *
  */
-MonthlyData::MonthlyData(const MonthlyData& copy) {
+void MonthlyData::setBuckets(unsigned long n, bool all) {
 	
-	year = copy.year;
-	month = copy.month;
+	numBuckets = n;
+	allBuckets = all;
+
+}
+
+
+/**
+ *
+ * This method is a mutator to weight stocks by value, e.g. market cap, instead of
+ * equally. A stock's weight is its value in this month, i.e. at formation, and
+ * stocks without a positive value are left out of averages.
+ * This method is supposed to be called before getMonthReturn().
+ *
+ * @param w: panel of values aligned with the panel of return rates, or null for
+ *			equal weights.
+ *
+ */
+void MonthlyData::setWeights(const PanelData* w) {
 	
-	tenPercentSize = copy.tenPercentSize;
-	topTenPercentAverage = copy.topTenPercentAverage;
-	bottomTenPercentAverage = copy.bottomTenPercentAverage;
-	monthAverage = copy.monthAverage;
+	weights = w;
+
+}
+
+
+/**
+ *
+ * This method is a mutator to rank stocks within groups, e.g. sectors, instead of
+ * all together, so top and bottom buckets hold the same share of every group.
+ * This method is supposed to be called before getMonthReturn().
+ *
+ * @param g: groups of the symbols of the panel, or null to rank all stocks together.
+ * @param pool: thread pool to rank groups on, or null to rank them serially. Months
+ *			using the pool must not be processed on the same pool.
+ *
+ */
+void MonthlyData::setGroups(const GroupMap* g, ThreadPool* pool) {
 	
-	stockReturns = copy.stockReturns;
+	groups = g;
+	groupPool = pool;
+
+}
+
+
+/**
+ *
+ * This method is a mutator to choose which portfolio is built from top and bottom
+ * ten percent, e.g. momentum instead of reversal, or only the long leg. Default is
+ * buying bottom and selling top ten percent.
+ * This method is supposed to be called before getMonthReturn().
+ *
+ * @param s: direction and legs of the strategy.
+ *
+ */
+void MonthlyData::setStrategy(const Strategy& s) {
 	
-	topTenPercent = copy.topTenPercent;
-	bottomTenPercent = copy.bottomTenPercent;
+	strategy = s;
+
+}
+
+
+/**
+ *
+ * This method is a mutator to reuse stocks lists ranked by an earlier run on the
+ * same panel with the same buckets and groups, e.g. kept in the result cache, so
+ * this month is not ranked again.
+ * This method is supposed to be called before getMonthReturn().
+ *
+ * @param selection: the selection, which must outlive this month, or null to rank
+ *			this month.
+ *
+ */
+void MonthlyData::setSelection(const BucketSelection* selection) {
 	
+	rankedSelection = selection;
+
 }
 
 
 /**
  *
- * This method is private. While the program iterating through the hash table containing
- * stock symbols, it maintains and generates min and max heaps, which correspond to top
- * and bottom ten percent return stocks respectively. 
+ * This method is private. It selects top and bottom ten percent return stocks of
+ * this month from the panel column with the selection engine, which runs in linear
+ * time. Stocks tied at the boundary are ranked in order of input file.
+ * If all buckets are requested, all stocks are ranked once and split into buckets
+ * instead, and the first and last buckets are the top and bottom selections.
  *
  * This method is not supposed to receive any input parameters nor to return any results.
  * This method is supposed to be called after all stock return rates have been recorded 
- *	in the hash table class member.
+ *	in the panel.
  *
  */
 void MonthlyData:: sort() {
 	
-	// Before starting heap generation, make sure 2 heaps are empty.
-	while (!topTenPercent.empty()) {
-		topTenPercent.pop();
+	if (groups != nullptr) {
+		this->sortWithinGroups();
+		return;
 	}
 	
-	while (!bottomTenPercent.empty()) {
-		bottomTenPercent.pop();
-	}
+	PROFILE_MONTH_STAGE(RANK, getDateLabel());
+	
+	// Only stocks with a return rate this month are ranked, and the proper size
+	// (10% of them) of selections is counted from the validity mask.
+	unsigned long numSymbols = panel->getNumSymbols();
+	tenPercentSize = panel->countValid(monthIndex) / numBuckets;
 	
-	// Calculate the proper size (10% of total stocks) of heaps.
-	tenPercentSize = stockReturns.size() / 10;
+	Ranking ranking;
+	ranking.assignValid(panel->getMonthColumn(monthIndex), panel->getValidMask(monthIndex), numSymbols);
 	
-	// Maintain the max and min heap while iterating the hash table.
-	// Each sample is a pair of string, or stock symbol, and double, or return rate.
-	for (const auto& sample : stockReturns) {
+	if (allBuckets) {
 		
-		// Min heap maintenance: if it is under-sized, add new sample into the heap.
-		// If it is over-sized and new sample has a larger return than the value on
-		// heap top, the top will be replaced by new sample, otherwise new sample
-		// will be discarded.
-		// All return rates in the heap will be the larger ten percent.
-		if (topTenPercent.size() < tenPercentSize) {
-			topTenPercent.push(DataSample(sample));
-		} else {
-			
-			if (sample.second >= topTenPercent.top().returnRate) {
-				
-				topTenPercent.pop();
-				topTenPercent.push(DataSample(sample));
-				
+		ranking.rankBuckets(numBuckets, buckets);
+		topTenPercent = buckets.front();
+		bottomTenPercent = buckets.back();
+	
+	} else {
+		
+		ranking.selectTop(tenPercentSize, topTenPercent);
+		ranking.selectBottom(tenPercentSize, bottomTenPercent);
+	
+	}
+
+}
+
+
+/**
+ *
+ * This method is private. It selects top and bottom ten percent return stocks of
+ * every group separately, e.g. the top 10% of each sector, and combines them, so
+ * the selections are neutral to groups.
+ * Stocks with a return rate this month and a group are first partitioned by group
+ * with a counting sort: one pass over the validity mask counts stocks of each
+ * group, and a second one places their IDs group by group into one array, still in
+ * ascending order within a group. Then every group is ranked on its own slice of
+ * the array, on the thread pool if one is given, and selections of the same bucket
+ * are merged in ascending ID order.
+ * A group with fewer stocks than buckets contributes no stock to top and bottom
+ * ten percent.
+ *
+ * This method is supposed to be called through sort().
+ *
+ */
+void MonthlyData::sortWithinGroups() {
+	
+	PROFILE_MONTH_STAGE(RANK, getDateLabel());
+	
+	unsigned long numGroups = groups->getNumGroups();
+	const unsigned long* symbolGroups = groups->getGroups();
+	const uint64_t* mask = panel->getValidMask(monthIndex);
+	const double* column = panel->getMonthColumn(monthIndex);
+	
+	// Stocks of group g are members[offsets[g]] to members[offsets[g + 1] - 1].
+	vector<unsigned long> offsets(numGroups + 1, 0);
+	for (unsigned long w = 0; w < panel->getMaskWords(); w++) {
+		for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+			unsigned long group = symbolGroups[w * 64 + __builtin_ctzll(bits)];
+			if (group != GroupMap::NO_GROUP) {
+				offsets[group + 1]++;
 			}
 		}
+	}
+	for (unsigned long g = 0; g < numGroups; g++) {
+		offsets[g + 1] += offsets[g];
+	}
+	
+	vector<unsigned long> members(offsets[numGroups]);
+	vector<unsigned long> next(offsets.begin(), offsets.end() - 1);
+	for (unsigned long w = 0; w < panel->getMaskWords(); w++) {
+		for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+			unsigned long symbolId = w * 64 + __builtin_ctzll(bits);
+			unsigned long group = symbolGroups[symbolId];
+			if (group != GroupMap::NO_GROUP) {
+				members[next[group]++] = symbolId;
+			}
+		}
+	}
+	
+	// Buckets of every group, or only its top and bottom ones. Each group writes its
+	// own slot, so groups can be ranked in any order.
+	vector<vector<vector<unsigned long>>> groupBuckets(numGroups);
+	
+	auto rankGroup = [this, column, &offsets, &members, &groupBuckets](unsigned long g) {
 		
-		// Similar to min heap maintenance, the only difference is that it keeps a
-		// max heap, so comparator is inversed.
-		if (bottomTenPercent.size() < tenPercentSize) {
-			bottomTenPercent.push(DataSample(sample));
+		unsigned long groupSize = offsets[g + 1] - offsets[g];
+		unsigned long bucketSize = groupSize / numBuckets;
+		
+		Ranking ranking;
+		ranking.assign(column, members.data() + offsets[g], groupSize);
+		
+		if (allBuckets) {
+			ranking.rankBuckets(numBuckets, groupBuckets[g]);
 		} else {
-			
-			if (sample.second <= bottomTenPercent.top().returnRate) {
-				
-				bottomTenPercent.pop();
-				bottomTenPercent.push(DataSample(sample));
-				
-			}
+			groupBuckets[g].resize(2);
+			ranking.selectTop(bucketSize, groupBuckets[g][0]);
+			ranking.selectBottom(bucketSize, groupBuckets[g][1]);
+		}
+	};
+	
+	if (groupPool != nullptr) {
+		groupPool->parallelFor(numGroups, rankGroup);
+	} else {
+		for (unsigned long g = 0; g < numGroups; g++) {
+			rankGroup(g);
 		}
 	}
 	
+	// Selections of the same bucket are merged over groups.
+	buckets.assign(allBuckets ? numBuckets : 2, vector<unsigned long>());
+	for (const vector<vector<unsigned long>>& selections : groupBuckets) {
+		for (unsigned long b = 0; b < selections.size(); b++) {
+			buckets[b].insert(buckets[b].end(), selections[b].begin(), selections[b].end());
+		}
+	}
+	for (vector<unsigned long>& bucket : buckets) {
+		std::sort(bucket.begin(), bucket.end());
+	}
+	
+	topTenPercent = buckets.front();
+	bottomTenPercent = buckets.back();
+	tenPercentSize = topTenPercent.size();
+	
+	if (!allBuckets) {
+		buckets.clear();
+	}
+
 }
 
 
 /**
  *
- * This method extracts top ten percent return rates from the min heap one by one,
- * for each data sample, or pair of stock symbol and return rate, it refer to next month
- * data and append next month return rate to recording vector/array.
- * This method is supposed to be called after the sort() method is executed.
- * 
- * @param nextMonth: an iterator, specifying address of next month data in the STL linked list.
+ * This method is private. It takes top and bottom ten percent, and every bucket if
+ * all buckets are requested, from a selection ranked by an earlier run, as sort()
+ * would select them.
  *
- * No value is supposed to be returned.
+ * This method is supposed to be called through getMonthReturn().
  *
  */
-void MonthlyData:: getTopTenPercentReturns(const list<MonthlyData>::iterator& nextMonth) {
+void MonthlyData::reuseSelection() {
 	
-	// Make sure recording vector/array is empty.
-	topTenPercentReturns.clear();
+	topTenPercent = rankedSelection->front();
+	bottomTenPercent = rankedSelection->back();
+	tenPercentSize = topTenPercent.size();
 	
-	// Extracting heap elements by one, and retrieve next month return of
-	// current stock, then append the next month return to the record.
-	// If all elements in the heap are all processed, exit this loop.
-	while (!topTenPercent.empty()) {
-		
-		string symbol = topTenPercent.top().corpSymbol;
-		double nextMonthReturn = nextMonth->getSingleReturn(symbol);
-		topTenPercentReturns.push_back(nextMonthReturn);
-		topTenPercent.pop();
-		
+	if (allBuckets) {
+		buckets = *rankedSelection;
 	}
-	
+
 }
 
 
 /**
  *
- * This method extracts bottom ten percent return rates from the max heap one by one,
- * for each data sample, or pair of stock symbol and return rate, it refer to next month
- * data and append next month return rate to recording vector/array.
- * This method is supposed to be called after the sort() method is executed.
+ * This method calculates next month's average return rate and stock count of every
+ * bucket, counting only stocks with a return rate next month. This method is
+ * supposed to be called after the sort() method is executed with all buckets
+ * requested.
  *
- * @param nextMonth: an iterator, specifying address of next month data in the STL linked list.
+ * @param nextMonth: next month data, which shares the same panel with this month.
  *
  * No value is supposed to be returned.
  *
  */
-void MonthlyData::getBottomTenPercentReturn(const list<MonthlyData>::iterator& nextMonth) {
+void MonthlyData::getBucketReturns(const MonthlyData& nextMonth) {
+	
+	PROFILE_MONTH_STAGE(LOOKUP, getDateLabel());
 	
-	// Make sure recording vector/array is empty.
-	bottomTenPercentReturns.clear();
+	bucketAverages.assign(buckets.size(), 0);
+	bucketTurnovers.assign(buckets.size(), 1);
+	bucketCounts.assign(buckets.size(), 0);
 	
-	// Extracting heap elements by one, and retrieve next month return of
-	// current stock, then append the next month return to the record.
-	// If all elements in the heap are all processed, exit this loop.
-	while (!bottomTenPercent.empty()) {
+	// Return rates and weights of a bucket when value weighted.
+	vector<double> rates, rateWeights;
+	StrategyColumns columns = getColumns(nextMonth);
+	
+	for (unsigned long b = 0; b < buckets.size(); b++) {
+		
+		PROFILE_MONTH_COUNT(RETURN_LOOKUPS, getDateLabel(), buckets[b].size());
+		PROFILE_MONTH_COUNT(LOOKUP_MISSES, getDateLabel(), nextMonth.countMissing(buckets[b]));
 		
-		string symbol = bottomTenPercent.top().corpSymbol;
-		double nextMonthReturn = nextMonth->getSingleReturn(symbol);
-		bottomTenPercentReturns.push_back(nextMonthReturn);
-		bottomTenPercent.pop();
+		if (weights == nullptr) {
+			collectReturns<EqualWeightPolicy>(buckets[b], columns, rates, rateWeights);
+			bucketAverages[b] = averageReturns<EqualWeightPolicy>(rates, rateWeights);
+		} else {
+			collectReturns<ValueWeightPolicy>(buckets[b], columns, rates, rateWeights);
+			bucketAverages[b] = averageReturns<ValueWeightPolicy>(rates, rateWeights);
+		}
 		
+		bucketCounts[b] = rates.size();
 	}
-	
+
 }
 
 
 /**
  *
- * This method is inspector to get year information.
+ * This function is private to this file. It calculates one-way turnover from an
+ * equally weighted portfolio of some stocks to one of others, i.e. half the sum of
+ * absolute weight changes. Stocks held in both are counted by merging both sorted
+ * lists, so it runs in linear time without any lookup.
  *
- * return a string representing year.
+ * @param before: IDs of stocks held before, in ascending order.
+ * @param after: IDs of stocks held after, in ascending order.
+ *
+ * return share of the portfolio traded, 0 if nothing changes and 1 if every stock is replaced.
  *
  */
-string MonthlyData::getYear() const {
+static double turnover(const vector<unsigned long>& before, const vector<unsigned long>& after) {
+	
+	double numBefore = static_cast<double>(before.size());
+	double numAfter = static_cast<double>(after.size());
+	
+	if (before.empty() || after.empty()) {
+		return before.empty() && after.empty() ? 0 : 1;
+	}
 	
-	return year;
+	unsigned long common = 0;
+	auto i = before.begin(), j = after.begin();
+	while (i != before.end() && j != after.end()) {
+		if (*i < *j) {
+			i++;
+		} else if (*j < *i) {
+			j++;
+		} else {
+			common++;
+			i++;
+			j++;
+		}
+	}
 	
+	// Sold stocks, bought stocks, and resized weights of stocks held in both.
+	double kept = static_cast<double>(common);
+	return ((numBefore - kept) / numBefore + (numAfter - kept) / numAfter + kept * fabs(1 / numAfter - 1 / numBefore)) / 2;
+
 }
 
 /**
  *
- * This method is inspector to get month information.
+ * This method calculates turnover of top and bottom ten percent, and of every
+ * bucket if all buckets are requested, from previous month's selections to this
+ * month's. Membership is equally weighted, also when averages are value weighted.
+ * This method is supposed to be called after getMonthReturn() of both months.
  *
- * return a string representing month.
+ * @param previousMonth: previous month's data, which shares the same panel with this month.
  *
  */
-string MonthlyData::getMonth() const {
+void MonthlyData::getTurnover(const MonthlyData& previousMonth) {
 	
-	return month;
+	topTurnover = turnover(previousMonth.topTenPercent, topTenPercent);
+	bottomTurnover = turnover(previousMonth.bottomTenPercent, bottomTenPercent);
 	
+	for (unsigned long b = 0; b < buckets.size() && b < previousMonth.buckets.size(); b++) {
+		bucketTurnovers[b] = turnover(previousMonth.buckets[b], buckets[b]);
+	}
+
+}
+
+
+/**
+ *
+ * This method is private. It counts stocks that are missing from this month, which
+ * are left out of the averages of the buckets holding them.
+ *
+ * @param symbolIds: IDs of the stocks.
+ *
+ * return number of stocks without a return rate.
+ *
+ */
+unsigned long MonthlyData::countMissing(const vector<unsigned long>& symbolIds) const {
+	
+	unsigned long missing = 0;
+	for (const unsigned long& symbolId : symbolIds) {
+		if (!panel->isValid(symbolId, monthIndex)) {
+			missing++;
+		}
+	}
+	
+	return missing;
+
 }
 
 
 /**
  *
- * This method is inspector to get year and month information combined.
+ * This method is inspector to get date of this month.
  *
- * return a string representing year and month in format of "16-Mar".
+ * return the date as an integer, e.g. 20160300.
  *
  */
-string MonthlyData::getYearMonth() const {
+CalendarDate MonthlyData::getDate() const {
 	
-	return this->getYear() + "-" + this->getMonth();
+	return panel->getDate(monthIndex);
+
+}
+
+
+/**
+ *
+ * This method is inspector to get date of this month for output files.
+ *
+ * return a string representing the date, e.g. "16-Mar" or "2016-03-16".
+ *
+ */
+string MonthlyData::getDateLabel() const {
 	
+	return panel->getDateLabel(monthIndex);
+
 }
 
 /**
  *
  * This method is inspector to get the return rate of this month by specified 
- * input stock symbol.
+ * input stock symbol. Unknown symbols are regarded as return rate of 0.
  *
  * @param symbol: a string of company stock symbol.
  *
- * return a string representing month.
+ * return a double representing return rate.
  *
  */
-double MonthlyData::getSingleReturn(const string& symbol) {
+double MonthlyData::getSingleReturn(const string& symbol) const {
 	
-	return stockReturns[symbol];
+	unsigned long symbolId;
+	if (!panel->getSymbols().find(symbol, symbolId)) {
+		return 0;
+	}
 	
+	return getSingleReturn(symbolId);
+
+}
+
+/**
+ *
+ * This method is inspector to get the return rate of this month by specified
+ * symbol ID, which is a direct index into the panel column.
+ *
+ * @param symbolId: ID of company stock symbol in the panel.
+ *
+ * return a double representing return rate, 0 if it is missing.
+ *
+ */
+double MonthlyData::getSingleReturn(unsigned long symbolId) const {
+	
+	return panel->getMonthColumn(monthIndex)[symbolId];
+
+}
+
+/**
+ *
+ * This method is inspector to get the return rate of this month by specified
+ * symbol ID, telling whether the rate is missing. Nothing is changed by lookups.
+ *
+ * @param symbolId: ID of company stock symbol in the panel.
+ * @param rate: output parameter receiving the return rate, if it is valid.
+ *
+ * return false if return rate of the stock is missing in this month.
+ *
+ */
+bool MonthlyData::findReturn(unsigned long symbolId, double& rate) const {
+	
+	if (!panel->isValid(symbolId, monthIndex)) {
+		return false;
+	}
+	
+	rate = panel->getMonthColumn(monthIndex)[symbolId];
+	return true;
+
+}
+
+/**
+ *
+ * This method is private. It locates the columns a strategy kernel reads: next
+ * month's return rates and validity mask, and this month's weights and their
+ * validity mask if value weighted.
+ *
+ * @param nextMonth: next month's data, which shares the same panel with this month.
+ *
+ * return the columns, with null weights when equally weighted.
+ *
+ */
+StrategyColumns MonthlyData::getColumns(const MonthlyData& nextMonth) const {
+	
+	StrategyColumns columns;
+	columns.nextRates = nextMonth.panel->getMonthColumn(nextMonth.monthIndex);
+	columns.nextValid = nextMonth.panel->getValidMask(nextMonth.monthIndex);
+	columns.weights = weights == nullptr ? nullptr : weights->getMonthColumn(monthIndex);
+	columns.weightsValid = weights == nullptr ? nullptr : weights->getValidMask(monthIndex);
+	
+	return columns;
+
 }
 
 /**
  *
  * This method is inspector to get calculated average next month's return rate 
  * of top ten percent stocks in this month. 
- * This method is supposed to be called after sorting method and heap processing
+ * This method is supposed to be called after sorting method and selection processing
  * method is finished.
  *
  * return a double which is the value of average return rate.
@@ -265,15 +566,15 @@ double MonthlyData::getSingleReturn(const string& symbol) {
  */
 double MonthlyData::getTopTenPercentReturn() const {
 	
-	return topTenPercentAverage;
-	
+	return legReturns.topAverage;
+
 }
 
 /**
  *
  * This method is inspector to get calculated average next month's return rate
  * of bottom ten percent stocks in this month.
- * This method is supposed to be called after sorting method and heap processing
+ * This method is supposed to be called after sorting method and selection processing
  * method is finished.
  *
  * return a double which is the value of average return rate.
@@ -281,15 +582,15 @@ double MonthlyData::getTopTenPercentReturn() const {
  */
 double MonthlyData::getBottomTenPercentReturn() const {
 	
-	return bottomTenPercentAverage;
-	
+	return legReturns.bottomAverage;
+
 }
 
 /**
  *
- * This method is inspector to get calculated average next month's return rate
- * of both top and bottom ten percent stocks in this month.
- * This method is supposed to be called after sorting method and heap processing
+ * This method is inspector to get calculated next month's return of the strategy,
+ * by default bottom minus top ten percent stocks' average return rate in this month.
+ * This method is supposed to be called after sorting method and selection processing
  * method is finished.
  *
  * return a double which is the value of average return rate.
@@ -298,63 +599,256 @@ double MonthlyData::getBottomTenPercentReturn() const {
 double MonthlyData::getMonthReturn() const {
 	
 	return monthAverage;
+
+}
+
+
+/**
+ *
+ * This method is inspector to get number of buckets.
+ *
+ * return number of buckets.
+ *
+ */
+unsigned long MonthlyData::getNumBuckets() const {
 	
+	return numBuckets;
+
 }
 
+/**
+ *
+ * This method is inspector to check whether results of all buckets are calculated.
+ *
+ * return true if all buckets are requested.
+ *
+ */
+bool MonthlyData::hasAllBuckets() const {
+	
+	return allBuckets;
+
+}
 
 /**
  *
- * This method is a mutator which insert new stock symbol along with its current monthly 
- * return rate into the hash table.
- * This method is supposed to be called during the monthly data construction stage. 
- * If this method is called, i.e., stock information is modified, after a sorting 
- * and heap analysis process, please execute the analysis process again. 
- * This method is not supposed to return any value.
+ * This method is inspector to get next month's average return rate of a bucket.
+ * This method is supposed to be called after getMonthReturn() with all buckets requested.
+ *
+ * @param bucket: index of bucket, 0 has highest return rates in this month.
  *
- * @param symbol: a string of stock company symbol.
- * @param rate: a double number contains value of return rate in current month.
+ * return a double which is the value of average return rate.
  *
  */
-void MonthlyData::addData(const string& symbol, const double& rate) {
+double MonthlyData::getBucketReturn(unsigned long bucket) const {
 	
-	stockReturns[symbol] = rate;
+	return bucket < bucketAverages.size() ? bucketAverages[bucket] : 0;
+
+}
+
+/**
+ *
+ * This method is inspector to get number of stocks in a bucket.
+ * This method is supposed to be called after getMonthReturn() with all buckets requested.
+ *
+ * @param bucket: index of bucket, 0 has highest return rates in this month.
+ *
+ * return number of stocks.
+ *
+ */
+unsigned long MonthlyData::getBucketCount(unsigned long bucket) const {
 	
+	return bucket < bucketCounts.size() ? bucketCounts[bucket] : 0;
+
 }
 
 
 /**
  *
- * This method is designed as a wrapper process of heap generating, analysis and average 
- * values calculating. It calls private methods for heap process in proper order, so improper
+ * This method is designed as a wrapper process of stock selection, analysis and average 
+ * values calculating. It calls private methods for selection process in proper order, so improper
  * execution sequence by users can be prevented. 
- * This function is supposed to be called when all stock return rates are inserted into hash table. 
+ * This function is supposed to be called when all stock return rates are stored in the panel. 
  * 
- * @param nextMonth: an iterator specifying address of next month's data in a STL linked list
+ * @param nextMonth: next month's data, which shares the same panel with this month.
  *
  */
-double MonthlyData::getMonthReturn(const list<MonthlyData>::iterator& nextMonth) {
-	
-	// Calls to private methods.
-	this->sort();
-	this->getTopTenPercentReturns(nextMonth);
-	this->getBottomTenPercentReturn(nextMonth);
+double MonthlyData::getMonthReturn(const MonthlyData& nextMonth) {
 	
-	// Calculating top ten percentage next month's average return rate.
-	for (const double& rate : topTenPercentReturns) {
-		topTenPercentAverage += rate;
+	// Calls to private methods. A selection of an earlier run replaces ranking.
+	if (rankedSelection != nullptr) {
+		this->reuseSelection();
+	} else {
+		this->sort();
 	}
-	topTenPercentAverage /= static_cast<double>(tenPercentSize);
 	
-	// Calculating bottom ten percentage next month's average return rate.
-	for (const double& rate : bottomTenPercentReturns) {
-		bottomTenPercentAverage += rate;
+	{
+		PROFILE_MONTH_STAGE(LOOKUP, getDateLabel());
+		PROFILE_MONTH_COUNT(RETURN_LOOKUPS, getDateLabel(), topTenPercent.size() + bottomTenPercent.size());
+		PROFILE_MONTH_COUNT(LOOKUP_MISSES, getDateLabel(), nextMonth.countMissing(topTenPercent) + nextMonth.countMissing(bottomTenPercent));
+		
+		// Options are dispatched once, the kernel compiled for them averages both
+		// selections and combines them into return of the strategy.
+		StrategyKernel kernel = selectKernel(strategy, weights != nullptr);
+		monthAverage = kernel(topTenPercent, bottomTenPercent, getColumns(nextMonth), legReturns);
 	}
-	bottomTenPercentAverage /= static_cast<double>(tenPercentSize);
 	
-	// Calculate the average of top ten and bottom ten percent next month's return rate. 
-	monthAverage = bottomTenPercentAverage - topTenPercentAverage;
+	if (allBuckets) {
+		this->getBucketReturns(nextMonth);
+	}
 	
 	return monthAverage;
 }
 
 
+/**
+ *
+ * This method is inspector to copy calculated results of this month, so they can
+ * be kept after the panel is released. This method is supposed to be called after
+ * getMonthReturn().
+ *
+ * return results of the period starting from this month.
+ *
+ */
+PeriodResult MonthlyData::getResult() const {
+	
+	PeriodResult result;
+	
+	result.date = this->getDateLabel();
+	result.topAverage = legReturns.topAverage;
+	result.bottomAverage = legReturns.bottomAverage;
+	result.average = monthAverage;
+	result.bucketAverages = bucketAverages;
+	result.bucketCounts = bucketCounts;
+	result.topTurnover = topTurnover;
+	result.bottomTurnover = bottomTurnover;
+	result.bucketTurnovers = bucketTurnovers;
+	
+	return result;
+
+}
+
+
+/**
+ *
+ * This method is inspector to copy selected stocks lists of this month, so a later
+ * run with the same ranking can reuse them. This method is supposed to be called
+ * after getMonthReturn().
+ *
+ * return every bucket if all buckets are requested, otherwise top and bottom ones.
+ *
+ */
+BucketSelection MonthlyData::getSelection() const {
+	
+	if (allBuckets) {
+		return buckets;
+	}
+	
+	return BucketSelection({topTenPercent, bottomTenPercent});
+
+}
+
+
+/**
+ *
+ * This function views every month of a panel, and calculates results of every
+ * period, i.e. every month except the latest one, with calculatePeriodRange().
+ *
+ * Parameters are the same as of calculatePeriodRange(), without the range.
+ *
+ * return results of every period in chronological order.
+ *
+ */
+vector<PeriodResult> calculatePeriods(const PanelData& panel, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const PanelData* weights, const GroupMap* groups, const Strategy& strategy, vector<BucketSelection>* selections) {
+	
+	unsigned long numPeriods = panel.getNumMonths() == 0 ? 0 : panel.getNumMonths() - 1;
+	
+	return calculatePeriodRange(panel, 0, numPeriods, numBuckets, allBuckets, pool, weights, groups, strategy, selections);
+
+}
+
+
+/**
+ *
+ * This function views months of a panel from a formation month on, and calculates
+ * results of a number of periods, each formation month being followed by the next
+ * month. Turnover of the first period is left as 1. Each month only writes its own
+ * results and reads next month's panel column, so months can be processed in any
+ * order and the results are identical to serial processing.
+ *
+ * @param panel: the panel which stores return rates of all months, already transposed.
+ * @param firstMonth: index of the first formation month.
+ * @param numPeriods: number of periods, limited to months available after firstMonth.
+ * @param numBuckets: number of buckets stocks are split into.
+ * @param allBuckets: whether to calculate results of every bucket.
+ * @param pool: thread pool to process months on, or null to process them serially.
+ * @param weights: panel of values aligned with the panel, e.g. market caps, to
+ *			weight stocks by, or null for equal weights.
+ * @param groups: groups of the symbols of the panel, e.g. sectors, which stocks are
+ *			ranked within, or null to rank all stocks together. The pool then
+ *			ranks groups of a month in parallel, and months are processed in turn.
+ * @param strategy: direction and legs of the portfolio built from top and bottom buckets.
+ * @param selections: selections of every period ranked by an earlier run with the
+ *			same buckets and groups, which replace ranking; if it doesn't hold one
+ *			per period, it receives the selections of this run. Null to rank only.
+ *
+ * return results of the periods in chronological order.
+ *
+ */
+vector<PeriodResult> calculatePeriodRange(const PanelData& panel, unsigned long firstMonth, unsigned long numPeriods, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const PanelData* weights, const GroupMap* groups, const Strategy& strategy, vector<BucketSelection>* selections) {
+	
+	if (firstMonth + 1 >= panel.getNumMonths()) {
+		return vector<PeriodResult>();
+	}
+	numPeriods = min(numPeriods, panel.getNumMonths() - 1 - firstMonth);
+	
+	bool reuseSelections = (selections != nullptr && selections->size() == numPeriods);
+	
+	// Months are viewed in chronological order, earliest month first.
+	vector<MonthlyData> allData;
+	allData.reserve(numPeriods + 1);
+	for (unsigned long m = firstMonth; m <= firstMonth + numPeriods; m++) {
+		allData.push_back(MonthlyData(panel, m));
+		allData.back().setBuckets(numBuckets, allBuckets);
+		allData.back().setWeights(weights);
+		allData.back().setGroups(groups, pool);
+		allData.back().setStrategy(strategy);
+		allData.back().setSelection(reuseSelections && m < firstMonth + numPeriods ? &(*selections)[m - firstMonth] : nullptr);
+		PROFILE_ADD_MONTH(allData.back().getDateLabel());
+	}
+	
+	if (pool != nullptr && groups == nullptr) {
+		
+		pool->parallelFor(numPeriods, [&allData](unsigned long m) {
+			allData[m].getMonthReturn(allData[m + 1]);
+		});
+	
+	} else {
+		
+		for (unsigned long m = 0; m < numPeriods; m++) {
+			allData[m].getMonthReturn(allData[m + 1]);
+		}
+	
+	}
+	
+	// Turnover needs selections of both months, so it follows all of them.
+	for (unsigned long m = 1; m < numPeriods; m++) {
+		allData[m].getTurnover(allData[m - 1]);
+	}
+	
+	vector<PeriodResult> results;
+	for (unsigned long m = 0; m < numPeriods; m++) {
+		results.push_back(allData[m].getResult());
+	}
+	
+	if (selections != nullptr && !reuseSelections) {
+		selections->clear();
+		for (unsigned long m = 0; m < numPeriods; m++) {
+			selections->push_back(allData[m].getSelection());
+		}
+	}
+	
+	return results;
+
+}
+
+
@@ -10,10 +10,12 @@
 #define MonthlyData_h
 
 #include <string>
-#include <list>
 #include <vector>
-#include <unordered_map>
-#include <queue>
+#include "PanelData.h"
+#include "Ranking.h"
+#include "ThreadPool.h"
+#include "GroupMap.h"
+#include "Strategy.h"
 
 using namespace std;
 
@@ -31,129 +33,211 @@ using namespace std;
 
 /**
  *
- * This struct is pair of company symbol and monthly return rate,
- * which are stored as strings, and double numbers, respectively.
+ * This struct keeps calculated results of one period, i.e. a formation month and
+ * its next month, after the panel holding their return rates is gone.
  *
  */
-struct DataSample {
-	
-	// Keep company symbols with corresponding monthly return together.
-	string corpSymbol;
-	double returnRate;
-	
-	// Default constructor.
-	DataSample() :
-	corpSymbol(""), returnRate(0) {}
-	
-	// Constructor with separate input value of symbol and return rate.
-	DataSample(const string& symbol, const double& rate) :
-	corpSymbol(symbol), returnRate(rate) {}
-	
-	// Constructor with integrate pair of symbol and return rate.
-	DataSample(const pair<string, double>& sample) :
-	corpSymbol(sample.first), returnRate(sample.second) {}
-	
+struct PeriodResult {
+	
+	// Date of formation month, e.g. "16-Mar" or "2016-03-16", formatted once per period.
+	string date;
+	
+	// Next month's average return of top and bottom buckets, and return of the
+	// strategy, by default their difference.
+	double topAverage;
+	double bottomAverage;
+	double average;
+	
+	// Next month's average return and stock count of each bucket, if requested.
+	vector<double> bucketAverages;
+	vector<unsigned long> bucketCounts;
+	
+	// Share of top and bottom buckets traded since previous formation month, and of
+	// each bucket if requested. The first period buys whole buckets, i.e. 1.
+	double topTurnover = 1;
+	double bottomTurnover = 1;
+	vector<double> bucketTurnovers;
+
 };
 
+
+// Symbol IDs of the buckets a formation month is split into, in ascending order and
+// top bucket first: only top and bottom buckets, or every bucket if all are requested.
+typedef vector<vector<unsigned long>> BucketSelection;
+
+
 /**
  *
- * This class stores the return rates in the same month of all companies. 
+ * This class is a view over return rates in the same month of all companies,
+ * which are stored in one column of a PanelData object.
  *
  * Year and month indicate date.
- * The hash table stores return rates of companies identified by company symbol.
- * Two priority queues are used to keep track of stocks that have a return rate of 
+ * The panel and month index locate the column of return rates, indexed by symbol ID.
+ * Two vectors of symbol IDs keep track of stocks that have a return rate of 
  *	top ten percent or bottom ten percent in this month.
  * Two vectors are used to store next month's return rates, which correspond to top
  *	or bottom ten percent in this month.
+ * Stocks can be split into N buckets instead of ten, then "ten percent" above means
+ *	1/N of stocks. If all buckets are requested, every stock is assigned to its
+ *	bucket, and next month's average return and stock count of each bucket are kept.
+ * Return rates marked missing ("#N/A") are excluded rather than taken as 0: only
+ *	stocks with a return rate this month are ranked, and averages only count
+ *	selected stocks with a return rate next month.
+ * Averages are equally weighted, or weighted by value of each stock in formation
+ *	month, e.g. market cap, when a panel of values aligned with return rates is given.
+ * Return of the month is bottom average minus top average by default, or return
+ *	of another strategy, e.g. momentum or long-only, calculated by a kernel compiled
+ *	for its options and chosen once per month.
+ * When a group map is given, e.g. sectors, stocks are ranked within their group
+ *	instead: stocks of the month are partitioned by group in one counting sort pass,
+ *	each group is split into N buckets on its own, and buckets of the same rank are
+ *	combined over groups. Stocks without a group are left out.
+ * Selected symbol IDs are kept sorted after the month is processed, so turnover of
+ *	each bucket since previous month is counted by a linear merge of both lists.
+ * Selections only depend on return rates of this month, number of buckets and
+ *	groups, so a selection kept by an earlier run on the same input can be reused
+ *	when only weights or strategy change, and the month is not ranked again.
  *
  */
 class MonthlyData {
-	
+
 private:
 	
-	// This is the function object to help maintianing the max heap which
-	// keeps track of bottom ten percent return rates.
-	struct maxHeapComparator {
-		bool operator () (const DataSample& smaller, const DataSample& larger) const {
-			return smaller.returnRate < larger.returnRate;
-		}
-	};
-	
-	// This is the function object to help maintaining the min heap which
-	// keeps track of top ten percent return rates.
-	struct minHeapComparator {
-		bool operator () (const DataSample& smaller, const DataSample& larger) const {
-			return larger.returnRate < smaller.returnRate;
-		}
-	};
+	// The panel owning return rates, and index of this month in the panel.
+	// The column of this month acts as database of this month's data, which is
+	// core of functionality.
+	const PanelData* panel;
+	unsigned long monthIndex;
 	
-	// Year and month information.
-	string year;
-	string month;
 	
+	// Number of buckets, and whether results of all buckets are calculated.
+	unsigned long numBuckets;
+	bool allBuckets;
 	
-	// The hash table to store return rates of all stocks in the same month,
-	// return rate values are identified by stock symbol, the string.
-	// This variable acts as database of this month's data, which is core of functionality. 
-	unordered_map<string, double> stockReturns;
+	// Panel of stock values to weight averages by, aligned with the panel, or null
+	// for equal weights.
+	const PanelData* weights;
 	
+	// Groups which stocks are ranked within, or null to rank all stocks together,
+	// and the pool groups are ranked on in parallel, or null to rank them serially.
+	const GroupMap* groups;
+	ThreadPool* groupPool;
 	
-	// The min and max heaps to keep track of top and bottom ten percent return rate stocks.
-	// The long variable is calculated proper size of heap size.
+	// Symbol IDs of top and bottom ten percent return rate stocks, in ascending order.
+	// The long variable is calculated proper size of both selections.
 	unsigned long tenPercentSize;
-	priority_queue<DataSample, vector<DataSample>, minHeapComparator> topTenPercent;
-	priority_queue<DataSample, vector<DataSample>, maxHeapComparator> bottomTenPercent;
+	vector<unsigned long> topTenPercent;
+	vector<unsigned long> bottomTenPercent;
 	
 	
+	// Selection of an earlier run with the same ranking, used instead of ranking this
+	// month, or null.
+	const BucketSelection* rankedSelection;
+	
+	// Strategy which builds the portfolio from top and bottom ten percent.
+	Strategy strategy;
+	
 	// Retrieved next month's return rates which correspond to top or bottom ten percent
-	// return rates in this month.
-	vector<double> topTenPercentReturns;
-	vector<double> bottomTenPercentReturns;
+	// return rates in this month, weights of the same stocks when value weighted, and
+	// their averages. Stocks missing next month are left out.
+	LegReturns legReturns;
 	
-	// Calculated return results.
-	double topTenPercentAverage;
-	double bottomTenPercentAverage;
+	// Symbol IDs of stocks in each bucket, bucket 0 has highest return rates.
+	// Only filled when all buckets are requested.
+	vector<vector<unsigned long>> buckets;
+	
+	// Calculated return of the portfolio.
 	double monthAverage;
 	
-	// The method generates max and min heap, or the bottom and top ten percent
-	// return rate stocks list.
+	// Calculated next month's average return and stock count of each bucket.
+	vector<double> bucketAverages;
+	vector<unsigned long> bucketCounts;
+	
+	// Turnover of top and bottom buckets, and of each bucket, since previous month.
+	double topTurnover;
+	double bottomTurnover;
+	vector<double> bucketTurnovers;
+	
+	// The method selects the bottom and top ten percent return rate stocks list.
 	void sort();
 	
-	// This method is to retrieve next month's return values correspond to stocks of
-	// top ten percent return rates in this month.
-	void getTopTenPercentReturns(const list<MonthlyData>::iterator& nextMonth);
+	// The method selects the same stocks lists within every group, and combines them.
+	void sortWithinGroups();
+	
+	// The method takes the stocks lists of a selection ranked by an earlier run.
+	void reuseSelection();
 	
-	// This method is similar to previous one, which returns values correspond to
-	// stocks of bottom ten percent return rates in this month.
-	void getBottomTenPercentReturn(const list<MonthlyData>::iterator& nextMonth);
+	// This method calculates next month's average return of every bucket.
+	void getBucketReturns(const MonthlyData& nextMonth);
 	
+	// This method locates next month's return rates and this month's weights for kernels.
+	StrategyColumns getColumns(const MonthlyData& nextMonth) const;
+	
+	// This method counts given stocks without a return rate in this month.
+	unsigned long countMissing(const vector<unsigned long>& symbolIds) const;
+
 public:
 	
-	// A default constructor specifying year and month.
-	MonthlyData(const string& y, const string& m);
-	// The copy constructor.
-	MonthlyData(const MonthlyData& copy);
+	// A default constructor specifying the panel and index of month in it.
+	MonthlyData(const PanelData& p, unsigned long m);
+	
+	// The mutator to split stocks into N buckets, and whether to keep all of them.
+	void setBuckets(unsigned long n, bool all);
+	
+	// The mutator to weight stocks by values of an aligned panel, e.g. market caps.
+	void setWeights(const PanelData* w);
+	
+	// The mutator to rank stocks within groups, e.g. sectors, on a thread pool or serially.
+	void setGroups(const GroupMap* g, ThreadPool* pool);
+	
+	// The mutator to choose direction and legs of the portfolio.
+	void setStrategy(const Strategy& s);
 	
-	// Inspectors for date information.
-	string getYear() const;
-	string getMonth() const;
-	string getYearMonth() const;
+	// The mutator to reuse a selection ranked by an earlier run instead of ranking, or null to rank.
+	void setSelection(const BucketSelection* selection);
 	
-	// Inspector to retrieve stock return value of input company symbol.
-	double getSingleReturn(const string& symbol);
+	// Inspectors for date of this month, as an integer and as label for output files.
+	CalendarDate getDate() const;
+	string getDateLabel() const;
+	
+	// Inspectors to retrieve stock return value of input company symbol or symbol ID.
+	double getSingleReturn(const string& symbol) const;
+	double getSingleReturn(unsigned long symbolId) const;
+	
+	// Inspector to retrieve stock return value of a symbol ID, false if it is missing.
+	bool findReturn(unsigned long symbolId, double& rate) const;
 	
 	// Inspectors for calculated average return rates.
 	double getTopTenPercentReturn() const;
 	double getBottomTenPercentReturn() const;
 	double getMonthReturn() const;
 	
-	// The mutator to insert stock symbol and return rate into hash table.
-	void addData(const string& symbol, const double& rate);
+	// Inspectors for bucket settings and results of each bucket.
+	unsigned long getNumBuckets() const;
+	bool hasAllBuckets() const;
+	double getBucketReturn(unsigned long bucket) const;
+	unsigned long getBucketCount(unsigned long bucket) const;
+	
+	// A wrapper method to select 2 stock lists first, and calulate average return values.
+	double getMonthReturn(const MonthlyData& nextMonth);
+	
+	// The method calculates turnover of buckets since previous month's selections.
+	void getTurnover(const MonthlyData& previousMonth);
 	
-	// A wrapper method to generate 2 heaps first, and calulate average return values.
-	double getMonthReturn(const list<MonthlyData>::iterator& nextMonth);
+	// Inspector to copy calculated results, which stay valid without the panel.
+	PeriodResult getResult() const;
 	
+	// Inspector to copy selected stocks lists, which can be reused by a later run.
+	BucketSelection getSelection() const;
+
 };
 
 
+// The function calculates results of every period of a panel, on a thread pool or serially.
+vector<PeriodResult> calculatePeriods(const PanelData& panel, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const PanelData* weights = nullptr, const GroupMap* groups = nullptr, const Strategy& strategy = Strategy(), vector<BucketSelection>* selections = nullptr);
+
+// The function calculates results of a number of periods from a formation month on, on a thread pool or serially.
+vector<PeriodResult> calculatePeriodRange(const PanelData& panel, unsigned long firstMonth, unsigned long numPeriods, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const PanelData* weights, const GroupMap* groups, const Strategy& strategy, vector<BucketSelection>* selections);
+
+
 #endif /* MonthlyData_h */
@@ -0,0 +1,700 @@
+//
+//  PanelCache.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "PanelCache.h"
+#include "Profiler.h"
+#include "MappedFile.h"
+#include "Hashing.h"
+#include "CsvReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of PanelCache class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Magic bytes and format version of cache files.
+static const char cacheMagic[8] = {'R', 'C', 'P', 'A', 'N', 'E', 'L', '1'};
+static const uint64_t cacheVersion = 2;
+
+// Alignment of the matrix inside cache file, one cache line.
+static const uint64_t matrixAlignment = 64;
+
+/**
+ *
+ * This helper lays out dates of all months as the dates section of a cache file.
+ *
+ */
+static string packDates(const Calendar& calendar) {
+	
+	string section(calendar.size() * sizeof(CalendarDate), '\0');
+	for (unsigned long m = 0; m < calendar.size(); m++) {
+		CalendarDate date = calendar.getDate(m);
+		memcpy(&section[m * sizeof(date)], &date, sizeof(date));
+	}
+	
+	return section;
+
+}
+
+/**
+ *
+ * This helper reads the dates section of a cache file into a calendar.
+ *
+ * @param section: start of the section.
+ * @param numMonths: number of dates in the section.
+ * @param calendar: an empty calendar.
+ *
+ */
+static void unpackDates(const char* section, uint64_t numMonths, Calendar& calendar) {
+	
+	for (uint64_t m = 0; m < numMonths; m++) {
+		CalendarDate date;
+		memcpy(&date, section + m * sizeof(date), sizeof(date));
+		calendar.add(date);
+	}
+
+}
+
+/**
+ *
+ * This helper reads the next '\0' terminated string of a section.
+ *
+ * @param cur: start of the string, moved past its terminator.
+ * @param last: end of the section.
+ * @param value: output parameter receiving the string.
+ *
+ * return false if the section ends before a terminator.
+ *
+ */
+static bool readString(const char*& cur, const char* last, string& value) {
+	
+	const void* found = memchr(cur, '\0', last - cur);
+	if (found == nullptr) {
+		return false;
+	}
+	
+	value.assign(cur, static_cast<const char*>(found));
+	cur = static_cast<const char*>(found) + 1;
+	
+	return true;
+
+}
+
+/**
+ *
+ * This is default constructor which records size and modification time of
+ * input file. The cache file is not touched until load() or save().
+ *
+ * @param inputFileName: path of input csv file.
+ *
+ */
+PanelCache::PanelCache(const string& inputFileName) : sourceName(inputFileName), cacheName(inputFileName + ".panel") {
+	
+	sourceSize = 0;
+	sourceSeconds = 0;
+	sourceNanoseconds = 0;
+	cacheSize = 0;
+	
+	struct stat status;
+	sourceFound = (stat(sourceName.c_str(), &status) == 0);
+	
+	if (sourceFound) {
+		
+		sourceSize = static_cast<uint64_t>(status.st_size);
+		sourceSeconds = static_cast<uint64_t>(status.st_mtime);
+#ifdef __APPLE__
+		sourceNanoseconds = static_cast<uint64_t>(status.st_mtimespec.tv_nsec);
+#else
+		sourceNanoseconds = static_cast<uint64_t>(status.st_mtim.tv_nsec);
+#endif
+	
+	}
+
+}
+
+/**
+ *
+ * This method is private. It maps input file and hashes its content.
+ *
+ * @param hash: output parameter receiving the hash value.
+ *
+ * return false if input file cannot be mapped.
+ *
+ */
+bool PanelCache::hashSource(uint64_t& hash) const {
+	
+	MappedFile source(sourceName);
+	if (!source.isOpen()) {
+		return false;
+	}
+	
+	hash = hashBytes(source.getData(), source.getSize());
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method is inspector to get name of cache file.
+ *
+ * return input file name followed by ".panel".
+ *
+ */
+const string& PanelCache::getCacheName() const {
+	
+	return cacheName;
+
+}
+
+/**
+ *
+ * This method is inspector to get size of the cache file loaded by load().
+ *
+ * return number of bytes, or 0 if nothing was loaded.
+ *
+ */
+unsigned long PanelCache::getSize() const {
+	
+	return cacheSize;
+
+}
+
+/**
+ *
+ * This method reads the header of the cache file and checks it against input
+ * file, and that every section lies inside the file. If input file only got a new
+ * modification time but the same content, the time recorded in cache header is
+ * updated, so the hash is not computed again by next run.
+ *
+ * @param header: output parameter receiving the header of a valid cache.
+ *
+ * return false if the cache is missing, stale or malformed.
+ *
+ */
+bool PanelCache::check(PanelCacheHeader& header) {
+	
+	if (!sourceFound) {
+		return false;
+	}
+	
+	int fd = open(cacheName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	
+	struct stat status;
+	bool readable = (fstat(fd, &status) == 0 && pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)));
+	close(fd);
+	
+	if (!readable) {
+		return false;
+	}
+	
+	uint64_t size = static_cast<uint64_t>(status.st_size);
+	
+	if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion) {
+		return false;
+	}
+	
+	if (header.sourceSize != sourceSize) {
+		return false;
+	}
+	
+	// Check that every section lies inside the file before reading any of them.
+	uint64_t matrixSize = header.numMonths * header.numSymbols * sizeof(double);
+	uint64_t maskSize = header.numMonths * ((header.numSymbols + 63) / 64) * sizeof(uint64_t);
+	
+	if (header.fileSize != size || header.datesSize != header.numMonths * sizeof(CalendarDate) || header.datesOffset + header.datesSize > size || header.symbolsOffset + header.symbolsSize > size ||
+		header.matrixOffset % matrixAlignment != 0 || header.matrixOffset + matrixSize > size ||
+		header.maskOffset % sizeof(uint64_t) != 0 || header.maskOffset + maskSize > size) {
+		return false;
+	}
+	
+	// A new modification time falls back to comparing content.
+	if (header.sourceSeconds != sourceSeconds || header.sourceNanoseconds != sourceNanoseconds) {
+		
+		uint64_t hash = 0;
+		if (!hashSource(hash) || hash != header.sourceHash) {
+			return false;
+		}
+		
+		header.sourceSeconds = sourceSeconds;
+		header.sourceNanoseconds = sourceNanoseconds;
+		
+		// The cache stays valid by hash, so a failed update is not an error.
+		fd = open(cacheName.c_str(), O_WRONLY);
+		if (fd >= 0) {
+			ssize_t written = pwrite(fd, &header, sizeof(header), 0);
+			(void)written;
+			close(fd);
+		}
+	
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method reads dates and symbols of a cache checked by check(), without
+ * touching its matrix.
+ *
+ * @param header: header of the cache.
+ * @param calendar: an empty calendar receiving dates of all months.
+ * @param symbols: an empty table receiving symbols, whose IDs are rows of the matrix.
+ *
+ * return false if the cache can't be read or its names are malformed.
+ *
+ */
+bool PanelCache::loadNames(const PanelCacheHeader& header, Calendar& calendar, SymbolTable& symbols) const {
+	
+	int fd = open(cacheName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	
+	string dates(header.datesSize, '\0'), names(header.symbolsSize, '\0');
+	bool readable = pread(fd, &dates[0], dates.size(), header.datesOffset) == static_cast<ssize_t>(dates.size()) &&
+		pread(fd, &names[0], names.size(), header.symbolsOffset) == static_cast<ssize_t>(names.size());
+	close(fd);
+	
+	if (!readable) {
+		return false;
+	}
+	
+	unpackDates(dates.data(), header.numMonths, calendar);
+	
+	string symbol;
+	const char* cur = names.data();
+	const char* last = cur + names.size();
+	for (uint64_t s = 0; s < header.numSymbols; s++) {
+		
+		if (!readString(cur, last, symbol)) {
+			return false;
+		}
+		
+		symbols.intern(symbol);
+	}
+	
+	// Duplicate symbols would shift IDs against matrix columns.
+	return symbols.size() == header.numSymbols;
+
+}
+
+/**
+ *
+ * This method maps a valid cache file into a panel.
+ * A missing, stale or malformed cache is ignored and the panel is left unchanged.
+ *
+ * @param panel: an empty panel to be filled with cached data.
+ *
+ * return true if the panel was loaded from cache.
+ *
+ */
+bool PanelCache::load(PanelData& panel) {
+	
+	PROFILE_STAGE(CACHE);
+	
+	PanelCacheHeader header;
+	if (!check(header)) {
+		return false;
+	}
+	
+	shared_ptr<MappedFile> file = make_shared<MappedFile>(cacheName);
+	if (!file->isOpen() || file->getSize() != header.fileSize) {
+		return false;
+	}
+	
+	const char* data = file->getData();
+	
+	PanelData loaded;
+	Calendar dates;
+	string symbol;
+	
+	unpackDates(data + header.datesOffset, header.numMonths, dates);
+	for (unsigned long m = 0; m < dates.size(); m++) {
+		loaded.addMonth(dates.getDate(m));
+	}
+	
+	loaded.attach(file, reinterpret_cast<const double*>(data + header.matrixOffset), reinterpret_cast<const uint64_t*>(data + header.maskOffset));
+	
+	const char* cur = data + header.symbolsOffset;
+	const char* last = cur + header.symbolsSize;
+	for (uint64_t s = 0; s < header.numSymbols; s++) {
+		
+		if (!readString(cur, last, symbol)) {
+			return false;
+		}
+		
+		loaded.addSymbol(symbol);
+	}
+	
+	// Duplicate symbols would shift IDs against matrix columns.
+	if (loaded.getNumSymbols() != header.numSymbols) {
+		return false;
+	}
+	
+	panel = move(loaded);
+	cacheSize = header.fileSize;
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method writes the cache file of a panel parsed from input file. Data is
+ * written into a temporary file of this process first, which then replaces the
+ * cache file, so other runs never map a partly written cache, and runs saving the
+ * same cache at once don't write into each other's file.
+ *
+ * @param panel: the panel parsed from input file.
+ *
+ * return true if the cache file was written.
+ *
+ */
+bool PanelCache::save(const PanelData& panel) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	if (!sourceFound) {
+		return false;
+	}
+	
+	PanelCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	
+	header.sourceSize = sourceSize;
+	header.sourceSeconds = sourceSeconds;
+	header.sourceNanoseconds = sourceNanoseconds;
+	if (!hashSource(header.sourceHash)) {
+		return false;
+	}
+	
+	header.numMonths = panel.getNumMonths();
+	header.numSymbols = panel.getNumSymbols();
+	
+	string dates = packDates(panel.getCalendar()), symbols;
+	for (unsigned long s = 0; s < panel.getNumSymbols(); s++) {
+		symbols += panel.getSymbols().getSymbol(s);
+		symbols += '\0';
+	}
+	
+	uint64_t matrixSize = header.numMonths * header.numSymbols * sizeof(double);
+	uint64_t maskSize = header.numMonths * panel.getMaskWords() * sizeof(uint64_t);
+	
+	header.datesOffset = sizeof(header);
+	header.datesSize = dates.size();
+	header.symbolsOffset = header.datesOffset + header.datesSize;
+	header.symbolsSize = symbols.size();
+	header.matrixOffset = (header.symbolsOffset + header.symbolsSize + matrixAlignment - 1) / matrixAlignment * matrixAlignment;
+	header.maskOffset = header.matrixOffset + matrixSize;
+	header.fileSize = header.maskOffset + maskSize;
+	
+	string tempName = cacheName + ".tmp." + to_string(getpid());
+	ofstream output(tempName, ios::binary | ios::trunc);
+	
+	if (!output.is_open()) {
+		return false;
+	}
+	
+	string padding(header.matrixOffset - header.symbolsOffset - header.symbolsSize, '\0');
+	
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(dates.data(), dates.size());
+	output.write(symbols.data(), symbols.size());
+	output.write(padding.data(), padding.size());
+	
+	// Month columns and masks are each contiguous over all months.
+	if (header.numMonths > 0) {
+		output.write(reinterpret_cast<const char*>(panel.getMonthColumn(0)), matrixSize);
+		output.write(reinterpret_cast<const char*>(panel.getValidMask(0)), maskSize);
+	}
+	
+	output.close();
+	
+	if (!output || rename(tempName.c_str(), cacheName.c_str()) != 0) {
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This helper finds the end of the line starting at cur.
+ *
+ * @param cur: start of the line.
+ * @param end: end of the file.
+ * @param last: output parameter receiving end of the line, excluding line break.
+ *
+ * return start of next line.
+ *
+ */
+static const char* nextLine(const char* cur, const char* end, const char*& last) {
+	
+	const void* found = memchr(cur, '\n', end - cur);
+	const char* lineEnd = found == nullptr ? end : static_cast<const char*>(found);
+	
+	// Handle different new line character in Windows and Linux/Unix.
+	last = lineEnd;
+	if (last > cur && last[-1] == '\r') {
+		--last;
+	}
+	
+	return lineEnd < end ? lineEnd + 1 : end;
+
+}
+
+/**
+ *
+ * This helper writes a whole buffer at an offset of a file.
+ *
+ * return false if the buffer can't be written.
+ *
+ */
+static bool writeAt(int fd, const void* data, uint64_t size, uint64_t offset) {
+	
+	const char* cur = static_cast<const char*>(data);
+	while (size > 0) {
+		
+		ssize_t written = pwrite(fd, cur, size, offset);
+		if (written <= 0) {
+			return false;
+		}
+		
+		cur += written;
+		size -= written;
+		offset += written;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method converts input file into its cache file without building the panel
+ * in memory, for panels larger than memory. The first pass reads dates and symbols,
+ * which fix the layout of the file. The second pass parses a batch of rows at a time
+ * into month columns that fit in the memory budget, and writes each column slice
+ * at its place in the matrix. Rows are parsed the same as CsvReader, so the cache
+ * is the same as saved after parsing, except that a symbol listed twice is an error
+ * instead of overwriting its earlier row. Data is written into a temporary file
+ * of this process first, which then replaces the cache file.
+ *
+ * @param memoryBudget: number of bytes the batch of rows may take.
+ *
+ * return true if the cache file was written. It throws runtime_error on malformed input.
+ *
+ */
+bool PanelCache::convert(unsigned long memoryBudget) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	if (!sourceFound) {
+		return false;
+	}
+	
+	MappedFile source(sourceName);
+	if (!source.isOpen()) {
+		return false;
+	}
+	
+	const char* begin = source.getData();
+	const char* end = begin + source.getSize();
+	
+	PanelCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	
+	header.sourceSize = sourceSize;
+	header.sourceSeconds = sourceSeconds;
+	header.sourceNanoseconds = sourceNanoseconds;
+	header.sourceHash = hashBytes(begin, source.getSize());
+	
+	// First pass: months of header line, and symbols of all rows.
+	PanelData dates;
+	SymbolTable symbolTable;
+	string symbols;
+	
+	const char* cur = begin;
+	const char* last;
+	unsigned long lineNumber = 0;
+	
+	while (cur < end) {
+		
+		const char* next = nextLine(cur, end, last);
+		++lineNumber;
+		
+		if (lineNumber == 1) {
+			
+			CsvReader::parseHeader(cur, last, dates);
+		
+		} else if (last > cur && *cur != ',') {
+			
+			const void* comma = memchr(cur, ',', last - cur);
+			string_view symbol(cur, (comma == nullptr ? last : static_cast<const char*>(comma)) - cur);
+			
+			unsigned long numSymbols = symbolTable.size();
+			if (symbolTable.intern(symbol) != numSymbols) {
+				throw runtime_error("line " + to_string(lineNumber) + ": symbol \"" + string(symbol) + "\" is listed twice");
+			}
+			
+			symbols += symbol;
+			symbols += '\0';
+		
+		}
+		
+		cur = next;
+	}
+	
+	unsigned long numMonths = dates.getNumMonths();
+	unsigned long numSymbols = symbolTable.size();
+	unsigned long maskWords = (numSymbols + 63) / 64;
+	
+	string datesSection = packDates(dates.getCalendar());
+	
+	header.numMonths = numMonths;
+	header.numSymbols = numSymbols;
+	header.datesOffset = sizeof(header);
+	header.datesSize = datesSection.size();
+	header.symbolsOffset = header.datesOffset + header.datesSize;
+	header.symbolsSize = symbols.size();
+	header.matrixOffset = (header.symbolsOffset + header.symbolsSize + matrixAlignment - 1) / matrixAlignment * matrixAlignment;
+	header.maskOffset = header.matrixOffset + numMonths * numSymbols * sizeof(double);
+	header.fileSize = header.maskOffset + numMonths * maskWords * sizeof(uint64_t);
+	
+	string tempName = cacheName + ".tmp." + to_string(getpid());
+	int fd = open(tempName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	
+	// Unwritten cells of the matrix read as zero, the same as missing ones.
+	bool written = writeAt(fd, &header, sizeof(header), 0) && writeAt(fd, datesSection.data(), datesSection.size(), header.datesOffset) &&
+		writeAt(fd, symbols.data(), symbols.size(), header.symbolsOffset) && ftruncate(fd, header.fileSize) == 0;
+	
+	// Rows of a batch are a multiple of 64, so every batch starts at a mask word.
+	unsigned long rowBytes = max(1UL, numMonths) * (sizeof(double) + 1);
+	unsigned long batchRows = min(memoryBudget / rowBytes, numSymbols + 63) / 64 * 64;
+	batchRows = max(64UL, batchRows);
+	unsigned long batchWords = batchRows / 64;
+	
+	vector<double> batch(numMonths * batchRows, 0);
+	vector<uint64_t> batchMasks(numMonths * batchWords, 0);
+	
+	// Second pass: rows of each batch are written once it is full, or at the end.
+	cur = begin;
+	lineNumber = 0;
+	unsigned long row = 0, batchStart = 0;
+	
+	// A malformed row leaves no partial cache behind.
+	try {
+		
+		while (written && cur <= end) {
+			
+			bool atEnd = (cur == end);
+			
+			if (!atEnd) {
+				
+				const char* next = nextLine(cur, end, last);
+				++lineNumber;
+				
+				if (lineNumber > 1 && last > cur && *cur != ',') {
+					
+					// First cell is the stock symbol, and remaining cells are return rates
+					// starting from latest month.
+					unsigned long r = row - batchStart;
+					const void* comma = memchr(cur, ',', last - cur);
+					const char* cell = comma == nullptr ? last : static_cast<const char*>(comma);
+					
+					unsigned long column = 0;
+					while (cell < last && column < numMonths) {
+						
+						++cell;
+						const void* found = memchr(cell, ',', last - cell);
+						const char* cellEnd = found == nullptr ? last : static_cast<const char*>(found);
+						
+						unsigned long m = numMonths - 1 - column;
+						if (CsvReader::parseReturn(cell, cellEnd, lineNumber, batch[m * batchRows + r])) {
+							batchMasks[m * batchWords + r / 64] |= 1ULL << (r % 64);
+						}
+						++column;
+						
+						cell = cellEnd;
+					}
+					
+					++row;
+				
+				}
+				
+				cur = next;
+			
+			}
+			
+			unsigned long batchSize = row - batchStart;
+			if (batchSize == batchRows || (atEnd && batchSize > 0)) {
+				
+				for (unsigned long m = 0; m < numMonths && written; m++) {
+					written = writeAt(fd, &batch[m * batchRows], batchSize * sizeof(double), header.matrixOffset + (m * numSymbols + batchStart) * sizeof(double)) &&
+						writeAt(fd, &batchMasks[m * batchWords], (batchSize + 63) / 64 * sizeof(uint64_t), header.maskOffset + (m * maskWords + batchStart / 64) * sizeof(uint64_t));
+				}
+				
+				fill(batch.begin(), batch.end(), 0);
+				fill(batchMasks.begin(), batchMasks.end(), 0);
+				batchStart = row;
+			
+			}
+			
+			if (atEnd) {
+				break;
+			}
+		}
+	
+	
+	} catch (...) {
+		
+		close(fd);
+		remove(tempName.c_str());
+		throw;
+	
+	}
+	
+	written = (close(fd) == 0) && written;
+	
+	if (!written || rename(tempName.c_str(), cacheName.c_str()) != 0) {
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	return true;
+
+}
@@ -0,0 +1,128 @@
+//
+//  PanelCache.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef PanelCache_h
+#define PanelCache_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "PanelData.h"
+
+using namespace std;
+
+/**
+ *
+ * Panel cache class header code:
+ *
+ * This header file defines a binary copy of a parsed panel, which is saved next
+ * to input csv file and mapped by later runs instead of parsing the csv again.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This struct is the fixed header at the start of a cache file. Offsets are
+ * counted in bytes from the start of the file.
+ *
+ */
+struct PanelCacheHeader {
+	
+	char magic[8];
+	uint64_t version;
+	
+	// Input file the cache was built from.
+	uint64_t sourceSize;
+	uint64_t sourceSeconds;
+	uint64_t sourceNanoseconds;
+	uint64_t sourceHash;
+	
+	// Panel dimensions.
+	uint64_t numMonths;
+	uint64_t numSymbols;
+	
+	// Sections of the file.
+	uint64_t datesOffset;
+	uint64_t datesSize;
+	uint64_t symbolsOffset;
+	uint64_t symbolsSize;
+	uint64_t matrixOffset;
+	uint64_t maskOffset;
+	uint64_t fileSize;
+
+};
+
+
+/**
+ *
+ * This class saves and loads the binary cache "<input file>.panel" of a panel.
+ *
+ * The cache file starts with a fixed header, followed by dates (one uint32 date
+ *	per month, earliest first), symbols ("symbol\0" per ID), the column-major
+ *	matrix of float64 return rates aligned to 64 bytes, and validity masks of
+ *	all months. Numbers are stored in byte order of the machine.
+ * The header records size, modification time and hash of input file. A cache is
+ *	used if input size is unchanged and either modification time or content hash
+ *	is unchanged, so touching input file costs one hash, not a parse.
+ * A loaded panel is attached to the mapped cache, so the matrix is not copied.
+ * A cache can also be converted straight from input file in batches of rows,
+ *	without holding the panel in memory, and then read back a few months at a
+ *	time, see TiledPanel.
+ *
+ */
+class PanelCache {
+
+private:
+	
+	// Names of input csv file and its cache file.
+	string sourceName;
+	string cacheName;
+	
+	// Size and modification time of input file when the cache object is created.
+	uint64_t sourceSize;
+	uint64_t sourceSeconds;
+	uint64_t sourceNanoseconds;
+	bool sourceFound;
+	
+	// Size of the loaded cache file, for throughput report.
+	unsigned long cacheSize;
+	
+	// The method computes content hash of input file.
+	bool hashSource(uint64_t& hash) const;
+
+public:
+	
+	// A default constructor for the cache of an input file.
+	PanelCache(const string& inputFileName);
+	
+	// Inspectors for cache file name and size of the loaded cache.
+	const string& getCacheName() const;
+	unsigned long getSize() const;
+	
+	// The method reads and checks the header of the cache, returns false if there is no valid cache.
+	bool check(PanelCacheHeader& header);
+	
+	// The method reads dates and symbols of a valid cache, returns false if they are malformed.
+	bool loadNames(const PanelCacheHeader& header, Calendar& calendar, SymbolTable& symbols) const;
+	
+	// The method loads a valid cache into an empty panel, returns false if there is none.
+	bool load(PanelData& panel);
+	
+	// The method saves a panel parsed from input file, returns false on failure.
+	bool save(const PanelData& panel) const;
+	
+	// The method converts input file into the cache within a memory budget in bytes, returns false on failure.
+	bool convert(unsigned long memoryBudget) const;
+
+};
+
+
+#endif /* PanelCache_h */
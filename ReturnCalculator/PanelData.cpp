@@ -0,0 +1,681 @@
+//
+//  PanelData.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "PanelData.h"
+#include "Profiler.h"
+#include "Hashing.h"
+
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of SymbolTable and PanelData classes.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Size of a block of the symbol arena, and number of slots of an empty hash table.
+static const unsigned long arenaBlockSize = 64 * 1024;
+static const unsigned long initialSlots = 64;
+
+
+/**
+ *
+ * This is default constructor of a table without any symbol.
+ *
+ */
+SymbolTable::SymbolTable() {
+	
+	blockNext = nullptr;
+	blockFree = 0;
+	slots.assign(initialSlots, 0);
+
+}
+
+/**
+ *
+ * This is copy constructor. The copy owns an arena of its own, so symbols are
+ * interned into it again, keeping their IDs.
+ *
+ * @param other: the table to copy.
+ *
+ */
+SymbolTable::SymbolTable(const SymbolTable& other) : SymbolTable() {
+	
+	for (const string_view& symbol : other.symbolNames) {
+		intern(symbol);
+	}
+
+}
+
+/**
+ *
+ * This is copy assignment, which replaces symbols of this table by those of another.
+ *
+ * @param other: the table to copy.
+ *
+ * return this table.
+ *
+ */
+SymbolTable& SymbolTable::operator = (const SymbolTable& other) {
+	
+	if (this != &other) {
+		*this = SymbolTable(other);
+	}
+	
+	return *this;
+
+}
+
+/**
+ *
+ * This method is private. It probes the hash table from the slot given by hash of
+ * a symbol, until it finds the symbol or an empty slot. The table is never full,
+ * so probing always ends.
+ *
+ * @param symbol: a string of company stock symbol.
+ *
+ * return index of the slot.
+ *
+ */
+unsigned long SymbolTable::findSlot(string_view symbol) const {
+	
+	unsigned long mask = slots.size() - 1;
+	unsigned long slot = hashBytes(symbol.data(), symbol.size()) & mask;
+	
+	while (slots[slot] != 0 && symbolNames[slots[slot] - 1] != symbol) {
+		slot = (slot + 1) & mask;
+	}
+	
+	return slot;
+
+}
+
+/**
+ *
+ * This method is private. It copies a symbol into the last block of the arena,
+ * starting a new block if the symbol does not fit. A symbol longer than a block
+ * gets a block of its own.
+ *
+ * @param symbol: a string of company stock symbol.
+ *
+ * return view of the copy, valid as long as the table.
+ *
+ */
+string_view SymbolTable::store(string_view symbol) {
+	
+	if (symbol.size() > blockFree) {
+		unsigned long size = max(arenaBlockSize, static_cast<unsigned long>(symbol.size()));
+		blocks.emplace_back(new char[size]);
+		blockNext = blocks.back().get();
+		blockFree = size;
+	}
+	
+	char* copy = blockNext;
+	symbol.copy(copy, symbol.size());
+	blockNext += symbol.size();
+	blockFree -= symbol.size();
+	
+	return string_view(copy, symbol.size());
+
+}
+
+/**
+ *
+ * This method is private. It doubles the hash table, and puts the ID of every
+ * symbol into the slot its hash leads to in the larger table.
+ *
+ */
+void SymbolTable::grow() {
+	
+	slots.assign(slots.size() * 2, 0);
+	
+	for (unsigned long id = 0; id < symbolNames.size(); id++) {
+		slots[findSlot(symbolNames[id])] = id + 1;
+	}
+
+}
+
+/**
+ *
+ * This method interns a company symbol. A new symbol gets next unused ID,
+ * while a known symbol keeps its ID.
+ *
+ * @param symbol: a string of company stock symbol.
+ *
+ * return the dense integer ID of the symbol.
+ *
+ */
+unsigned long SymbolTable::intern(string_view symbol) {
+	
+	PROFILE_COUNT(SYMBOL_LOOKUPS, 1);
+	
+	unsigned long slot = findSlot(symbol);
+	if (slots[slot] != 0) {
+		return slots[slot] - 1;
+	}
+	
+	unsigned long id = symbolNames.size();
+	symbolNames.push_back(store(symbol));
+	slots[slot] = id + 1;
+	
+	// Keep the table at most half full, so probe sequences stay short.
+	if (2 * symbolNames.size() > slots.size()) {
+		grow();
+	}
+	
+	return id;
+
+}
+
+/**
+ *
+ * This method looks up ID of a company symbol without modifying the table.
+ *
+ * @param symbol: a string of company stock symbol.
+ * @param id: output parameter receiving the ID if symbol is known.
+ *
+ * return true if symbol is known, otherwise false.
+ *
+ */
+bool SymbolTable::find(string_view symbol, unsigned long& id) const {
+	
+	PROFILE_COUNT(SYMBOL_LOOKUPS, 1);
+	
+	unsigned long slot = findSlot(symbol);
+	if (slots[slot] == 0) {
+		PROFILE_COUNT(LOOKUP_MISSES, 1);
+		return false;
+	}
+	
+	id = slots[slot] - 1;
+	return true;
+
+}
+
+/**
+ *
+ * This method is inspector to get symbol string of an ID.
+ *
+ * return view of the company stock symbol, valid as long as the table.
+ *
+ */
+string_view SymbolTable::getSymbol(unsigned long id) const {
+	
+	return symbolNames[id];
+
+}
+
+/**
+ *
+ * This method is inspector to get number of interned symbols.
+ *
+ * return number of symbols.
+ *
+ */
+unsigned long SymbolTable::size() const {
+	
+	return symbolNames.size();
+
+}
+
+
+/**
+ *
+ * This is default constructor of an empty panel owning its storage.
+ *
+ */
+PanelData::PanelData() {
+	
+	mappedColumns = nullptr;
+	mappedMasks = nullptr;
+
+}
+
+/**
+ *
+ * This method appends a month after all existing months. It is supposed to be
+ * called before any symbol is added, since row width is fixed by then.
+ *
+ * @param date: date of the month.
+ *
+ * return index of the new month.
+ *
+ */
+unsigned long PanelData::addMonth(CalendarDate date) {
+	
+	return calendar.add(date);
+
+}
+
+/**
+ *
+ * This method interns a company symbol, and appends a row of zero return rates
+ * for it if the symbol is new. Cells of a new row are missing until set.
+ * An attached panel only interns the symbol, as its rates are already stored.
+ *
+ * @param symbol: a string of company stock symbol.
+ *
+ * return ID of the symbol, which is also its row index.
+ *
+ */
+unsigned long PanelData::addSymbol(string_view symbol) {
+	
+	unsigned long id = symbols.intern(symbol);
+	
+	// Grow row-major matrix by one row when symbol is seen for the first time.
+	if (!mappedStorage && (id + 1) * calendar.size() > symbolRows.size()) {
+		symbolRows.resize((id + 1) * calendar.size(), 0);
+		symbolValid.resize((id + 1) * calendar.size(), 0);
+	}
+	
+	return id;
+
+}
+
+/**
+ *
+ * This method is a mutator to set return rate of a symbol in a month. Only the
+ * row-major matrix is modified, please call transpose() after all rates are set.
+ *
+ * @param symbolId: ID returned by addSymbol().
+ * @param monthIndex: index returned by addMonth().
+ * @param rate: a double number contains value of return rate.
+ *
+ */
+void PanelData::setReturn(unsigned long symbolId, unsigned long monthIndex, double rate) {
+	
+	symbolRows[symbolId * calendar.size() + monthIndex] = rate;
+	symbolValid[symbolId * calendar.size() + monthIndex] = 1;
+
+}
+
+/**
+ *
+ * This method is a mutator to mark return rate of a symbol in a month as missing,
+ * e.g. "#N/A" in input file. The rate is kept as 0.
+ *
+ * @param symbolId: ID returned by addSymbol().
+ * @param monthIndex: index returned by addMonth().
+ *
+ */
+void PanelData::setMissing(unsigned long symbolId, unsigned long monthIndex) {
+	
+	symbolRows[symbolId * calendar.size() + monthIndex] = 0;
+	symbolValid[symbolId * calendar.size() + monthIndex] = 0;
+
+}
+
+/**
+ *
+ * This method builds the column-major matrix from the row-major staging matrix,
+ * so that return rates of all symbols in the same month are adjacent in memory,
+ * and packs validity of each month into bit masks. Staging memory is released.
+ * This method is supposed to be called once after input parsing is finished.
+ *
+ */
+void PanelData::transpose() {
+	
+	unsigned long numMonths = getNumMonths();
+	unsigned long numSymbols = getNumSymbols();
+	
+	unsigned long maskWords = getMaskWords();
+	
+	monthColumns.assign(numMonths * numSymbols, 0);
+	validMasks.assign(numMonths * maskWords, 0);
+	
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		
+		const double* row = &symbolRows[s * numMonths];
+		const unsigned char* valid = &symbolValid[s * numMonths];
+		uint64_t bit = uint64_t(1) << (s % 64);
+		
+		for (unsigned long m = 0; m < numMonths; m++) {
+			monthColumns[m * numSymbols + s] = row[m];
+			if (valid[m]) {
+				validMasks[m * maskWords + s / 64] |= bit;
+			}
+		}
+	
+	}
+	
+	vector<double>().swap(symbolRows);
+	vector<unsigned char>().swap(symbolValid);
+
+}
+
+/**
+ *
+ * This method attaches the panel to matrix and masks stored elsewhere, laid out
+ * the same as built by transpose(). The panel keeps a reference to the storage.
+ * This method is supposed to be called after all months are added, and symbols
+ * added afterwards are only interned.
+ *
+ * @param storage: the owner of matrix and masks, e.g. a mapped file.
+ * @param columns: address of column-major matrix inside the storage.
+ * @param masks: address of validity masks inside the storage.
+ *
+ */
+void PanelData::attach(const shared_ptr<const void>& storage, const double* columns, const uint64_t* masks) {
+	
+	mappedStorage = storage;
+	mappedColumns = columns;
+	mappedMasks = masks;
+	
+	vector<double>().swap(symbolRows);
+	vector<unsigned char>().swap(symbolValid);
+	vector<double>().swap(monthColumns);
+	vector<uint64_t>().swap(validMasks);
+
+}
+
+/**
+ *
+ * This method is inspector to get number of months.
+ *
+ * return number of months.
+ *
+ */
+unsigned long PanelData::getNumMonths() const {
+	
+	return calendar.size();
+
+}
+
+/**
+ *
+ * This method is inspector to get number of symbols.
+ *
+ * return number of symbols.
+ *
+ */
+unsigned long PanelData::getNumSymbols() const {
+	
+	return symbols.size();
+
+}
+
+/**
+ *
+ * This method is inspector to get the symbol table.
+ *
+ * return a constant reference of symbol table.
+ *
+ */
+const SymbolTable& PanelData::getSymbols() const {
+	
+	return symbols;
+
+}
+
+/**
+ *
+ * This method is inspector to get dates of all months.
+ *
+ * return the calendar of the panel.
+ *
+ */
+const Calendar& PanelData::getCalendar() const {
+	
+	return calendar;
+
+}
+
+/**
+ *
+ * These methods are inspectors to get date of a month, as an integer and as
+ * label for output files.
+ *
+ */
+CalendarDate PanelData::getDate(unsigned long monthIndex) const {
+	
+	return calendar.getDate(monthIndex);
+
+}
+
+string PanelData::getDateLabel(unsigned long monthIndex) const {
+	
+	return calendar.getLabel(monthIndex);
+
+}
+
+/**
+ *
+ * This method is inspector to get return rates of all symbols in a month.
+ * This method is supposed to be called after transpose().
+ *
+ * @param monthIndex: index of the month.
+ *
+ * return pointer to getNumSymbols() return rates, indexed by symbol ID.
+ *
+ */
+const double* PanelData::getMonthColumn(unsigned long monthIndex) const {
+	
+	const double* columns = mappedStorage ? mappedColumns : monthColumns.data();
+	return columns + monthIndex * getNumSymbols();
+
+}
+
+/**
+ *
+ * This method is inspector to get return rates of a symbol in all months.
+ * This method is supposed to be called after transpose().
+ *
+ * @param symbolId: ID of the symbol.
+ *
+ * return a strided view of getNumMonths() return rates, indexed by month.
+ *
+ */
+SymbolRow PanelData::getSymbolRow(unsigned long symbolId) const {
+	
+	return SymbolRow(getMonthColumn(0) + symbolId, getNumSymbols());
+
+}
+
+/**
+ *
+ * This method is inspector to get number of 64 bit words in validity mask of a month.
+ *
+ * return number of words.
+ *
+ */
+unsigned long PanelData::getMaskWords() const {
+	
+	return (getNumSymbols() + 63) / 64;
+
+}
+
+/**
+ *
+ * This method is inspector to get validity mask of a month. Bit s % 64 of word
+ * s / 64 is set if return rate of symbol s is valid.
+ * This method is supposed to be called after transpose().
+ *
+ * @param monthIndex: index of the month.
+ *
+ * return pointer to getMaskWords() words.
+ *
+ */
+const uint64_t* PanelData::getValidMask(unsigned long monthIndex) const {
+	
+	const uint64_t* masks = mappedStorage ? mappedMasks : validMasks.data();
+	return masks + monthIndex * getMaskWords();
+
+}
+
+/**
+ *
+ * This method is inspector to check whether return rate of a symbol in a month is valid.
+ *
+ * @param symbolId: ID of the symbol.
+ * @param monthIndex: index of the month.
+ *
+ * return false if the rate is missing from input file.
+ *
+ */
+bool PanelData::isValid(unsigned long symbolId, unsigned long monthIndex) const {
+	
+	return (getValidMask(monthIndex)[symbolId / 64] >> (symbolId % 64)) & 1;
+
+}
+
+/**
+ *
+ * This method is inspector to count valid return rates of a month, one mask word
+ * at a time. Bits beyond the last symbol are never set.
+ *
+ * @param monthIndex: index of the month.
+ *
+ * return number of symbols with a valid return rate.
+ *
+ */
+unsigned long PanelData::countValid(unsigned long monthIndex) const {
+	
+	const uint64_t* mask = getValidMask(monthIndex);
+	unsigned long count = 0;
+	
+	for (unsigned long w = 0; w < getMaskWords(); w++) {
+		count += __builtin_popcountll(mask[w]);
+	}
+	
+	return count;
+
+}
+
+/**
+ *
+ * This method lays out values of this panel, e.g. market caps, the same way as
+ * another panel, e.g. return rates, so both are indexed by the same symbol IDs
+ * and month indexes. Symbols are matched by name and months by date. Cells of
+ * the reference panel without a valid value in this panel are missing.
+ *
+ * @param reference: the panel whose symbols and months are copied.
+ *
+ * return the aligned panel, already transposed.
+ *
+ */
+PanelData PanelData::alignTo(const PanelData& reference) const {
+	
+	PanelData aligned;
+	
+	// Month of this panel matching each month of reference panel, if any.
+	vector<long> sourceMonths(reference.getNumMonths(), -1);
+	for (unsigned long m = 0; m < reference.getNumMonths(); m++) {
+		
+		aligned.addMonth(reference.getDate(m));
+		
+		unsigned long found;
+		if (calendar.find(reference.getDate(m), found)) {
+			sourceMonths[m] = static_cast<long>(found);
+		}
+	
+	}
+	
+	// Symbol of this panel matching each symbol of reference panel, if any.
+	vector<long> sourceIds(reference.getNumSymbols(), -1);
+	for (unsigned long s = 0; s < reference.getNumSymbols(); s++) {
+		
+		aligned.addSymbol(reference.getSymbols().getSymbol(s));
+		
+		unsigned long sourceId;
+		if (symbols.find(reference.getSymbols().getSymbol(s), sourceId)) {
+			sourceIds[s] = static_cast<long>(sourceId);
+		}
+	
+	}
+	
+	// Columns of this panel are read in order, one month at a time.
+	for (unsigned long m = 0; m < reference.getNumMonths(); m++) {
+		
+		if (sourceMonths[m] < 0) {
+			continue;
+		}
+		
+		const double* column = getMonthColumn(sourceMonths[m]);
+		for (unsigned long s = 0; s < reference.getNumSymbols(); s++) {
+			if (sourceIds[s] >= 0 && isValid(sourceIds[s], sourceMonths[m])) {
+				aligned.setReturn(s, m, column[sourceIds[s]]);
+			}
+		}
+	
+	}
+	
+	aligned.transpose();
+	return aligned;
+
+}
+
+/**
+ *
+ * This method builds a panel of lower frequency, e.g. monthly from daily data, so
+ * stocks are ranked and held over rebalancing periods rather than input periods.
+ * Month k of the new panel has the date of month ends[k] of this panel, and the
+ * compound return of months after ends[k - 1] up to ends[k], or from the earliest
+ * month for k = 0. A stock missing any of those months is missing, the same as
+ * compound windows of a parameter sweep. A single month is copied as it is.
+ *
+ * @param ends: increasing indexes of the last month of every new month.
+ *
+ * return the new panel with the same symbols, already transposed.
+ *
+ */
+PanelData PanelData::resample(const vector<unsigned long>& ends) const {
+	
+	PanelData resampled;
+	
+	for (const unsigned long& end : ends) {
+		resampled.addMonth(getDate(end));
+	}
+	
+	for (unsigned long s = 0; s < getNumSymbols(); s++) {
+		resampled.addSymbol(symbols.getSymbol(s));
+	}
+	
+	unsigned long numSymbols = getNumSymbols();
+	unsigned long numWords = getMaskWords();
+	vector<double> growth(numSymbols);
+	vector<uint64_t> valid(numWords);
+	
+	unsigned long first = 0;
+	for (unsigned long k = 0; k < ends.size(); k++) {
+		
+		// Growth of every stock and validity are accumulated a month at a time.
+		growth.assign(numSymbols, 1);
+		valid.assign(numWords, ~0ULL);
+		
+		for (unsigned long m = first; m <= ends[k]; m++) {
+			
+			const double* column = getMonthColumn(m);
+			const uint64_t* mask = getValidMask(m);
+			
+			for (unsigned long s = 0; s < numSymbols; s++) {
+				growth[s] *= 1 + column[s];
+			}
+			for (unsigned long w = 0; w < numWords; w++) {
+				valid[w] &= mask[w];
+			}
+		
+		}
+		
+		const double* column = getMonthColumn(ends[k]);
+		for (unsigned long s = 0; s < numSymbols; s++) {
+			if ((valid[s / 64] >> (s % 64)) & 1) {
+				resampled.setReturn(s, k, first == ends[k] ? column[s] : growth[s] - 1);
+			}
+		}
+		
+		first = ends[k] + 1;
+	}
+	
+	resampled.transpose();
+	return resampled;
+
+}
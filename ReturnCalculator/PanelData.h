@@ -0,0 +1,218 @@
+//
+//  PanelData.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef PanelData_h
+#define PanelData_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "MappedFile.h"
+#include "Calendar.h"
+
+using namespace std;
+
+/**
+ *
+ * Panel data class header code:
+ *
+ * This header file defines the storage shared by all months of an input file.
+ * Company symbols are interned once into dense integer IDs, and return rates
+ * of all months are kept in one contiguous matrix indexed by those IDs.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class maps company symbols to dense integer IDs, which start from 0
+ * and follow the order of first appearance in the input file.
+ *
+ * Every symbol is stored once, in an arena of large character blocks which never
+ *	move, and is handed out as a string_view which stays valid as long as the table.
+ * IDs are found through an open addressing hash table of IDs, which probes slots
+ *	linearly and is kept at most half full. So interning a symbol allocates nothing
+ *	but an occasional new block or a larger table, and looking one up never
+ *	builds a string.
+ * Moving a table keeps its blocks, copying one interns every symbol again.
+ *
+ */
+class SymbolTable {
+
+private:
+	
+	// Blocks of the arena, and next free byte and number of free bytes of the last one.
+	vector<unique_ptr<char[]>> blocks;
+	char* blockNext;
+	unsigned long blockFree;
+	
+	// Symbols in the arena, indexed by ID.
+	vector<string_view> symbolNames;
+	
+	// Hash table of ID + 1 of the symbol in each slot, 0 for an empty slot. Number
+	// of slots is a power of 2.
+	vector<unsigned long> slots;
+	
+	// The method gets the slot of a symbol, or the empty slot it would be put in.
+	unsigned long findSlot(string_view symbol) const;
+	
+	// The method copies a symbol into the arena.
+	string_view store(string_view symbol);
+	
+	// The method doubles number of slots, and puts every ID into its new slot.
+	void grow();
+
+public:
+	
+	// Constructors of an empty table, a copy with its own arena, or a moved table.
+	SymbolTable();
+	SymbolTable(const SymbolTable& other);
+	SymbolTable(SymbolTable&& other) = default;
+	
+	SymbolTable& operator = (const SymbolTable& other);
+	SymbolTable& operator = (SymbolTable&& other) = default;
+	
+	// The mutator to intern a symbol, returns the existing ID if already known.
+	unsigned long intern(string_view symbol);
+	
+	// Inspector to look up ID of a symbol, returns false if symbol is unknown.
+	bool find(string_view symbol, unsigned long& id) const;
+	
+	// Inspectors for symbol name of an ID and total number of symbols.
+	string_view getSymbol(unsigned long id) const;
+	unsigned long size() const;
+
+};
+
+
+/**
+ *
+ * This struct is a read-only view of return rates of one symbol in all months,
+ * which are spread over month columns of a panel at a fixed stride.
+ *
+ */
+struct SymbolRow {
+	
+	// Return rate of the symbol in the first month, and distance between months.
+	const double* first;
+	unsigned long stride;
+	
+	// Constructor with start address and stride.
+	SymbolRow(const double* f, unsigned long s) :
+	first(f), stride(s) {}
+	
+	// Return rate of the symbol in a month.
+	double operator [] (unsigned long monthIndex) const {
+		return first[monthIndex * stride];
+	}
+
+};
+
+
+/**
+ *
+ * This class stores return rates of all companies in all months.
+ *
+ * Months are kept in chronological order, so index 0 is the earliest month and
+ *	the month following index m is index m + 1. A "month" is a period of input
+ *	data, which may as well be a day or a week, and its date is kept by a calendar.
+ * Return rates are kept in one contiguous column-major matrix with one column per
+ *	month, which is what ranking and next month lookups walk through. Rows of
+ *	symbols are viewed through the same matrix at a stride.
+ * Each month column has a validity bit mask, one bit per symbol, which is cleared
+ *	for cells marked as "#N/A", empty cells and cells missing from input file.
+ * While parsing, rates are staged in a row-major matrix with one row per symbol,
+ *	the layout of input file. All months have to be added before the first symbol,
+ *	and transpose() has to be called after all return rates are set and before
+ *	month columns are read.
+ * Instead of owning the matrix, a panel can be attached to a mapped cache file,
+ *	or to buffers of months read from one, which are kept alive as long as any
+ *	copy of the panel.
+ *
+ */
+class PanelData {
+
+private:
+	
+	// Company symbols interned into dense IDs.
+	SymbolTable symbols;
+	
+	// Date of each month.
+	Calendar calendar;
+	
+	// Return rates and validity staged as numSymbols x numMonths while parsing,
+	// i.e. one row per symbol. Released by transpose().
+	vector<double> symbolRows;
+	vector<unsigned char> symbolValid;
+	
+	// Return rates stored as numMonths x numSymbols, i.e. one column per month,
+	// and validity bit masks of numMonths x getMaskWords() words.
+	vector<double> monthColumns;
+	vector<uint64_t> validMasks;
+	
+	// The storage holding matrix and masks when attached, e.g. a mapped file or
+	// a tile read from one, otherwise null.
+	shared_ptr<const void> mappedStorage;
+	const double* mappedColumns;
+	const uint64_t* mappedMasks;
+
+public:
+	
+	// A default constructor of an empty panel.
+	PanelData();
+	
+	// Mutators to append a month or a symbol, both return index of the new entry.
+	unsigned long addMonth(CalendarDate date);
+	unsigned long addSymbol(string_view symbol);
+	
+	// The mutators to set return rate of a symbol in a month, or mark it missing.
+	void setReturn(unsigned long symbolId, unsigned long monthIndex, double rate);
+	void setMissing(unsigned long symbolId, unsigned long monthIndex);
+	
+	// The method builds column-major matrix and masks from row-major staging.
+	void transpose();
+	
+	// The mutator to use matrix and masks stored elsewhere, e.g. in a mapped file, instead of transpose().
+	void attach(const shared_ptr<const void>& storage, const double* columns, const uint64_t* masks);
+	
+	// Inspectors for panel dimensions and symbol table.
+	unsigned long getNumMonths() const;
+	unsigned long getNumSymbols() const;
+	const SymbolTable& getSymbols() const;
+	
+	// Inspectors for dates of all months, and date and label of a month.
+	const Calendar& getCalendar() const;
+	CalendarDate getDate(unsigned long monthIndex) const;
+	string getDateLabel(unsigned long monthIndex) const;
+	
+	// Views into matrix: return rates of all symbols in a month, indexed by
+	// symbol ID, and return rates of a symbol in all months, indexed by month.
+	const double* getMonthColumn(unsigned long monthIndex) const;
+	SymbolRow getSymbolRow(unsigned long symbolId) const;
+	
+	// Inspectors for validity: words per month mask, mask of a month, one cell, and
+	// number of valid cells in a month.
+	unsigned long getMaskWords() const;
+	const uint64_t* getValidMask(unsigned long monthIndex) const;
+	bool isValid(unsigned long symbolId, unsigned long monthIndex) const;
+	unsigned long countValid(unsigned long monthIndex) const;
+	
+	// The method copies values of this panel into symbols and months of another panel.
+	PanelData alignTo(const PanelData& reference) const;
+	
+	// The method compounds return rates of the months up to each end into one month.
+	PanelData resample(const vector<unsigned long>& ends) const;
+
+};
+
+
+#endif /* PanelData_h */
@@ -0,0 +1,295 @@
+//
+//  PanelGenerator.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "PanelGenerator.h"
+
+#include <cmath>
+#include <random>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of PanelGenerator class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This helper gets date of a generated month, where month 0 is January 1990.
+ *
+ */
+static CalendarDate monthDate(unsigned long month) {
+	
+	return static_cast<CalendarDate>((1990 + month / 12) * 10000 + (month % 12 + 1) * 100);
+
+}
+
+// Degrees of freedom of Student's t distribution, small enough for fat tails.
+static const double degreesOfFreedom = 4;
+
+/**
+ *
+ * This helper draws a number of zero mean and unit standard deviation.
+ *
+ */
+static double drawUnit(mt19937_64& engine, PanelGenerator::Distribution distribution) {
+	
+	switch (distribution) {
+		
+		case PanelGenerator::STUDENT_T:
+			return student_t_distribution<double>(degreesOfFreedom)(engine) / sqrt(degreesOfFreedom / (degreesOfFreedom - 2));
+		
+		case PanelGenerator::UNIFORM:
+			return uniform_real_distribution<double>(-sqrt(3.0), sqrt(3.0))(engine);
+		
+		default:
+			return normal_distribution<double>(0, 1)(engine);
+	
+	}
+
+}
+
+/**
+ *
+ * This method is private. It draws all return rates of the panel, row by row
+ * with months in chronological order. Missing cells have rate 0.
+ *
+ * @param rates: receives numSymbols x numMonths return rates.
+ * @param valid: receives 0 for missing cells and 1 for others.
+ *
+ */
+void PanelGenerator::draw(vector<double>& rates, vector<unsigned char>& valid) const {
+	
+	mt19937_64 engine(seed);
+	uniform_real_distribution<double> coin(0, 1);
+	double scale = pow(10.0, decimals);
+	
+	vector<double> market(numMonths);
+	for (double& rate : market) {
+		rate = marketVolatility * drawUnit(engine, distribution);
+	}
+	
+	rates.assign(numSymbols * numMonths, 0);
+	valid.assign(numSymbols * numMonths, 0);
+	
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		for (unsigned long m = 0; m < numMonths; m++) {
+			
+			double rate = market[m] + volatility * drawUnit(engine, distribution);
+			
+			// A return rate is never below -100%.
+			rate = max(rate, -0.99);
+			
+			if (coin(engine) >= missingRate) {
+				rates[s * numMonths + m] = round(rate * scale) / scale;
+				valid[s * numMonths + m] = 1;
+			}
+		
+		}
+	}
+
+}
+
+/**
+ *
+ * This helper makes the symbol of a row.
+ *
+ */
+static string makeSymbol(unsigned long s) {
+	
+	return "S" + to_string(s);
+
+}
+
+/**
+ *
+ * This is default constructor specifying panel size. By default, company returns
+ * are normal with 10% standard deviation, market returns have 5%, return rates
+ * have 4 decimals, and no cell is missing.
+ *
+ * @param symbols: number of companies.
+ * @param months: number of months.
+ *
+ */
+PanelGenerator::PanelGenerator(unsigned long symbols, unsigned long months) {
+	
+	numSymbols = symbols;
+	numMonths = months;
+	
+	missingRate = 0;
+	distribution = NORMAL;
+	volatility = 0.1;
+	marketVolatility = 0.05;
+	decimals = 4;
+	seed = 1;
+
+}
+
+/**
+ *
+ * This method is a mutator to set probability of a missing cell.
+ *
+ * @param rate: probability between 0 and 1.
+ *
+ */
+void PanelGenerator::setMissingRate(double rate) {
+	
+	missingRate = rate;
+
+}
+
+/**
+ *
+ * This method is a mutator to set distribution of returns.
+ *
+ * @param d: distribution of both company and market returns.
+ * @param companyVolatility: standard deviation of company returns.
+ * @param marketVol: standard deviation of market returns.
+ *
+ */
+void PanelGenerator::setDistribution(Distribution d, double companyVolatility, double marketVol) {
+	
+	distribution = d;
+	volatility = companyVolatility;
+	marketVolatility = marketVol;
+
+}
+
+/**
+ *
+ * This method is a mutator to set number of decimals of return rates.
+ *
+ * @param d: number of decimals, e.g. 2 for "0.06" like provided input file.
+ *
+ */
+void PanelGenerator::setDecimals(int d) {
+	
+	decimals = d;
+
+}
+
+/**
+ *
+ * This method is a mutator to set seed of random numbers.
+ *
+ * @param s: the seed.
+ *
+ */
+void PanelGenerator::setSeed(unsigned long s) {
+	
+	seed = s;
+
+}
+
+/**
+ *
+ * This method parses name of a distribution.
+ *
+ * @param name: "normal", "t" or "uniform".
+ * @param d: output parameter receiving the distribution.
+ *
+ * return false if the name is unknown.
+ *
+ */
+bool PanelGenerator::parseDistribution(const string& name, Distribution& d) {
+	
+	if (name == "normal") {
+		d = NORMAL;
+	} else if (name == "t") {
+		d = STUDENT_T;
+	} else if (name == "uniform") {
+		d = UNIFORM;
+	} else {
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method writes the panel in format of provided file "SP50_test.csv": a header
+ * line of dates from latest to earliest month, then one line per symbol. The
+ * earliest month is January 1990.
+ *
+ * @param output: the destination stream.
+ *
+ */
+void PanelGenerator::writeCsv(ostream& output) const {
+	
+	vector<double> rates;
+	vector<unsigned char> valid;
+	draw(rates, valid);
+	
+	for (unsigned long m = numMonths; m > 0; m--) {
+		output << "," << formatDate(monthDate(m - 1));
+	}
+	output << "\n";
+	
+	output << fixed << setprecision(decimals);
+	
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		
+		output << makeSymbol(s);
+		for (unsigned long m = numMonths; m > 0; m--) {
+			
+			output << ",";
+			if (valid[s * numMonths + m - 1]) {
+				output << rates[s * numMonths + m - 1];
+			} else {
+				output << "#N/A";
+			}
+		
+		}
+		output << "\n";
+	
+	}
+
+}
+
+/**
+ *
+ * This method fills an empty panel without going through text, with the same
+ * return rates as parsing the output of writeCsv().
+ *
+ * @param panel: an empty panel.
+ *
+ */
+void PanelGenerator::generate(PanelData& panel) const {
+	
+	vector<double> rates;
+	vector<unsigned char> valid;
+	draw(rates, valid);
+	
+	for (unsigned long m = 0; m < numMonths; m++) {
+		panel.addMonth(monthDate(m));
+	}
+	
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		
+		unsigned long id = panel.addSymbol(makeSymbol(s));
+		for (unsigned long m = 0; m < numMonths; m++) {
+			if (valid[s * numMonths + m]) {
+				panel.setReturn(id, m, rates[s * numMonths + m]);
+			} else {
+				panel.setMissing(id, m);
+			}
+		}
+	
+	}
+	
+	panel.transpose();
+
+}
@@ -0,0 +1,93 @@
+//
+//  PanelGenerator.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef PanelGenerator_h
+#define PanelGenerator_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "PanelData.h"
+
+using namespace std;
+
+/**
+ *
+ * Panel generator class header code:
+ *
+ * This header file defines a generator of synthetic return rate panels, in the
+ * same format as provided file "SP50_test.csv", for benchmarks at any size.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class generates random monthly return rates of made-up symbols.
+ *
+ * Each return rate is the return of the market in that month plus the return of
+ *	the company, both drawn from the selected distribution, and rounded to a
+ *	number of decimals like input files, so ties show up in ranking.
+ * Each cell is missing ("#N/A") with the given probability.
+ * The same seed always gives the same panel.
+ *
+ */
+class PanelGenerator {
+
+public:
+	
+	// Distributions of company returns.
+	enum Distribution {NORMAL, STUDENT_T, UNIFORM};
+
+private:
+	
+	// Panel size.
+	unsigned long numSymbols;
+	unsigned long numMonths;
+	
+	// Probability of a missing cell.
+	double missingRate;
+	
+	// Distribution and standard deviation of company and market returns.
+	Distribution distribution;
+	double volatility;
+	double marketVolatility;
+	
+	// Number of decimals of written return rates, and seed of random numbers.
+	int decimals;
+	unsigned long seed;
+	
+	// The method draws return rates and validity of all cells.
+	void draw(vector<double>& rates, vector<unsigned char>& valid) const;
+
+public:
+	
+	// A default constructor of a panel size, other settings have default values.
+	PanelGenerator(unsigned long symbols, unsigned long months);
+	
+	// Mutators of settings.
+	void setMissingRate(double rate);
+	void setDistribution(Distribution d, double companyVolatility, double marketVol);
+	void setDecimals(int d);
+	void setSeed(unsigned long s);
+	
+	// The method parses a distribution name: "normal", "t" or "uniform".
+	static bool parseDistribution(const string& name, Distribution& d);
+	
+	// The method writes the panel as a wide input csv file, latest month first.
+	void writeCsv(ostream& output) const;
+	
+	// The method fills an empty panel with the same return rates as writeCsv().
+	void generate(PanelData& panel) const;
+
+};
+
+
+#endif /* PanelGenerator_h */
@@ -0,0 +1,391 @@
+//
+//  ParameterSweep.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "ParameterSweep.h"
+#include "Ranking.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of ParameterSweep class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This is default constructor which builds prefix sums of the panel.
+ *
+ * @param p: the panel which stores return rates of all months, already transposed.
+ * @param buckets: number of buckets N, top and bottom buckets hold 1/N of stocks.
+ *
+ */
+ParameterSweep::ParameterSweep(const PanelData& p, unsigned long buckets) {
+	
+	panel = &p;
+	numBuckets = buckets;
+	
+	maxFormation = 0;
+	maxHolding = 0;
+	skipMonths = 0;
+	
+	buildPrefix();
+
+}
+
+/**
+ *
+ * This method is private. It sums log(1 + r) of every symbol month by month.
+ * A return rate of -100% or less has no logarithm, so it is limited to -99.9999%.
+ *
+ */
+void ParameterSweep::buildPrefix() {
+	
+	unsigned long numMonths = panel->getNumMonths();
+	unsigned long numSymbols = panel->getNumSymbols();
+	
+	logPrefix.assign((numMonths + 1) * numSymbols, 0);
+	
+	for (unsigned long m = 0; m < numMonths; m++) {
+		
+		const double* column = panel->getMonthColumn(m);
+		const double* previous = &logPrefix[m * numSymbols];
+		double* current = &logPrefix[(m + 1) * numSymbols];
+		
+		for (unsigned long s = 0; s < numSymbols; s++) {
+			current[s] = previous[s] + log1p(max(column[s], -0.999999));
+		}
+	
+	}
+
+}
+
+/**
+ *
+ * This method is private. It gets compound return of a symbol over a window.
+ * A single month window reads the return rate directly, since a difference of
+ * prefix sums is not exact in floating point, and would break ties among equal
+ * return rates differently from the 1 x 1 run of main program.
+ *
+ * @param symbolId: ID of the symbol.
+ * @param first: index of first month in the window.
+ * @param last: index of last month in the window.
+ *
+ * return compound return rate over the window.
+ *
+ */
+double ParameterSweep::windowReturn(unsigned long symbolId, unsigned long first, unsigned long last) const {
+	
+	if (first == last) {
+		return panel->getMonthColumn(first)[symbolId];
+	}
+	
+	unsigned long numSymbols = panel->getNumSymbols();
+	return expm1(logPrefix[(last + 1) * numSymbols + symbolId] - logPrefix[first * numSymbols + symbolId]);
+
+}
+
+/**
+ *
+ * This method evaluates the whole grid. For formation month t and formation length J,
+ * stocks are ranked by compound return over months [t - J + 1, t]. Top and bottom
+ * buckets are then held over months [t + S + 1, t + S + K] for every K, and their
+ * average compound returns are recorded. Formation months without enough history
+ * or future months for a pair of J and K are left out of that pair.
+ *
+ * @param maxJ: largest formation length in months, at least 1.
+ * @param maxK: largest holding length in months, at least 1.
+ * @param skip: number of months skipped between formation and holding.
+ * @param pool: thread pool to rank formation months on, or null to run serially.
+ *
+ */
+void ParameterSweep::run(unsigned long maxJ, unsigned long maxK, unsigned long skip, ThreadPool* pool) {
+	
+	PROFILE_STAGE(SWEEP);
+	
+	maxFormation = maxJ;
+	maxHolding = maxK;
+	skipMonths = skip;
+	
+	unsigned long numMonths = panel->getNumMonths();
+	unsigned long numSymbols = panel->getNumSymbols();
+	unsigned long numCells = maxJ * maxK;
+	unsigned long numWords = panel->getMaskWords();
+	
+	// Averages of each formation month and cell, summed up in order afterwards.
+	// A cell without valid result for a month is marked by NaN.
+	vector<double> topResults(numMonths * numCells, NAN);
+	vector<double> bottomResults(numMonths * numCells, NAN);
+	
+	auto formMonth = [&](unsigned long t) {
+		
+		Ranking ranking;
+		vector<double> formationReturns(numSymbols);
+		vector<unsigned long> top, bottom;
+		
+		// Stocks with return rates in every month of the formation and holding windows,
+		// narrowed a month at a time as the windows grow.
+		vector<uint64_t> formationMask(numWords, ~0ULL);
+		vector<uint64_t> holdingMask(numWords);
+		
+		for (unsigned long j = 1; j <= maxJ && j <= t + 1; j++) {
+			
+			// Nothing to hold if even the shortest holding window passes the last month.
+			if (t + skip + 1 >= numMonths) {
+				break;
+			}
+			
+			unsigned long numCandidates = 0;
+			const uint64_t* monthMask = panel->getValidMask(t + 1 - j);
+			for (unsigned long w = 0; w < numWords; w++) {
+				formationMask[w] &= monthMask[w];
+				numCandidates += __builtin_popcountll(formationMask[w]);
+			}
+			
+			for (unsigned long s = 0; s < numSymbols; s++) {
+				formationReturns[s] = windowReturn(s, t + 1 - j, t);
+			}
+			
+			unsigned long bucketSize = numCandidates / numBuckets;
+			ranking.assignValid(formationReturns.data(), formationMask.data(), numSymbols);
+			ranking.selectTop(bucketSize, top);
+			ranking.selectBottom(bucketSize, bottom);
+			
+			holdingMask.assign(numWords, ~0ULL);
+			
+			for (unsigned long k = 1; k <= maxK && t + skip + k < numMonths; k++) {
+				
+				unsigned long first = t + skip + 1;
+				unsigned long last = t + skip + k;
+				
+				monthMask = panel->getValidMask(last);
+				for (unsigned long w = 0; w < numWords; w++) {
+					holdingMask[w] &= monthMask[w];
+				}
+				
+				// Stocks missing any holding month are left out of the averages.
+				double topSum = 0, bottomSum = 0;
+				unsigned long topCount = 0, bottomCount = 0;
+				for (const unsigned long& id : top) {
+					if ((holdingMask[id / 64] >> (id % 64)) & 1) {
+						topSum += windowReturn(id, first, last);
+						topCount++;
+					}
+				}
+				for (const unsigned long& id : bottom) {
+					if ((holdingMask[id / 64] >> (id % 64)) & 1) {
+						bottomSum += windowReturn(id, first, last);
+						bottomCount++;
+					}
+				}
+				
+				if (topCount == 0 || bottomCount == 0) {
+					continue;
+				}
+				
+				unsigned long cell = (j - 1) * maxK + (k - 1);
+				topResults[t * numCells + cell] = topSum / static_cast<double>(topCount);
+				bottomResults[t * numCells + cell] = bottomSum / static_cast<double>(bottomCount);
+			}
+		
+		}
+	
+	};
+	
+	if (pool != nullptr) {
+		pool->parallelFor(numMonths, formMonth);
+	} else {
+		for (unsigned long t = 0; t < numMonths; t++) {
+			formMonth(t);
+		}
+	}
+	
+	// Average over formation months in chronological order.
+	cells.assign(numCells, SweepCell());
+	
+	for (unsigned long j = 1; j <= maxJ; j++) {
+		for (unsigned long k = 1; k <= maxK; k++) {
+			
+			unsigned long cell = (j - 1) * maxK + (k - 1);
+			SweepCell& result = cells[cell];
+			result.formationMonths = j;
+			result.holdingMonths = k;
+			result.numPeriods = 0;
+			result.topAverage = 0;
+			result.bottomAverage = 0;
+			
+			for (unsigned long t = 0; t < numMonths; t++) {
+				
+				double topAverage = topResults[t * numCells + cell];
+				if (std::isnan(topAverage)) {
+					continue;
+				}
+				
+				result.topAverage += topAverage;
+				result.bottomAverage += bottomResults[t * numCells + cell];
+				result.numPeriods++;
+			}
+			
+			if (result.numPeriods > 0) {
+				result.topAverage /= result.numPeriods;
+				result.bottomAverage /= result.numPeriods;
+			}
+			result.spreadAverage = result.bottomAverage - result.topAverage;
+		
+		}
+	}
+
+}
+
+/**
+ *
+ * This method evaluates a single pair of formation and holding lengths for every
+ * formation month in a range, as run() does for each cell of the grid, and keeps
+ * results of each formation month instead of their averages. It only reads the
+ * panel and prefix sums, so several threads may call it at the same time.
+ * Formation months without enough history or future months, or whose buckets hold
+ * no stock for the whole holding window, are left out.
+ *
+ * @param buckets: number of buckets N, top and bottom buckets hold 1/N of stocks.
+ * @param j: formation length in months, at least 1.
+ * @param k: holding length in months, at least 1.
+ * @param skip: number of months skipped between formation and holding.
+ * @param first: index of first formation month.
+ * @param last: index of last formation month.
+ * @param strategy: direction and legs of the portfolio built from both buckets.
+ *
+ * return results of the formation months in chronological order, holding period
+ * returns being compounded over K months.
+ *
+ */
+vector<PeriodResult> ParameterSweep::evaluate(unsigned long buckets, unsigned long j, unsigned long k, unsigned long skip, unsigned long first, unsigned long last, const Strategy& strategy) const {
+	
+	unsigned long numMonths = panel->getNumMonths();
+	unsigned long numSymbols = panel->getNumSymbols();
+	unsigned long numWords = panel->getMaskWords();
+	
+	vector<PeriodResult> results;
+	
+	Ranking ranking;
+	vector<double> formationReturns(numSymbols);
+	vector<unsigned long> top, bottom;
+	vector<uint64_t> formationMask(numWords), holdingMask(numWords);
+	
+	for (unsigned long t = max(first, j - 1); t <= last && t + skip + k < numMonths; t++) {
+		
+		// Stocks with return rates in every month of both windows.
+		formationMask.assign(numWords, ~0ULL);
+		holdingMask.assign(numWords, ~0ULL);
+		for (unsigned long m = t + 1 - j; m <= t; m++) {
+			const uint64_t* monthMask = panel->getValidMask(m);
+			for (unsigned long w = 0; w < numWords; w++) {
+				formationMask[w] &= monthMask[w];
+			}
+		}
+		for (unsigned long m = t + skip + 1; m <= t + skip + k; m++) {
+			const uint64_t* monthMask = panel->getValidMask(m);
+			for (unsigned long w = 0; w < numWords; w++) {
+				holdingMask[w] &= monthMask[w];
+			}
+		}
+		
+		unsigned long numCandidates = 0;
+		for (unsigned long w = 0; w < numWords; w++) {
+			numCandidates += __builtin_popcountll(formationMask[w]);
+		}
+		
+		for (unsigned long s = 0; s < numSymbols; s++) {
+			formationReturns[s] = windowReturn(s, t + 1 - j, t);
+		}
+		
+		unsigned long bucketSize = numCandidates / buckets;
+		ranking.assignValid(formationReturns.data(), formationMask.data(), numSymbols);
+		ranking.selectTop(bucketSize, top);
+		ranking.selectBottom(bucketSize, bottom);
+		
+		double topSum = 0, bottomSum = 0;
+		unsigned long topCount = 0, bottomCount = 0;
+		for (const unsigned long& id : top) {
+			if ((holdingMask[id / 64] >> (id % 64)) & 1) {
+				topSum += windowReturn(id, t + skip + 1, t + skip + k);
+				topCount++;
+			}
+		}
+		for (const unsigned long& id : bottom) {
+			if ((holdingMask[id / 64] >> (id % 64)) & 1) {
+				bottomSum += windowReturn(id, t + skip + 1, t + skip + k);
+				bottomCount++;
+			}
+		}
+		
+		if (topCount == 0 || bottomCount == 0) {
+			continue;
+		}
+		
+		PeriodResult result;
+		result.date = panel->getDateLabel(t);
+		result.topAverage = topSum / static_cast<double>(topCount);
+		result.bottomAverage = bottomSum / static_cast<double>(bottomCount);
+		result.average = strategy.combine(result.topAverage, result.bottomAverage);
+		results.push_back(result);
+	}
+	
+	return results;
+
+}
+
+/**
+ *
+ * This method writes grid summary as csv. Each row is one pair of formation and
+ * holding lengths, with number of formation months evaluated, average holding
+ * period return of top and bottom buckets, their difference, and the difference
+ * divided by holding length.
+ *
+ * @param writer: the writer of output file, already opened.
+ *
+ */
+void ParameterSweep::writeCsv(ResultWriter& writer) const {
+	
+	ostringstream percent;
+	percent << 100.0 / numBuckets;
+	
+	writer.append("Formation months,Holding months,Skipped months,Periods");
+	writer.append(",Average return of first " + percent.str() + "% percentile");
+	writer.append(",Average return of last " + percent.str() + "% percentile");
+	writer.append(",Total average return,Total average return per month\n");
+	
+	for (const SweepCell& cell : cells) {
+		
+		writer.appendNumber(cell.formationMonths);
+		writer.append(',');
+		writer.appendNumber(cell.holdingMonths);
+		writer.append(',');
+		writer.appendNumber(skipMonths);
+		writer.append(',');
+		writer.appendNumber(cell.numPeriods);
+		writer.append(',');
+		writer.appendNumber(cell.topAverage);
+		writer.append(',');
+		writer.appendNumber(cell.bottomAverage);
+		writer.append(',');
+		writer.appendNumber(cell.spreadAverage);
+		writer.append(',');
+		writer.appendNumber(cell.spreadAverage / cell.holdingMonths);
+		writer.append('\n');
+	
+	}
+
+}
@@ -0,0 +1,105 @@
+//
+//  ParameterSweep.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef ParameterSweep_h
+#define ParameterSweep_h
+
+#include <vector>
+#include "PanelData.h"
+#include "ThreadPool.h"
+#include "ResultWriter.h"
+#include "MonthlyData.h"
+
+using namespace std;
+
+/**
+ *
+ * Parameter sweep class header code:
+ *
+ * This header file defines the engine which evaluates a whole grid of formation
+ * and holding periods in one run.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class evaluates strategies that rank stocks by their cumulative return over
+ * J formation months, optionally skip S months, and hold top and bottom buckets for
+ * K months, for every J and K up to given maximums.
+ *
+ * Cumulative log returns log(1 + r) of every symbol are summed once into prefix
+ *	sums, so the compound return of any window is exp(P[last + 1] - P[first]) - 1,
+ *	which costs O(1) regardless of window length.
+ * Prefix sums are kept month by month, so ranking a formation window reads two
+ *	contiguous rows.
+ * Each formation month is ranked once per J and reused for all K. Results of
+ *	formation months are summed in chronological order, so they do not depend on
+ *	number of threads.
+ * Only stocks with return rates in all J formation months are ranked, and only
+ *	those with return rates in all K holding months count in the averages.
+ * A single pair of J and K can also be evaluated month by month, e.g. for queries
+ *	of a daemon, reusing the prefix sums built once for the panel.
+ *
+ */
+class ParameterSweep {
+
+private:
+	
+	// Averages of one grid cell, i.e. one pair of formation and holding lengths.
+	struct SweepCell {
+		unsigned long formationMonths;
+		unsigned long holdingMonths;
+		unsigned long numPeriods;
+		double topAverage;
+		double bottomAverage;
+		double spreadAverage;
+	};
+	
+	// The panel providing return rates.
+	const PanelData* panel;
+	
+	// Number of buckets, top and bottom buckets hold 1/N of stocks each.
+	unsigned long numBuckets;
+	
+	// Prefix sums of log returns, (numMonths + 1) rows of numSymbols entries,
+	// row m holds sums over months before m.
+	vector<double> logPrefix;
+	
+	// Grid settings and results.
+	unsigned long maxFormation;
+	unsigned long maxHolding;
+	unsigned long skipMonths;
+	vector<SweepCell> cells;
+	
+	// The method builds prefix sums of log returns.
+	void buildPrefix();
+	
+	// Compound return of a symbol over months [first, last].
+	double windowReturn(unsigned long symbolId, unsigned long first, unsigned long last) const;
+
+public:
+	
+	// A default constructor specifying panel and number of buckets.
+	ParameterSweep(const PanelData& p, unsigned long buckets);
+	
+	// The method evaluates all J in [1, maxJ] and K in [1, maxK] with S skipped months.
+	void run(unsigned long maxJ, unsigned long maxK, unsigned long skip, ThreadPool* pool);
+	
+	// The method writes grid summary, one row per pair of J and K.
+	void writeCsv(ResultWriter& writer) const;
+	
+	// The method evaluates one pair of J and K per formation month in a range, and may be called by several threads.
+	vector<PeriodResult> evaluate(unsigned long buckets, unsigned long j, unsigned long k, unsigned long skip, unsigned long first, unsigned long last, const Strategy& strategy) const;
+
+};
+
+
+#endif /* ParameterSweep_h */
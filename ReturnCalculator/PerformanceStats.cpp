@@ -0,0 +1,381 @@
+//
+//  PerformanceStats.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "PerformanceStats.h"
+
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of RunningStats and PerformanceStats classes, and the writer of "stats.csv".
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This is default constructor of statistics without any number.
+ *
+ */
+RunningStats::RunningStats() {
+	
+	count = 0;
+	positives = 0;
+	mean = 0;
+	squares = 0;
+
+}
+
+/**
+ *
+ * This method adds a number, moving the mean towards it and adding its squared
+ * deviation from the old and new means.
+ *
+ * @param x: the number.
+ *
+ */
+void RunningStats::add(double x) {
+	
+	count++;
+	positives += x > 0 ? 1 : 0;
+	
+	double delta = x - mean;
+	mean += delta / static_cast<double>(count);
+	squares += delta * (x - mean);
+
+}
+
+/**
+ *
+ * This method removes a number added before, reversing add().
+ *
+ * @param x: the number.
+ *
+ */
+void RunningStats::remove(double x) {
+	
+	if (count <= 1) {
+		*this = RunningStats();
+		return;
+	}
+	
+	count--;
+	positives -= x > 0 ? 1 : 0;
+	
+	double delta = x - mean;
+	mean -= delta / static_cast<double>(count);
+	squares = max(0.0, squares - delta * (x - mean));
+
+}
+
+/**
+ *
+ * These methods are inspectors for number of numbers, their mean, sample variance
+ * and standard deviation, and share of positive numbers. Statistics that need
+ * more numbers than there are, e.g. variance of one number, are NaN.
+ *
+ */
+unsigned long RunningStats::getCount() const {
+	
+	return count;
+
+}
+
+double RunningStats::getMean() const {
+	
+	return count > 0 ? mean : NAN;
+
+}
+
+double RunningStats::getVariance() const {
+	
+	return count > 1 ? squares / static_cast<double>(count - 1) : NAN;
+
+}
+
+double RunningStats::getStandardDeviation() const {
+	
+	return sqrt(getVariance());
+
+}
+
+double RunningStats::getHitRate() const {
+	
+	return count > 0 ? static_cast<double>(positives) / static_cast<double>(count) : NAN;
+
+}
+
+/**
+ *
+ * This is default constructor of statistics of an empty series.
+ *
+ * @param perYear: number of periods per year, e.g. 12 for monthly returns.
+ * @param windowLength: number of periods in rolling window, 0 for no rolling statistics.
+ *
+ */
+PerformanceStats::PerformanceStats(double perYear, unsigned long windowLength) {
+	
+	periodsPerYear = perYear;
+	window = windowLength;
+	
+	logWealth = 0;
+	peakLogWealth = 0;
+	maxDrawdown = 0;
+	
+	worstReturn = NAN;
+	bestReturn = NAN;
+	
+	position = 0;
+	returns.assign(window + 1, 0);
+	logWealths.assign(window + 1, 0);
+
+}
+
+/**
+ *
+ * This method is private. It fills annualized statistics of a summary.
+ *
+ * @param stats: count, mean and deviation of period returns.
+ * @param logReturn: sum of log(1 + r) over the same periods.
+ * @param summary: the summary to fill.
+ *
+ */
+void PerformanceStats::summarize(const RunningStats& stats, double logReturn, PerformanceSummary& summary) const {
+	
+	double n = static_cast<double>(stats.getCount());
+	double deviation = stats.getStandardDeviation();
+	
+	summary.numPeriods = stats.getCount();
+	summary.annualizedReturn = n > 0 ? expm1(logReturn * periodsPerYear / n) : NAN;
+	summary.annualizedVolatility = deviation * sqrt(periodsPerYear);
+	summary.sharpeRatio = stats.getMean() / deviation * sqrt(periodsPerYear);
+	summary.tStatistic = stats.getMean() / deviation * sqrt(n);
+	summary.hitRate = stats.getHitRate();
+
+}
+
+/**
+ *
+ * This method adds return of the next period, updating statistics of all periods
+ * and of the window. A return of -100% or less has no logarithm, so its wealth is
+ * limited to a fall of 99.9999%.
+ *
+ * @param periodReturn: return of the period, or NaN to skip it.
+ * @param date: date of the period, which is kept with statistics of its window.
+ *
+ */
+void PerformanceStats::add(double periodReturn, const string& date) {
+	
+	if (std::isnan(periodReturn)) {
+		return;
+	}
+	
+	total.add(periodReturn);
+	logWealth += log1p(max(periodReturn, -0.999999));
+	peakLogWealth = max(peakLogWealth, logWealth);
+	maxDrawdown = min(maxDrawdown, expm1(logWealth - peakLogWealth));
+	
+	worstReturn = std::isnan(worstReturn) ? periodReturn : min(worstReturn, periodReturn);
+	bestReturn = std::isnan(bestReturn) ? periodReturn : max(bestReturn, periodReturn);
+	
+	if (window == 0) {
+		return;
+	}
+	
+	// Period p is the (p + 1)th one, and wealth after it has index p + 1, as wealth
+	// before the first period has index 0.
+	unsigned long p = position++;
+	unsigned long ring = window + 1;
+	
+	returns[p % ring] = periodReturn;
+	logWealths[(p + 1) % ring] = logWealth;
+	
+	recent.add(periodReturn);
+	if (p >= window) {
+		recent.remove(returns[(p - window) % ring]);
+	}
+	
+	// Candidates that can't be the extreme of any later window are dropped from the
+	// back, and those leaving the window from the front.
+	while (!lows.empty() && lows.back().second >= periodReturn) {
+		lows.pop_back();
+	}
+	lows.push_back(make_pair(p, periodReturn));
+	while (lows.front().first + window <= p) {
+		lows.pop_front();
+	}
+	
+	while (!highs.empty() && highs.back().second <= periodReturn) {
+		highs.pop_back();
+	}
+	highs.push_back(make_pair(p, periodReturn));
+	while (highs.front().first + window <= p) {
+		highs.pop_front();
+	}
+	
+	if (p + 1 < window) {
+		return;
+	}
+	
+	PerformanceSummary summary;
+	summarize(recent, logWealth - logWealths[(p + 1 - window) % ring], summary);
+	
+	// Maximum drawdown within the window, starting from wealth before its first period.
+	double peak = logWealths[(p + 1 - window) % ring], drawdown = 0;
+	for (unsigned long w = p + 2 - window; w <= p + 1; w++) {
+		peak = max(peak, logWealths[w % ring]);
+		drawdown = min(drawdown, logWealths[w % ring] - peak);
+	}
+	summary.drawdown = expm1(drawdown);
+	
+	summary.worstReturn = lows.front().second;
+	summary.bestReturn = highs.front().second;
+	
+	rolling.push_back(summary);
+	rollingDates.push_back(date);
+
+}
+
+/**
+ *
+ * This method is inspector to get statistics of all periods added so far.
+ *
+ * return the summary, where drawdown is the maximum drawdown.
+ *
+ */
+PerformanceSummary PerformanceStats::getSummary() const {
+	
+	PerformanceSummary summary;
+	summarize(total, logWealth, summary);
+	summary.drawdown = maxDrawdown;
+	summary.worstReturn = worstReturn;
+	summary.bestReturn = bestReturn;
+	
+	return summary;
+
+}
+
+/**
+ *
+ * These methods are inspectors to get statistics of every full window, in order of
+ * their last periods, and dates of those periods.
+ *
+ */
+const vector<PerformanceSummary>& PerformanceStats::getRolling() const {
+	
+	return rolling;
+
+}
+
+const vector<string>& PerformanceStats::getRollingDates() const {
+	
+	return rollingDates;
+
+}
+
+/**
+ *
+ * This function is private to this file. It writes the figures of a summary as
+ * cells of a csv row, i.e. each one after a comma.
+ *
+ */
+static void writeSummaryCells(ResultWriter& writer, const PerformanceSummary& summary) {
+	
+	double figures[8] = {summary.annualizedReturn, summary.annualizedVolatility, summary.sharpeRatio, summary.tStatistic,
+		summary.drawdown, summary.hitRate, summary.worstReturn, summary.bestReturn};
+	
+	for (const double& figure : figures) {
+		writer.append(',');
+		writer.appendNumber(figure);
+	}
+
+}
+
+/**
+ *
+ * This function writes "stats.csv": statistics over all periods of top, bottom and
+ * long-short returns, one column per series, then statistics of long-short returns
+ * over every rolling window, one row per window, latest first as in "result.csv".
+ * Statistics are annualized by frequency of the periods, estimated from their dates,
+ * e.g. 12 periods per year for monthly results and 252 for daily ones.
+ *
+ * @param writer: the writer of output file, already opened.
+ * @param results: results of every period, in chronological order.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param window: number of periods in rolling window, 0 for no rolling statistics.
+ *
+ * This function does not return any value.
+ *
+ */
+void writeStatistics(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, unsigned long window) {
+	
+	// Results of any date format that can't be parsed are taken as monthly.
+	Calendar calendar;
+	for (const PeriodResult& result : results) {
+		CalendarDate date;
+		if (parseDate(result.date.data(), result.date.data() + result.date.size(), date)) {
+			calendar.add(date);
+		}
+	}
+	double perYear = calendar.size() == results.size() ? calendar.getPeriodsPerYear() : 12;
+	
+	PerformanceStats top(perYear, 0), bottom(perYear, 0), spread(perYear, window);
+	
+	for (const PeriodResult& result : results) {
+		top.add(result.topAverage);
+		bottom.add(result.bottomAverage);
+		spread.add(result.average, result.date);
+	}
+	
+	ostringstream percent;
+	percent << 100.0 / numBuckets;
+	
+	PerformanceSummary summaries[3] = {top.getSummary(), bottom.getSummary(), spread.getSummary()};
+	const char* names[9] = {"Periods", "Annualized return", "Annualized volatility", "Sharpe ratio", "t-statistic",
+		"Maximum drawdown", "Hit rate", "Worst period return", "Best period return"};
+	
+	writer.append("Statistic,First " + percent.str() + "% percentile,Last " + percent.str() + "% percentile,Total (last - first)\n");
+	
+	for (unsigned long row = 0; row < 9; row++) {
+		
+		writer.append(names[row]);
+		
+		for (const PerformanceSummary& summary : summaries) {
+			
+			double figures[9] = {static_cast<double>(summary.numPeriods), summary.annualizedReturn, summary.annualizedVolatility,
+				summary.sharpeRatio, summary.tStatistic, summary.drawdown, summary.hitRate, summary.worstReturn, summary.bestReturn};
+			
+			writer.append(',');
+			writer.appendNumber(figures[row]);
+		}
+		
+		writer.append('\n');
+	}
+	
+	if (window == 0) {
+		return;
+	}
+	
+	writer.append("\nRolling " + to_string(window) + " periods of total (last - first)\n");
+	writer.append("Period,Annualized return,Annualized volatility,Sharpe ratio,t-statistic,Maximum drawdown,Hit rate,Worst period return,Best period return\n");
+	
+	const vector<PerformanceSummary>& rolling = spread.getRolling();
+	const vector<string>& dates = spread.getRollingDates();
+	
+	for (unsigned long i = rolling.size(); i-- > 0;) {
+		writer.append(dates[i]);
+		writeSummaryCells(writer, rolling[i]);
+		writer.append('\n');
+	}
+
+}
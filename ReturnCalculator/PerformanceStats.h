@@ -0,0 +1,179 @@
+//
+//  PerformanceStats.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef PerformanceStats_h
+#define PerformanceStats_h
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MonthlyData.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+/**
+ *
+ * Performance statistics class header code:
+ *
+ * This header file defines online statistics of a series of period returns, e.g.
+ * the long-short return of every month, over the whole series and over a rolling
+ * window of recent periods.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps mean and variance of a stream of numbers by Welford's method,
+ * i.e. running mean and sum of squared deviations from it, which is numerically
+ * stable. Numbers can be removed again, so a sliding window is updated in O(1)
+ * per step. Number of positive values is counted as well.
+ *
+ */
+class RunningStats {
+
+private:
+	
+	unsigned long count;
+	unsigned long positives;
+	double mean;
+	double squares;
+
+public:
+	
+	// A default constructor of empty statistics.
+	RunningStats();
+	
+	// Mutators to add a number, or remove one added before.
+	void add(double x);
+	void remove(double x);
+	
+	// Inspectors for count, mean, sample variance and standard deviation, and share of positive numbers.
+	unsigned long getCount() const;
+	double getMean() const;
+	double getVariance() const;
+	double getStandardDeviation() const;
+	double getHitRate() const;
+
+};
+
+
+/**
+ *
+ * This struct holds statistics of a series over all periods, or over the window
+ * ending at one period.
+ *
+ */
+struct PerformanceSummary {
+	
+	// Number of periods counted.
+	unsigned long numPeriods;
+	
+	// Compounded return per year, and standard deviation of period returns scaled to a year.
+	double annualizedReturn;
+	double annualizedVolatility;
+	
+	// Mean over standard deviation scaled to a year, and mean over its standard error.
+	double sharpeRatio;
+	double tStatistic;
+	
+	// Largest fall of cumulative wealth from its peak over all periods, or within
+	// the window, as a negative return.
+	double drawdown;
+	
+	// Share of periods with a positive return.
+	double hitRate;
+	
+	// Lowest and highest period returns.
+	double worstReturn;
+	double bestReturn;
+
+};
+
+
+/**
+ *
+ * This class updates statistics of a series period by period, in O(1) amortized
+ * time per period, besides O(window) for the drawdown of the window, and O(window)
+ * working memory whatever the length of the series, so it stays cheap on long
+ * histories and on many series.
+ *
+ * Cumulative wealth is kept as sum of log(1 + r), so it neither overflows nor
+ * underflows. Its peak over all periods gives the maximum drawdown.
+ * Over a window of the latest W periods, mean and variance are updated by adding
+ *	the newest return and removing the one leaving the window. Lowest and highest
+ *	returns in the window are read from monotonic deques, which only keep periods
+ *	that may still become the extreme of a later window. Maximum drawdown of the
+ *	window is found by one pass over its wealths in the ring buffer.
+ * Periods without a return (NaN) are skipped.
+ *
+ */
+class PerformanceStats {
+
+private:
+	
+	// Periods per year, and length of rolling window in periods.
+	double periodsPerYear;
+	unsigned long window;
+	
+	// Statistics of all periods, and of the window.
+	RunningStats total;
+	RunningStats recent;
+	
+	// Cumulative log wealth, its peak, and maximum drawdown so far.
+	double logWealth;
+	double peakLogWealth;
+	double maxDrawdown;
+	
+	// Lowest and highest returns of all periods.
+	double worstReturn;
+	double bestReturn;
+	
+	// Number of periods added, and returns and cumulative log wealth of the latest
+	// window + 1 periods in ring buffers indexed by position modulo window + 1.
+	unsigned long position;
+	vector<double> returns;
+	vector<double> logWealths;
+	
+	// Positions and values of candidates for lowest and highest returns of the window,
+	// oldest first.
+	deque<pair<unsigned long, double>> lows;
+	deque<pair<unsigned long, double>> highs;
+	
+	// Statistics of every full window, and date of its last period.
+	vector<PerformanceSummary> rolling;
+	vector<string> rollingDates;
+	
+	// The method fills annualized figures of a summary from count, mean, deviation and log return.
+	void summarize(const RunningStats& stats, double logReturn, PerformanceSummary& summary) const;
+
+public:
+	
+	// A default constructor specifying periods per year and window length.
+	PerformanceStats(double perYear, unsigned long windowLength);
+	
+	// The method adds return of the next period.
+	void add(double periodReturn, const string& date = string());
+	
+	// Inspectors for statistics of all periods, and of every full window in order.
+	PerformanceSummary getSummary() const;
+	const vector<PerformanceSummary>& getRolling() const;
+	const vector<string>& getRollingDates() const;
+
+};
+
+
+// The function writes statistics of top, bottom and long-short returns of all periods, and rolling ones of long-short returns.
+void writeStatistics(ResultWriter& writer, const vector<PeriodResult>& results, unsigned long numBuckets, unsigned long window);
+
+
+#endif /* PerformanceStats_h */
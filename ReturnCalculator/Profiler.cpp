@@ -0,0 +1,304 @@
+//
+//  Profiler.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of Profiler, ScopedTimer and ProfileReport classes.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Names of stages and counters in the report, in order of the enums.
+static const char* stageNames[Profiler::NUM_STAGES] = {"parse", "cache", "rank", "lookup", "write", "resample", "sweep"};
+static const char* counterNames[Profiler::NUM_COUNTERS] = {"rowsParsed", "cellsParsed", "missingCells", "symbolLookups", "lookupMisses", "returnLookups", "bytesWritten"};
+
+bool Profiler::enabled = false;
+atomic<uint64_t> Profiler::stageNanoseconds[Profiler::NUM_STAGES];
+atomic<uint64_t> Profiler::stageCalls[Profiler::NUM_STAGES];
+atomic<uint64_t> Profiler::counts[Profiler::NUM_COUNTERS];
+mutex Profiler::monthLock;
+vector<Profiler::MonthRecord> Profiler::months;
+unordered_map<string, unsigned long> Profiler::monthIndex;
+
+
+/**
+ *
+ * This function quotes a string as a JSON string.
+ *
+ * @param text: the string.
+ *
+ * return the string in double quotes, with quotes, backslashes and control
+ * characters escaped.
+ *
+ */
+string quoteJson(const string& text) {
+	
+	ostringstream quoted;
+	quoted << '"';
+	
+	for (const char& c : text) {
+		
+		if (c == '"' || c == '\\') {
+			quoted << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			quoted << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(c) << dec;
+		} else {
+			quoted << c;
+		}
+	
+	}
+	
+	quoted << '"';
+	return quoted.str();
+
+}
+
+/**
+ *
+ * This method turns recording on. It is supposed to be called before any stage
+ * starts, as the switch itself is not synchronized.
+ *
+ */
+void Profiler::enable() {
+	
+	enabled = true;
+
+}
+
+/**
+ *
+ * This method is private. It finds the record of a month, and appends an empty
+ * one for a new month. monthLock must be held by the caller.
+ *
+ * @param date: date of the month.
+ *
+ * return reference of the record.
+ *
+ */
+Profiler::MonthRecord& Profiler::getMonth(const string& date) {
+	
+	auto found = monthIndex.find(date);
+	if (found != monthIndex.end()) {
+		return months[found->second];
+	}
+	
+	MonthRecord record = {};
+	record.date = date;
+	
+	monthIndex[date] = months.size();
+	months.push_back(record);
+	
+	return months.back();
+
+}
+
+/**
+ *
+ * This method registers a month before its stages run, so months are reported
+ * in the order they are registered, even if they are processed out of order.
+ *
+ * @param date: date of the month.
+ *
+ */
+void Profiler::addMonth(const string& date) {
+	
+	lock_guard<mutex> lock(monthLock);
+	getMonth(date);
+
+}
+
+/**
+ *
+ * This method adds time of one call of a stage.
+ *
+ * @param stage: the stage.
+ * @param nanoseconds: elapsed wall-clock time.
+ * @param date: date of the month the call belongs to, or empty.
+ *
+ */
+void Profiler::addTime(Stage stage, uint64_t nanoseconds, const string& date) {
+	
+	stageNanoseconds[stage].fetch_add(nanoseconds, memory_order_relaxed);
+	stageCalls[stage].fetch_add(1, memory_order_relaxed);
+	
+	if (!date.empty()) {
+		lock_guard<mutex> lock(monthLock);
+		MonthRecord& record = getMonth(date);
+		record.nanoseconds[stage] += nanoseconds;
+		record.calls[stage]++;
+	}
+
+}
+
+/**
+ *
+ * This method adds to a counter.
+ *
+ * @param counter: the counter.
+ * @param n: number of events.
+ * @param date: date of the month the events belong to, or empty.
+ *
+ */
+void Profiler::count(Counter counter, uint64_t n, const string& date) {
+	
+	counts[counter].fetch_add(n, memory_order_relaxed);
+	
+	if (!date.empty()) {
+		lock_guard<mutex> lock(monthLock);
+		getMonth(date).counts[counter] += n;
+	}
+
+}
+
+/**
+ *
+ * This method writes the report: totals of stages with number of calls and
+ * seconds, totals of counters, then every month with its own stages and counters.
+ * Stages and counters a month has no record of are left out of it.
+ *
+ * @param fileName: path of the report.
+ *
+ * return false if the report can't be written.
+ *
+ */
+bool Profiler::writeJson(const string& fileName) {
+	
+	ofstream output(fileName, ios::trunc);
+	if (!output.is_open()) {
+		return false;
+	}
+	
+	output << setprecision(9);
+	
+	output << "{\n  \"stages\": {";
+	for (int s = 0; s < NUM_STAGES; s++) {
+		output << (s > 0 ? "," : "") << "\n    \"" << stageNames[s] << "\": {\"calls\": " << stageCalls[s].load();
+		output << ", \"seconds\": " << stageNanoseconds[s].load() / 1e9 << "}";
+	}
+	output << "\n  },\n  \"counters\": {";
+	for (int c = 0; c < NUM_COUNTERS; c++) {
+		output << (c > 0 ? "," : "") << "\n    \"" << counterNames[c] << "\": " << counts[c].load();
+	}
+	output << "\n  },\n  \"months\": [";
+	
+	lock_guard<mutex> lock(monthLock);
+	
+	for (unsigned long m = 0; m < months.size(); m++) {
+		
+		const MonthRecord& record = months[m];
+		output << (m > 0 ? "," : "") << "\n    {\"date\": " << quoteJson(record.date) << ", \"stages\": {";
+		
+		bool first = true;
+		for (int s = 0; s < NUM_STAGES; s++) {
+			if (record.calls[s] > 0) {
+				output << (first ? "" : ", ") << "\"" << stageNames[s] << "\": {\"calls\": " << record.calls[s] << ", \"seconds\": " << record.nanoseconds[s] / 1e9 << "}";
+				first = false;
+			}
+		}
+		
+		output << "}, \"counters\": {";
+		
+		first = true;
+		for (int c = 0; c < NUM_COUNTERS; c++) {
+			if (record.counts[c] > 0) {
+				output << (first ? "" : ", ") << "\"" << counterNames[c] << "\": " << record.counts[c];
+				first = false;
+			}
+		}
+		
+		output << "}}";
+	}
+	
+	output << "\n  ]\n}\n";
+	output.close();
+	
+	return static_cast<bool>(output);
+
+}
+
+/**
+ *
+ * This is constructor which starts timing a stage, if the profiler is enabled.
+ *
+ * @param s: the stage.
+ * @param d: date of the month the stage works on, or empty.
+ *
+ */
+ScopedTimer::ScopedTimer(Profiler::Stage s, const string& d) {
+	
+	stage = s;
+	running = Profiler::isEnabled();
+	
+	if (running) {
+		date = d;
+		start = chrono::steady_clock::now();
+	}
+
+}
+
+/**
+ *
+ * This is destructor which adds elapsed time to the stage.
+ *
+ */
+ScopedTimer::~ScopedTimer() {
+	
+	if (running) {
+		chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+		Profiler::addTime(stage, static_cast<uint64_t>(elapsed.count()), date);
+	}
+
+}
+
+/**
+ *
+ * This is constructor which enables the profiler if a report is requested.
+ *
+ * @param name: path of the report, or empty for no report.
+ *
+ */
+ProfileReport::ProfileReport(const string& name) {
+	
+	fileName = name;
+	
+	if (fileName.empty()) {
+		return;
+	}
+
+#ifdef RETURNCALC_NO_PROFILE
+	cout << "Profiling is disabled in this build, \"--profile\" is ignored." << endl;
+	fileName.clear();
+#else
+	Profiler::enable();
+#endif
+
+}
+
+/**
+ *
+ * This is destructor which writes the report, if one was requested.
+ *
+ */
+ProfileReport::~ProfileReport() {
+	
+	if (!fileName.empty() && !Profiler::writeJson(fileName)) {
+		cout << "Can't write profile report: " << fileName << endl;
+	}
+
+}
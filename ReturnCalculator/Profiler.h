@@ -0,0 +1,192 @@
+//
+//  Profiler.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Profiler_h
+#define Profiler_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ *
+ * Profiler class header code:
+ *
+ * This header file defines timers and counters of processing stages, which are
+ * written as a JSON report by "--profile FILE".
+ *
+ * Stages and counters are recorded through the PROFILE_ macros below. They do
+ * nothing until the profiler is enabled at run time, and arguments are only
+ * evaluated when it is. Building with -DRETURNCALC_NO_PROFILE ("make PROFILE=0")
+ * removes them altogether.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps totals of all stages and counters of the process, and the same
+ * per month, in chronological order of registered months.
+ *
+ * Totals are atomic, so stages running on different threads are added up without
+ * locks. Records of months are locked, which happens about once per month and stage.
+ * Time of a stage is wall-clock time summed over all calls, so it may be longer
+ * than the run when months are processed by several threads.
+ *
+ */
+class Profiler {
+
+public:
+	
+	// Timed stages of the process.
+	enum Stage {PARSE, CACHE, RANK, LOOKUP, WRITE, RESAMPLE, SWEEP, NUM_STAGES};
+	
+	// Counted events.
+	enum Counter {ROWS_PARSED, CELLS_PARSED, MISSING_CELLS, SYMBOL_LOOKUPS, LOOKUP_MISSES, RETURN_LOOKUPS, BYTES_WRITTEN, NUM_COUNTERS};
+
+private:
+	
+	// Records of one month.
+	struct MonthRecord {
+		string date;
+		uint64_t nanoseconds[NUM_STAGES];
+		uint64_t calls[NUM_STAGES];
+		uint64_t counts[NUM_COUNTERS];
+	};
+	
+	// Whether recording is on, set before any work starts.
+	static bool enabled;
+	
+	// Totals of the whole process.
+	static atomic<uint64_t> stageNanoseconds[NUM_STAGES];
+	static atomic<uint64_t> stageCalls[NUM_STAGES];
+	static atomic<uint64_t> counts[NUM_COUNTERS];
+	
+	// Records of months, and index of each month's record by date.
+	static mutex monthLock;
+	static vector<MonthRecord> months;
+	static unordered_map<string, unsigned long> monthIndex;
+	
+	// The method gets the record of a month, adding it if needed. monthLock must be held.
+	static MonthRecord& getMonth(const string& date);
+
+public:
+	
+	// The method turns recording on.
+	static void enable();
+	
+	// Inspector of whether recording is on.
+	static bool isEnabled() {
+		return enabled;
+	}
+	
+	// The method registers a month, so records of months follow registration order.
+	static void addMonth(const string& date);
+	
+	// The methods add time of a stage and a count, for a month as well if date is given.
+	static void addTime(Stage stage, uint64_t nanoseconds, const string& date);
+	static void count(Counter counter, uint64_t n, const string& date = string());
+	
+	// The method writes all records as JSON, returns false if the file can't be written.
+	static bool writeJson(const string& fileName);
+
+};
+
+
+// The function quotes a string for JSON output.
+string quoteJson(const string& text);
+
+
+/**
+ *
+ * This class times a stage from its construction to its destruction, i.e. the
+ * rest of the scope it is declared in.
+ *
+ */
+class ScopedTimer {
+
+private:
+	
+	Profiler::Stage stage;
+	string date;
+	bool running;
+	chrono::steady_clock::time_point start;
+
+public:
+	
+	// A constructor starting the timer of a stage, for a month if date is not empty.
+	ScopedTimer(Profiler::Stage s, const string& d = string());
+	
+	// The destructor adds elapsed time to the stage.
+	~ScopedTimer();
+	
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+};
+
+
+/**
+ *
+ * This class writes the profile report when it goes out of scope, so the report
+ * is written whichever way main function returns.
+ *
+ */
+class ProfileReport {
+
+private:
+	
+	string fileName;
+
+public:
+	
+	// A constructor enabling the profiler if a report file is given.
+	ProfileReport(const string& name);
+	
+	// The destructor writes the report.
+	~ProfileReport();
+
+};
+
+
+#ifdef RETURNCALC_NO_PROFILE
+
+#define PROFILE_STAGE(stage)
+#define PROFILE_MONTH_STAGE(stage, date)
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_MONTH_COUNT(counter, date, n)
+#define PROFILE_ADD_MONTH(date)
+
+#else
+
+#define PROFILE_JOIN_NAME(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_JOIN_NAME(a, b)
+
+// Times the rest of current scope as a stage, optionally of a month.
+#define PROFILE_STAGE(stage) ScopedTimer PROFILE_NAME(profileTimer, __LINE__)(Profiler::stage)
+#define PROFILE_MONTH_STAGE(stage, date) ScopedTimer PROFILE_NAME(profileTimer, __LINE__)(Profiler::stage, Profiler::isEnabled() ? (date) : string())
+
+// Adds n to a counter, optionally of a month.
+#define PROFILE_COUNT(counter, n) do { if (Profiler::isEnabled()) Profiler::count(Profiler::counter, (n)); } while (0)
+#define PROFILE_MONTH_COUNT(counter, date, n) do { if (Profiler::isEnabled()) Profiler::count(Profiler::counter, (n), (date)); } while (0)
+
+// Registers a month in chronological order.
+#define PROFILE_ADD_MONTH(date) do { if (Profiler::isEnabled()) Profiler::addMonth(date); } while (0)
+
+#endif
+
+
+#endif /* Profiler_h */
@@ -0,0 +1,571 @@
+//
+//  QueryServer.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "QueryServer.h"
+#include "MonthlyData.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of QueryServer class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Longest request line accepted from a client.
+static const unsigned long maxRequestLength = 64 * 1024;
+
+/**
+ *
+ * This function is private to this file. It formats a number in its shortest form
+ * which reads back exactly.
+ *
+ */
+static string formatNumber(double value) {
+	
+	char text[32];
+	to_chars_result written = to_chars(text, text + sizeof(text), value);
+	
+	return string(text, written.ptr);
+
+}
+
+/**
+ *
+ * This function is private to this file. It parses a positive count of a query.
+ *
+ * @param key: name of the parameter, for the error message.
+ * @param value: text of the count.
+ * @param minimum: smallest allowed count.
+ *
+ * return the count. It throws invalid_argument if the text is not such a count.
+ *
+ */
+static unsigned long parseCount(const string& key, const string& value, unsigned long minimum) {
+	
+	unsigned long count = 0;
+	from_chars_result parsed = from_chars(value.data(), value.data() + value.size(), count);
+	
+	if (value.empty() || parsed.ec != errc() || parsed.ptr != value.data() + value.size() || count < minimum) {
+		throw invalid_argument(key + " must be a number of at least " + to_string(minimum) + ": " + value);
+	}
+	
+	return count;
+
+}
+
+/**
+ *
+ * This function is private to this file. It sends a whole response, unless the
+ * client is gone.
+ *
+ * return false if the response can't be sent.
+ *
+ */
+static bool sendAll(int client, const string& response) {
+	
+	const char* next = response.data();
+	unsigned long left = response.size();
+	
+	while (left > 0) {
+		
+		ssize_t sent = send(client, next, left, MSG_NOSIGNAL);
+		
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		
+		next += sent;
+		left -= sent;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This is default constructor of a daemon listening on a socket path, which serves
+ * no panel until panels are added.
+ *
+ * @param path: path of the Unix domain socket.
+ *
+ */
+QueryServer::QueryServer(const string& path) {
+	
+	socketPath = path;
+	listenSocket = -1;
+	stopping = false;
+	numQueries = 0;
+	log = nullptr;
+
+}
+
+/**
+ *
+ * This is destructor, which closes the socket if it is still open.
+ *
+ */
+QueryServer::~QueryServer() {
+	
+	if (listenSocket >= 0) {
+		close(listenSocket);
+	}
+
+}
+
+/**
+ *
+ * This method is a mutator to serve a panel. Values to weight stocks by, e.g.
+ * market caps, are laid out like the panel once, so value weighted queries don't
+ * align them again.
+ *
+ * @param name: name of the panel in queries, e.g. its input file name.
+ * @param panel: the panel, already transposed or attached.
+ * @param values: panel of values matched to the panel by symbol and date, or null.
+ *
+ */
+void QueryServer::addPanel(const string& name, PanelData panel, const PanelData* values) {
+	
+	unique_ptr<ServedPanel> served(new ServedPanel());
+	served->name = name;
+	served->panel = move(panel);
+	served->hasWeights = (values != nullptr);
+	
+	if (values != nullptr) {
+		served->weights = values->alignTo(served->panel);
+	}
+	
+	panels.push_back(move(served));
+
+}
+
+/**
+ *
+ * This method is inspector for number of served panels.
+ *
+ */
+unsigned long QueryServer::getNumPanels() const {
+	
+	return panels.size();
+
+}
+
+/**
+ *
+ * This method creates the socket, replacing a socket file left by a former daemon,
+ * and accepts clients until a client shuts the daemon down. Each connection is
+ * served by one worker of the pool.
+ *
+ * @param numWorkers: number of workers, i.e. clients served at the same time.
+ * @param queryLog: stream every answered query is logged to.
+ *
+ * return false if the socket can't be created.
+ *
+ */
+bool QueryServer::run(unsigned long numWorkers, ostream& queryLog) {
+	
+	log = &queryLog;
+	
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	
+	if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+		return false;
+	}
+	memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+	
+	// Only a socket is replaced, never another kind of file.
+	struct stat status;
+	if (lstat(socketPath.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+		unlink(socketPath.c_str());
+	}
+	
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0) {
+		return false;
+	}
+	
+	if (::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, SOMAXCONN) != 0) {
+		close(listenSocket);
+		listenSocket = -1;
+		return false;
+	}
+	
+	{
+		ThreadPool pool(numWorkers);
+		
+		while (!stopping) {
+			
+			int client = accept(listenSocket, nullptr, nullptr);
+			
+			if (client < 0) {
+				if (!stopping && (errno == EINTR || errno == ECONNABORTED)) {
+					continue;
+				}
+				break;
+			}
+			
+			{
+				lock_guard<mutex> guard(clientLock);
+				if (stopping) {
+					close(client);
+					break;
+				}
+				clients.insert(client);
+			}
+			
+			pool.submit([this, client]() {
+				this->serveClient(client);
+			});
+		}
+		
+		stop();
+		pool.wait();
+	}
+	
+	close(listenSocket);
+	listenSocket = -1;
+	unlink(socketPath.c_str());
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method is private. It stops accepting clients, and shuts down connections
+ * of clients, so workers waiting for their requests return.
+ *
+ */
+void QueryServer::stop() {
+	
+	lock_guard<mutex> guard(clientLock);
+	
+	stopping = true;
+	
+	if (listenSocket >= 0) {
+		shutdown(listenSocket, SHUT_RDWR);
+	}
+	
+	for (const int& client : clients) {
+		shutdown(client, SHUT_RDWR);
+	}
+
+}
+
+/**
+ *
+ * This method is private. It reads requests of a client line by line and sends
+ * the answer of each, until the client quits or disconnects, or the daemon stops.
+ *
+ * @param client: descriptor of the connection, closed when it is done.
+ *
+ */
+void QueryServer::serveClient(int client) {
+	
+	string pending;
+	char buffer[4096];
+	bool closing = false;
+	
+	while (!closing) {
+		
+		ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+		
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			break;
+		}
+		
+		pending.append(buffer, received);
+		
+		unsigned long end;
+		while (!closing && (end = pending.find('\n')) != string::npos) {
+			
+			string request = pending.substr(0, end);
+			pending.erase(0, end + 1);
+			
+			if (!request.empty() && request.back() == '\r') {
+				request.pop_back();
+			}
+			
+			if (!sendAll(client, answer(request, closing))) {
+				closing = true;
+			}
+		}
+		
+		if (pending.size() > maxRequestLength) {
+			sendAll(client, "error request too long\n");
+			closing = true;
+		}
+	}
+	
+	// A shutdown request stops the daemon after its answer is sent.
+	if (stopping) {
+		stop();
+	}
+	
+	{
+		lock_guard<mutex> guard(clientLock);
+		clients.erase(client);
+	}
+	
+	close(client);
+
+}
+
+/**
+ *
+ * This method is private. It answers one request line.
+ *
+ * @param request: the line, without line break.
+ * @param closing: output parameter set to true if the connection is to be closed.
+ *
+ * return the response, ending with a line break.
+ *
+ */
+string QueryServer::answer(const string& request, bool& closing) {
+	
+	istringstream words(request);
+	vector<string> arguments;
+	string word;
+	while (words >> word) {
+		arguments.push_back(word);
+	}
+	
+	if (arguments.empty()) {
+		return "error empty request\n";
+	}
+	
+	const string& command = arguments.front();
+	
+	if (command == "panels") {
+		return listPanels();
+	} else if (command == "query") {
+		
+		try {
+			return query(arguments);
+		} catch (const exception& error) {
+			return string("error ") + error.what() + "\n";
+		}
+	
+	} else if (command == "quit") {
+		closing = true;
+		return "ok\n";
+	} else if (command == "shutdown") {
+		closing = true;
+		stopping = true;
+		return "ok\n";
+	}
+	
+	return "error unknown request: " + command + "\n";
+
+}
+
+/**
+ *
+ * This method is private. It answers a "panels" request.
+ *
+ * return "ok panels=<n>" and a line per panel.
+ *
+ */
+string QueryServer::listPanels() const {
+	
+	string response = "ok panels=" + to_string(panels.size()) + "\n";
+	
+	for (const unique_ptr<ServedPanel>& served : panels) {
+		
+		unsigned long numMonths = served->panel.getNumMonths();
+		
+		response += served->name + "," + to_string(served->panel.getNumSymbols()) + "," + to_string(numMonths);
+		response += "," + (numMonths > 0 ? served->panel.getDateLabel(0) : string());
+		response += "," + (numMonths > 0 ? served->panel.getDateLabel(numMonths - 1) : string());
+		response += served->hasWeights ? ",value\n" : ",equal\n";
+	}
+	
+	return response;
+
+}
+
+/**
+ *
+ * This method is private. It answers a "query" request: parameters are read, the
+ * formation months in the date range are found, and periods are calculated on
+ * the shared panel by this worker alone.
+ *
+ * @param arguments: words of the request, the first one being "query".
+ *
+ * return "ok ..." and a line per period. It throws invalid_argument for a wrong parameter.
+ *
+ */
+string QueryServer::query(const vector<string>& arguments) {
+	
+	auto start = chrono::steady_clock::now();
+	
+	if (panels.empty()) {
+		throw invalid_argument("no panel is served");
+	}
+	
+	ServedPanel* served = panels.front().get();
+	unsigned long numBuckets = 10, formation = 1, holding = 1, skip = 0;
+	CalendarDate from = 0, to = ~CalendarDate(0);
+	bool valueWeighted = false;
+	Strategy strategy;
+	
+	for (unsigned long i = 1; i < arguments.size(); i++) {
+		
+		unsigned long separator = arguments[i].find('=');
+		if (separator == string::npos) {
+			throw invalid_argument("expected key=value: " + arguments[i]);
+		}
+		
+		string key = arguments[i].substr(0, separator);
+		string value = arguments[i].substr(separator + 1);
+		
+		if (key == "panel") {
+			
+			served = nullptr;
+			for (const unique_ptr<ServedPanel>& candidate : panels) {
+				if (candidate->name == value) {
+					served = candidate.get();
+				}
+			}
+			
+			if (served == nullptr) {
+				throw invalid_argument("unknown panel: " + value);
+			}
+		
+		} else if (key == "buckets") {
+			numBuckets = parseCount(key, value, 1);
+		} else if (key == "formation") {
+			formation = parseCount(key, value, 1);
+		} else if (key == "holding") {
+			holding = parseCount(key, value, 1);
+		} else if (key == "skip") {
+			skip = parseCount(key, value, 0);
+		} else if (key == "from" || key == "to") {
+			
+			CalendarDate date;
+			if (!parseDate(value.data(), value.data() + value.size(), date)) {
+				throw invalid_argument("invalid date: " + value);
+			}
+			(key == "from" ? from : to) = date;
+		
+		} else if (key == "weighting") {
+			
+			if (value != "equal" && value != "value") {
+				throw invalid_argument("weighting must be equal or value: " + value);
+			}
+			valueWeighted = (value == "value");
+		
+		} else if (key == "strategy") {
+			
+			if (!parseDirection(value, strategy.direction)) {
+				throw invalid_argument("unknown strategy: " + value);
+			}
+		
+		} else if (key == "legs") {
+			
+			if (!parseLegs(value, strategy.legs)) {
+				throw invalid_argument("unknown legs: " + value);
+			}
+		
+		} else {
+			throw invalid_argument("unknown parameter: " + key);
+		}
+	}
+	
+	bool monthly = (formation == 1 && holding == 1 && skip == 0);
+	
+	if (valueWeighted && !served->hasWeights) {
+		throw invalid_argument("no values to weight stocks by were loaded for " + served->name);
+	}
+	if (valueWeighted && !monthly) {
+		throw invalid_argument("value weights need formation=1 holding=1 skip=0");
+	}
+	
+	// Formation months within the date range.
+	const Calendar& calendar = served->panel.getCalendar();
+	unsigned long first = calendar.size(), last = 0;
+	for (unsigned long m = 0; m < calendar.size(); m++) {
+		if (calendar.getDate(m) >= from && calendar.getDate(m) <= to) {
+			first = min(first, m);
+			last = m;
+		}
+	}
+	
+	vector<PeriodResult> results;
+	
+	if (first < calendar.size()) {
+		
+		if (monthly) {
+			
+			results = calculatePeriodRange(served->panel, first, last - first + 1, numBuckets, false, nullptr, valueWeighted ? &served->weights : nullptr, nullptr, strategy, nullptr);
+		
+		} else {
+			
+			call_once(served->sweepBuilt, [served]() {
+				served->sweep.reset(new ParameterSweep(served->panel, 10));
+			});
+			results = served->sweep->evaluate(numBuckets, formation, holding, skip, first, last, strategy);
+		
+		}
+	}
+	
+	// Total average is summed latest period first, as in "result.csv", and is 0 without any period.
+	double average = 0;
+	for (unsigned long m = results.size(); m-- > 0;) {
+		average += results[m].average;
+	}
+	if (!results.empty()) {
+		average /= static_cast<double>(results.size());
+	}
+	
+	string periods;
+	for (const PeriodResult& result : results) {
+		periods += result.date + "," + formatNumber(result.topAverage) + "," + formatNumber(result.bottomAverage) + "," + formatNumber(result.average) + "\n";
+	}
+	
+	chrono::duration<double, micro> latency = chrono::steady_clock::now() - start;
+	unsigned long micros = static_cast<unsigned long>(latency.count());
+	unsigned long queryId = ++numQueries;
+	
+	{
+		lock_guard<mutex> guard(logLock);
+		
+		*log << "query " << queryId << " on " << served->name << ":";
+		for (unsigned long i = 1; i < arguments.size(); i++) {
+			*log << " " << arguments[i];
+		}
+		*log << " -> " << results.size() << " periods in " << micros << " us" << endl;
+	}
+	
+	return "ok periods=" + to_string(results.size()) + " average=" + formatNumber(average) + " micros=" + to_string(micros) + "\n" + periods;
+
+}
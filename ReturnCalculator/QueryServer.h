@@ -0,0 +1,141 @@
+//
+//  QueryServer.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef QueryServer_h
+#define QueryServer_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <ostream>
+#include "PanelData.h"
+#include "ParameterSweep.h"
+#include "Strategy.h"
+
+using namespace std;
+
+/**
+ *
+ * Query server class header code:
+ *
+ * This header file defines the daemon which keeps panels in memory and answers
+ * strategy queries of local clients, so a question doesn't relaunch the program
+ * and parse its input file again.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class serves panels loaded once over a Unix domain socket, with a line based
+ * protocol. Every request is one line, and every response starts with a line of
+ * "ok ..." or "error <message>":
+ *
+ *	panels
+ *		"ok panels=<n>", then one "<name>,<symbols>,<months>,<first date>,<last date>,
+ *		<weights>" line per panel, where weights is "value" if values to weight stocks
+ *		by were loaded and "equal" otherwise.
+ *	query [panel=NAME] [buckets=N] [formation=J] [holding=K] [skip=S] [from=DATE]
+ *	      [to=DATE] [weighting=equal|value] [strategy=reversal|momentum]
+ *	      [legs=long-short|long|short]
+ *		"ok periods=<n> average=<total average> micros=<latency>", then one
+ *		"<date>,<top>,<bottom>,<average>" line per period. Defaults are the first
+ *		panel, 10 buckets, 1 x 1 months without skip, all formation months, equal
+ *		weights and the reversal long-short strategy. From and to limit formation
+ *		months by date, both included. A query without any period, e.g. dates past
+ *		the panel, is answered with "ok periods=0 average=0".
+ *	quit
+ *		"ok", then closes the connection.
+ *	shutdown
+ *		"ok", then stops the daemon and closes every connection.
+ *
+ * Panels are read-only while served, so clients are served by a pool of workers
+ *	at the same time without any lock. A worker serves one connection until the
+ *	client quits, and further clients wait for a free worker.
+ * A 1 x 1 query is calculated month by month as by the program itself, so its
+ *	results are the same as of "result.csv". Longer windows are evaluated by the
+ *	sweep engine, whose prefix sums of a panel are built by its first such query
+ *	and kept. Value weights are only supported by 1 x 1 queries.
+ * Numbers are written in their shortest exact form. Latency of every query is
+ *	reported to the client and logged.
+ *
+ */
+class QueryServer {
+
+private:
+	
+	// A panel served by the daemon, with aligned values to weight stocks by, and the
+	// sweep engine of the panel, once built.
+	struct ServedPanel {
+		string name;
+		PanelData panel;
+		PanelData weights;
+		bool hasWeights;
+		unique_ptr<ParameterSweep> sweep;
+		once_flag sweepBuilt;
+	};
+	
+	// Served panels, in order of loading.
+	vector<unique_ptr<ServedPanel>> panels;
+	
+	// Path and descriptor of the listening socket, -1 if not listening.
+	string socketPath;
+	int listenSocket;
+	
+	// Descriptors of connected clients, closed when the daemon stops.
+	set<int> clients;
+	mutex clientLock;
+	
+	// Whether the daemon is stopping, and number of queries answered.
+	atomic<bool> stopping;
+	atomic<unsigned long> numQueries;
+	
+	// Log of queries and its lock.
+	ostream* log;
+	mutex logLock;
+	
+	// The method serves requests of a connected client until it quits.
+	void serveClient(int client);
+	
+	// The method answers one request line, and tells whether to close the connection.
+	string answer(const string& request, bool& closing);
+	
+	// The methods answer "panels" and "query" requests.
+	string listPanels() const;
+	string query(const vector<string>& arguments);
+	
+	// The method stops accepting clients and closes connected ones.
+	void stop();
+
+public:
+	
+	// A default constructor of a daemon listening on a socket path, without any panel.
+	QueryServer(const string& path);
+	~QueryServer();
+	
+	QueryServer(const QueryServer&) = delete;
+	QueryServer& operator = (const QueryServer&) = delete;
+	
+	// The mutator to serve a panel under a name, weighted by values aligned to it if given.
+	void addPanel(const string& name, PanelData panel, const PanelData* values);
+	
+	// Inspector for number of served panels.
+	unsigned long getNumPanels() const;
+	
+	// The method listens and serves clients with N workers until shut down, returns false if the socket can't be created.
+	bool run(unsigned long numWorkers, ostream& queryLog);
+
+};
+
+
+#endif /* QueryServer_h */
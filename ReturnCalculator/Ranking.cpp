@@ -0,0 +1,355 @@
+//
+//  Ranking.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Ranking.h"
+
+#include <algorithm>
+#include <numeric>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of Ranking class, and the partition kernels used by selection.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This kernel is the partition step of selection. It appends IDs whose rate is
+ * beyond the threshold (above it if Top is true, otherwise below it) to selected,
+ * and IDs whose rate equals the threshold to tied. Both outputs must have room
+ * for size IDs. Stores are unconditional and output counters advance by the
+ * comparison result, so the loop has no data dependent branch.
+ *
+ * With SSE2 or AVX2, comparisons are done on 2 or 4 rates at once and turned
+ * into bit masks, otherwise the scalar loop is used. SSE2 is always available on
+ * x86-64, AVX2 is only compiled by "make AVX2=1".
+ *
+ * @param rates: return rates of candidates.
+ * @param ids: symbol IDs of candidates.
+ * @param size: number of candidates.
+ * @param threshold: the rate of k-th ranked candidate.
+ * @param selected: output IDs strictly beyond threshold.
+ * @param tied: output IDs equal to threshold.
+ * @param numSelected: output number of selected IDs.
+ * @param numTied: output number of tied IDs.
+ *
+ */
+template <bool Top>
+static void partitionKernel(const double* rates, const unsigned long* ids, unsigned long size, double threshold,
+							unsigned long* selected, unsigned long* tied,
+							unsigned long& numSelected, unsigned long& numTied) {
+	
+	unsigned long ns = 0, nt = 0;
+	unsigned long i = 0;
+
+#if defined(__AVX2__)
+	
+	const __m256d limit = _mm256_set1_pd(threshold);
+	for (; i + 4 <= size; i += 4) {
+		
+		__m256d value = _mm256_loadu_pd(rates + i);
+		int beyond = _mm256_movemask_pd(Top ? _mm256_cmp_pd(value, limit, _CMP_GT_OQ)
+											: _mm256_cmp_pd(value, limit, _CMP_LT_OQ));
+		int equal = _mm256_movemask_pd(_mm256_cmp_pd(value, limit, _CMP_EQ_OQ));
+		
+		for (int lane = 0; lane < 4; lane++) {
+			selected[ns] = ids[i + lane];
+			ns += (beyond >> lane) & 1;
+			tied[nt] = ids[i + lane];
+			nt += (equal >> lane) & 1;
+		}
+	
+	}
+
+#elif defined(__SSE2__)
+	
+	const __m128d limit = _mm_set1_pd(threshold);
+	for (; i + 2 <= size; i += 2) {
+		
+		__m128d value = _mm_loadu_pd(rates + i);
+		int beyond = _mm_movemask_pd(Top ? _mm_cmpgt_pd(value, limit) : _mm_cmplt_pd(value, limit));
+		int equal = _mm_movemask_pd(_mm_cmpeq_pd(value, limit));
+		
+		selected[ns] = ids[i];
+		ns += beyond & 1;
+		selected[ns] = ids[i + 1];
+		ns += (beyond >> 1) & 1;
+		
+		tied[nt] = ids[i];
+		nt += equal & 1;
+		tied[nt] = ids[i + 1];
+		nt += (equal >> 1) & 1;
+	
+	}
+
+#endif
+	
+	for (; i < size; i++) {
+		
+		double value = rates[i];
+		selected[ns] = ids[i];
+		ns += Top ? (value > threshold) : (value < threshold);
+		tied[nt] = ids[i];
+		nt += (value == threshold);
+	
+	}
+	
+	numSelected = ns;
+	numTied = nt;
+
+}
+
+/**
+ *
+ * This method sets candidates to all symbols of a panel column, where ID of a
+ * symbol is its index in the column.
+ *
+ * @param column: return rates indexed by symbol ID.
+ * @param size: number of symbols.
+ *
+ */
+void Ranking::assign(const double* column, unsigned long size) {
+	
+	ids.resize(size);
+	iota(ids.begin(), ids.end(), 0UL);
+	rates.assign(column, column + size);
+
+}
+
+/**
+ *
+ * This method sets candidates to given symbols of a panel column.
+ *
+ * @param column: return rates indexed by symbol ID.
+ * @param symbolIds: IDs of candidates in ascending order.
+ * @param size: number of candidates.
+ *
+ */
+void Ranking::assign(const double* column, const unsigned long* symbolIds, unsigned long size) {
+	
+	ids.assign(symbolIds, symbolIds + size);
+	rates.resize(size);
+	
+	for (unsigned long i = 0; i < size; i++) {
+		rates[i] = column[symbolIds[i]];
+	}
+
+}
+
+/**
+ *
+ * This method sets candidates to symbols of a panel column with a valid return
+ * rate. The mask is scanned a word at a time, and set bits are visited lowest
+ * first, so candidates stay in ascending ID order.
+ *
+ * @param column: return rates indexed by symbol ID.
+ * @param validMask: validity mask of the column, bit s % 64 of word s / 64 for symbol s.
+ * @param size: number of symbols of the column.
+ *
+ */
+void Ranking::assignValid(const double* column, const uint64_t* validMask, unsigned long size) {
+	
+	ids.clear();
+	rates.clear();
+	
+	for (unsigned long w = 0; w < (size + 63) / 64; w++) {
+		
+		for (uint64_t bits = validMask[w]; bits != 0; bits &= bits - 1) {
+			unsigned long id = w * 64 + __builtin_ctzll(bits);
+			ids.push_back(id);
+			rates.push_back(column[id]);
+		}
+	
+	}
+
+}
+
+/**
+ *
+ * This method is inspector to get number of candidates.
+ *
+ * return number of candidates.
+ *
+ */
+unsigned long Ranking::size() const {
+	
+	return ids.size();
+
+}
+
+/**
+ *
+ * This method is private. It finds the rate of k-th ranked candidate with
+ * nth_element(), partitions candidates against that threshold, and fills up
+ * the selection with tied candidates. Ties rank by ascending ID, so highest
+ * rates take tied candidates of lowest IDs, and lowest rates take those of
+ * highest IDs.
+ *
+ * @param k: number of candidates to be selected, no more than size().
+ * @param top: true to select highest rates, false to select lowest rates.
+ * @param selected: output IDs in ascending order.
+ *
+ */
+void Ranking::select(unsigned long k, bool top, vector<unsigned long>& selected) {
+	
+	unsigned long size = ids.size();
+	selected.clear();
+	
+	if (k == 0 || size == 0) {
+		return;
+	}
+	
+	k = min(k, size);
+	
+	// Threshold is k-th highest or k-th lowest rate.
+	scratch.assign(rates.begin(), rates.end());
+	unsigned long position = top ? size - k : k - 1;
+	nth_element(scratch.begin(), scratch.begin() + position, scratch.end());
+	double threshold = scratch[position];
+	
+	// Fewer than k candidates are strictly beyond threshold, and the rest are taken
+	// from ties. Both lists keep ascending ID order of candidates.
+	selected.resize(size);
+	ties.resize(size);
+	unsigned long numSelected = 0, numTied = 0;
+	
+	if (top) {
+		partitionKernel<true>(rates.data(), ids.data(), size, threshold,
+							  selected.data(), ties.data(), numSelected, numTied);
+	} else {
+		partitionKernel<false>(rates.data(), ids.data(), size, threshold,
+							   selected.data(), ties.data(), numSelected, numTied);
+	}
+	
+	unsigned long numTaken = min(k - numSelected, numTied);
+	unsigned long firstTaken = top ? 0 : numTied - numTaken;
+	selected.resize(numSelected);
+	selected.insert(selected.end(), ties.begin() + firstTaken, ties.begin() + firstTaken + numTaken);
+	inplace_merge(selected.begin(), selected.begin() + numSelected, selected.end());
+
+}
+
+/**
+ *
+ * This method selects k candidates with highest return rates.
+ *
+ * @param k: number of candidates to be selected.
+ * @param selected: output IDs in ascending order.
+ *
+ */
+void Ranking::selectTop(unsigned long k, vector<unsigned long>& selected) {
+	
+	select(k, true, selected);
+
+}
+
+/**
+ *
+ * This method selects k candidates with lowest return rates.
+ *
+ * @param k: number of candidates to be selected.
+ * @param selected: output IDs in ascending order.
+ *
+ */
+void Ranking::selectBottom(unsigned long k, vector<unsigned long>& selected) {
+	
+	select(k, false, selected);
+
+}
+
+/**
+ *
+ * This method ranks all candidates from highest to lowest return rate with a
+ * single sort, and cuts the ranking into buckets of sizes given by bucketSizes().
+ *
+ * @param numBuckets: number of buckets N, at least 1.
+ * @param buckets: output N lists of IDs, each in ascending order. Bucket 0 holds
+ *			highest return rates, and bucket N - 1 holds lowest ones.
+ *
+ */
+void Ranking::rankBuckets(unsigned long numBuckets, vector<vector<unsigned long>>& buckets) {
+	
+	unsigned long size = ids.size();
+	
+	order.resize(size);
+	iota(order.begin(), order.end(), 0UL);
+	
+	// Candidates are kept in ascending ID order, so comparing indices breaks ties by ID.
+	const double* candidateRates = rates.data();
+	std::sort(order.begin(), order.end(), [candidateRates](unsigned long a, unsigned long b) {
+		return candidateRates[a] > candidateRates[b] || (candidateRates[a] == candidateRates[b] && a < b);
+	});
+	
+	vector<unsigned long> sizes = bucketSizes(size, numBuckets);
+	buckets.resize(numBuckets);
+	
+	unsigned long rank = 0;
+	for (unsigned long b = 0; b < numBuckets; b++) {
+		
+		// With 2 buckets and odd number of stocks, the median stock is left out.
+		if (b == numBuckets - 1) {
+			rank = size - sizes[b];
+		}
+		
+		vector<unsigned long>& bucket = buckets[b];
+		bucket.clear();
+		for (unsigned long r = rank; r < rank + sizes[b]; r++) {
+			bucket.push_back(ids[order[r]]);
+		}
+		std::sort(bucket.begin(), bucket.end());
+		
+		rank += sizes[b];
+	}
+
+}
+
+/**
+ *
+ * This method calculates bucket sizes of N-quantile portfolios. The first and last
+ * buckets hold size / N stocks each, the same as top and bottom selections, and
+ * remaining stocks are spread as evenly as possible over interior buckets, earlier
+ * buckets taking one more stock when they cannot be equal.
+ *
+ * @param size: number of stocks in the universe.
+ * @param numBuckets: number of buckets N, at least 1.
+ *
+ * return a vector of N bucket sizes.
+ *
+ */
+vector<unsigned long> Ranking::bucketSizes(unsigned long size, unsigned long numBuckets) {
+	
+	vector<unsigned long> sizes(numBuckets, 0);
+	
+	if (numBuckets == 1) {
+		sizes[0] = size;
+		return sizes;
+	}
+	
+	unsigned long extremeSize = size / numBuckets;
+	sizes[0] = extremeSize;
+	sizes[numBuckets - 1] = extremeSize;
+	
+	unsigned long numInterior = numBuckets - 2;
+	unsigned long interiorStocks = size - 2 * extremeSize;
+	
+	for (unsigned long b = 1; b + 1 < numBuckets; b++) {
+		sizes[b] = interiorStocks / numInterior + (b - 1 < interiorStocks % numInterior ? 1 : 0);
+	}
+	
+	return sizes;
+
+}
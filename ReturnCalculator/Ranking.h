@@ -0,0 +1,89 @@
+//
+//  Ranking.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Ranking_h
+#define Ranking_h
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ *
+ * Ranking class header code:
+ *
+ * This header file defines the selection engine which picks stocks with the
+ * highest or lowest return rates of a month.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps candidate stocks of a month as (symbol ID, return rate) pairs,
+ * stored as two parallel contiguous arrays so return rates can be compared with
+ * SIMD instructions.
+ *
+ * Stocks are ranked by return rate from highest to lowest, and stocks with equal
+ *	rates are ranked by ascending ID, i.e. the order of input file, so results do
+ *	not depend on memory layout.
+ * Selection of the highest or lowest k stocks runs in linear time: nth_element()
+ *	on a copy of return rates finds the threshold rate, then one partition pass
+ *	collects IDs beyond the threshold and IDs equal to it.
+ * Bucket ranking sorts all candidates once and cuts the ranking into N buckets.
+ * Selected IDs are returned in ascending order. Buffers are reused across calls.
+ *
+ */
+class Ranking {
+
+private:
+	
+	// Candidate symbol IDs and their return rates, parallel to each other.
+	vector<unsigned long> ids;
+	vector<double> rates;
+	
+	// Working buffers of selection: a copy of rates for nth_element(), and IDs
+	// tied at the threshold.
+	vector<double> scratch;
+	vector<unsigned long> ties;
+	
+	// Working buffer of bucket ranking: candidate indices in ranked order.
+	vector<unsigned long> order;
+	
+	// The method selects k IDs with highest rates if top is true, otherwise lowest.
+	void select(unsigned long k, bool top, vector<unsigned long>& selected);
+
+public:
+	
+	// Mutators to set candidates: all symbols of a panel column, given symbols, or
+	// symbols whose bits are set in a validity mask.
+	void assign(const double* column, unsigned long size);
+	void assign(const double* column, const unsigned long* symbolIds, unsigned long size);
+	void assignValid(const double* column, const uint64_t* validMask, unsigned long size);
+	
+	// Inspector for number of candidates.
+	unsigned long size() const;
+	
+	// The methods select k stocks with highest or lowest return rates.
+	void selectTop(unsigned long k, vector<unsigned long>& selected);
+	void selectBottom(unsigned long k, vector<unsigned long>& selected);
+	
+	// The method ranks all candidates once and splits them into N buckets,
+	// bucket 0 has highest return rates.
+	void rankBuckets(unsigned long numBuckets, vector<vector<unsigned long>>& buckets);
+	
+	// Number of stocks in each of N buckets for a universe of given size.
+	static vector<unsigned long> bucketSizes(unsigned long size, unsigned long numBuckets);
+
+};
+
+
+#endif /* Ranking_h */
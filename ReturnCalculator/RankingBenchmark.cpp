@@ -0,0 +1,178 @@
+//
+//  RankingBenchmark.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "Ranking.h"
+
+using namespace std;
+
+/**
+ *
+ * This file contains a micro-benchmark which compares the selection engine of
+ * Ranking class against the heap based selection it replaced in MonthlyData::sort().
+ *
+ * For each universe size, random return rates are generated, top and bottom ten
+ * percent are selected by both methods repeatedly, and average time per stock
+ * is reported. Selected stocks of both methods are checked to be identical.
+ *
+ * Usage: rankBench
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This struct is pair of company symbol ID and monthly return rate, as kept
+ * in heaps of the former MonthlyData::sort().
+ *
+ */
+struct DataSample {
+	
+	unsigned long symbolId;
+	double returnRate;
+	
+	DataSample(const unsigned long& id, const double& rate) :
+	symbolId(id), returnRate(rate) {}
+
+};
+
+// Comparators of the former max heap and min heap.
+struct maxHeapComparator {
+	bool operator () (const DataSample& smaller, const DataSample& larger) const {
+		return smaller.returnRate < larger.returnRate;
+	}
+};
+
+struct minHeapComparator {
+	bool operator () (const DataSample& smaller, const DataSample& larger) const {
+		return larger.returnRate < smaller.returnRate;
+	}
+};
+
+
+/**
+ *
+ * This function is the former heap based selection: a bounded min heap and max
+ * heap are maintained while iterating all stocks, and then popped one by one.
+ *
+ * @param column: return rates indexed by symbol ID.
+ * @param size: number of stocks.
+ * @param top: output IDs of top ten percent stocks.
+ * @param bottom: output IDs of bottom ten percent stocks.
+ *
+ */
+void heapSelect(const double* column, unsigned long size, vector<unsigned long>& top, vector<unsigned long>& bottom) {
+	
+	unsigned long tenPercentSize = size / 10;
+	priority_queue<DataSample, vector<DataSample>, minHeapComparator> topTenPercent;
+	priority_queue<DataSample, vector<DataSample>, maxHeapComparator> bottomTenPercent;
+	
+	for (unsigned long id = 0; id < size; id++) {
+		
+		DataSample sample(id, column[id]);
+		
+		if (topTenPercent.size() < tenPercentSize) {
+			topTenPercent.push(sample);
+		} else if (sample.returnRate >= topTenPercent.top().returnRate) {
+			topTenPercent.pop();
+			topTenPercent.push(sample);
+		}
+		
+		if (bottomTenPercent.size() < tenPercentSize) {
+			bottomTenPercent.push(sample);
+		} else if (sample.returnRate <= bottomTenPercent.top().returnRate) {
+			bottomTenPercent.pop();
+			bottomTenPercent.push(sample);
+		}
+	}
+	
+	top.clear();
+	while (!topTenPercent.empty()) {
+		top.push_back(topTenPercent.top().symbolId);
+		topTenPercent.pop();
+	}
+	
+	bottom.clear();
+	while (!bottomTenPercent.empty()) {
+		bottom.push_back(bottomTenPercent.top().symbolId);
+		bottomTenPercent.pop();
+	}
+
+}
+
+
+// Main entry point of the benchmark.
+int main() {
+	
+	const unsigned long sizes[] = {50, 500, 5000, 20000, 50000, 100000};
+	
+	// Roughly the same number of stocks are processed for every size.
+	const unsigned long stocksPerSize = 20000000;
+	
+	mt19937_64 generator(2016);
+	normal_distribution<double> distribution(0.01, 0.1);
+	
+	cout << setw(10) << "stocks" << setw(12) << "repeats";
+	cout << setw(16) << "heap ns/stock" << setw(16) << "select ns/stock";
+	cout << setw(10) << "speedup" << endl;
+	
+	bool allMatched = true;
+	
+	for (unsigned long size : sizes) {
+		
+		vector<double> column(size);
+		for (double& rate : column) {
+			rate = distribution(generator);
+		}
+		
+		unsigned long repeats = max(1UL, stocksPerSize / size);
+		vector<unsigned long> heapTop, heapBottom, selectTop, selectBottom;
+		
+		auto heapStart = chrono::steady_clock::now();
+		for (unsigned long r = 0; r < repeats; r++) {
+			heapSelect(column.data(), size, heapTop, heapBottom);
+		}
+		chrono::duration<double, nano> heapTime = chrono::steady_clock::now() - heapStart;
+		
+		Ranking ranking;
+		auto selectStart = chrono::steady_clock::now();
+		for (unsigned long r = 0; r < repeats; r++) {
+			ranking.assign(column.data(), size);
+			ranking.selectTop(size / 10, selectTop);
+			ranking.selectBottom(size / 10, selectBottom);
+		}
+		chrono::duration<double, nano> selectTime = chrono::steady_clock::now() - selectStart;
+		
+		// Random rates have no ties, so both methods must pick the same stocks.
+		std::sort(heapTop.begin(), heapTop.end());
+		std::sort(heapBottom.begin(), heapBottom.end());
+		bool matched = (heapTop == selectTop && heapBottom == selectBottom);
+		allMatched = allMatched && matched;
+		
+		double heapPerStock = heapTime.count() / (repeats * size);
+		double selectPerStock = selectTime.count() / (repeats * size);
+		
+		cout << setw(10) << size << setw(12) << repeats;
+		cout << fixed << setprecision(2);
+		cout << setw(16) << heapPerStock << setw(16) << selectPerStock;
+		cout << setw(9) << heapPerStock / selectPerStock << "x";
+		cout << (matched ? "" : "  MISMATCH") << endl;
+		cout.unsetf(ios::fixed);
+	
+	}
+	
+	return allMatched ? 0 : 1;
+}
@@ -0,0 +1,598 @@
+//
+//  Resampling.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Resampling.h"
+#include "Hashing.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of Resampling class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Number of replications handed to a thread at a time.
+static const unsigned long replicationsPerTask = 64;
+
+// Identifiers of the tests, mixed into random streams so they never share numbers.
+static const uint64_t bootstrapStream = 1;
+static const uint64_t permutationStream = 2;
+
+
+/**
+ *
+ * This helper is a counter based random number generator. The i-th number of a
+ * stream is the hash of the stream key plus i times an odd constant, as in
+ * SplitMix64, so any replication can be generated without the ones before it.
+ *
+ */
+struct CounterStream {
+	
+	uint64_t key;
+	uint64_t counter;
+	
+	CounterStream(uint64_t seed, uint64_t test, uint64_t replication) {
+		key = hashWord(hashWord(seed ^ (test << 56)) + replication);
+		counter = 0;
+	}
+	
+	uint64_t next() {
+		return hashWord(key + ++counter * 0x9E3779B97F4A7C15ULL);
+	}
+	
+	// A number in [0, n), by multiplying instead of dividing.
+	unsigned long below(unsigned long n) {
+		return static_cast<unsigned long>((static_cast<unsigned __int128>(next()) * n) >> 64);
+	}
+
+};
+
+
+/**
+ *
+ * This helper gets a quantile of numbers by linear interpolation between order
+ * statistics. NaN values are left out.
+ *
+ * @param values: the numbers.
+ * @param probability: probability of the quantile, between 0 and 1.
+ *
+ * return the quantile, or NaN if there is no number.
+ *
+ */
+static double quantile(const vector<double>& values, double probability) {
+	
+	vector<double> sorted;
+	sorted.reserve(values.size());
+	for (const double& value : values) {
+		if (!isnan(value)) {
+			sorted.push_back(value);
+		}
+	}
+	
+	if (sorted.empty()) {
+		return NAN;
+	}
+	
+	sort(sorted.begin(), sorted.end());
+	
+	double position = probability * static_cast<double>(sorted.size() - 1);
+	unsigned long below = static_cast<unsigned long>(floor(position));
+	unsigned long above = min(below + 1, static_cast<unsigned long>(sorted.size() - 1));
+	
+	return sorted[below] + (position - static_cast<double>(below)) * (sorted[above] - sorted[below]);
+
+}
+
+/**
+ *
+ * This helper gets the share of replications at least as far from center as the
+ * observed average is from zero, counting the observation itself once, so it is
+ * never 0.
+ *
+ * return the p-value, or NaN without replications.
+ *
+ */
+static double pValue(const vector<double>& averages, double center, double observed) {
+	
+	if (averages.empty()) {
+		return NAN;
+	}
+	
+	unsigned long extreme = 0;
+	for (const double& average : averages) {
+		if (fabs(average - center) >= fabs(observed)) {
+			extreme++;
+		}
+	}
+	
+	return (extreme + 1.0) / (averages.size() + 1.0);
+
+}
+
+/**
+ *
+ * This is default constructor keeping return of every period. By default, block
+ * length is chosen by number of periods, confidence level is 95% and seed is 1.
+ *
+ * @param p: the panel which results were calculated from, already transposed.
+ * @param buckets: number of buckets N, top and bottom buckets hold 1/N of stocks.
+ * @param results: results of every period of the panel, in chronological order.
+ *
+ */
+Resampling::Resampling(const PanelData& p, unsigned long buckets, const vector<PeriodResult>& results) {
+	
+	panel = &p;
+	numBuckets = buckets;
+	
+	observedAverage = 0;
+	for (const PeriodResult& result : results) {
+		periodReturns.push_back(result.average);
+		observedAverage += result.average;
+	}
+	observedAverage /= static_cast<double>(results.size());
+	
+	// Stocks ranked in every period, i.e. those with a return rate in its first month.
+	periodStocks.resize(results.size());
+	for (unsigned long m = 0; m < results.size(); m++) {
+		
+		const uint64_t* mask = panel->getValidMask(m);
+		for (unsigned long w = 0; w < panel->getMaskWords(); w++) {
+			for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+				periodStocks[m].push_back(static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits)));
+			}
+		}
+	
+	}
+	
+	blockLength = 0;
+	confidenceLevel = 0.95;
+	seed = 1;
+	weights = nullptr;
+	
+	bootstrapSeconds = 0;
+	permutationSeconds = 0;
+
+}
+
+/**
+ *
+ * This method is a mutator to weight stocks of permuted buckets by value, the same
+ * as the observed results.
+ *
+ * @param w: panel of values aligned with the panel, or null for equal weights.
+ *
+ */
+void Resampling::setWeights(const PanelData* w) {
+	
+	weights = w;
+
+}
+
+/**
+ *
+ * This method is a mutator to set number of consecutive periods in a bootstrap block.
+ *
+ * @param length: block length, or 0 for cube root of number of periods.
+ *
+ */
+void Resampling::setBlockLength(unsigned long length) {
+	
+	blockLength = length;
+
+}
+
+/**
+ *
+ * This method is a mutator to set confidence level of bootstrap interval.
+ *
+ * @param level: confidence level between 0 and 1, e.g. 0.95.
+ *
+ */
+void Resampling::setConfidenceLevel(double level) {
+	
+	confidenceLevel = level;
+
+}
+
+/**
+ *
+ * This method is a mutator to set seed of random numbers.
+ *
+ * @param s: the seed.
+ *
+ */
+void Resampling::setSeed(uint64_t s) {
+	
+	seed = s;
+
+}
+
+/**
+ *
+ * This method is private. It runs circular block bootstrap replications: blocks of
+ * consecutive periods start at random periods, wrap around after latest period,
+ * and are drawn until there are as many periods as observed.
+ *
+ * @param first: first replication.
+ * @param last: replication after the last one.
+ *
+ */
+void Resampling::bootstrapRange(unsigned long first, unsigned long last) {
+	
+	unsigned long numPeriods = periodReturns.size();
+	unsigned long length = getBlockLength();
+	
+	for (unsigned long r = first; r < last; r++) {
+		
+		CounterStream stream(seed, bootstrapStream, r);
+		double sum = 0;
+		
+		for (unsigned long drawn = 0; drawn < numPeriods; ) {
+			
+			unsigned long start = stream.below(numPeriods);
+			for (unsigned long i = 0; i < length && drawn < numPeriods; i++, drawn++) {
+				sum += periodReturns[(start + i) % numPeriods];
+			}
+		
+		}
+		
+		bootstrapAverages[r] = sum / static_cast<double>(numPeriods);
+	}
+
+}
+
+/**
+ *
+ * This method is private. It runs permutation replications. In every period, the
+ * first 2N draws of a Fisher-Yates shuffle of stocks ranked in that period pick
+ * top and bottom buckets, then the swaps are undone, so the next replication
+ * starts from the same order whichever replications ran before on this thread.
+ * As in the observed results, stocks missing next month are left out of averages,
+ * which are weighted by value if weights are given.
+ *
+ * @param first: first replication.
+ * @param last: replication after the last one.
+ *
+ */
+void Resampling::permuteRange(unsigned long first, unsigned long last) {
+	
+	unsigned long numPeriods = periodReturns.size();
+	
+	// Each thread shuffles its own copy of the stocks of every period.
+	vector<vector<uint32_t>> order = periodStocks;
+	vector<unsigned long> swaps;
+	
+	for (unsigned long r = first; r < last; r++) {
+		
+		CounterStream stream(seed, permutationStream, r);
+		double sum = 0;
+		
+		for (unsigned long m = 0; m < numPeriods; m++) {
+			
+			vector<uint32_t>& stocks = order[m];
+			unsigned long numStocks = stocks.size();
+			unsigned long bucketSize = numStocks / numBuckets;
+			
+			double topSum = 0, bottomSum = 0, topWeight = 0, bottomWeight = 0, rate, weight;
+			
+			if (2 * bucketSize <= numStocks) {
+				
+				swaps.resize(2 * bucketSize);
+				for (unsigned long i = 0; i < 2 * bucketSize; i++) {
+					swaps[i] = i + stream.below(numStocks - i);
+					swap(stocks[i], stocks[swaps[i]]);
+				}
+				
+				for (unsigned long i = 0; i < bucketSize; i++) {
+					if (nextReturn(m, stocks[i], rate, weight)) {
+						topSum += rate * weight;
+						topWeight += weight;
+					}
+					if (nextReturn(m, stocks[bucketSize + i], rate, weight)) {
+						bottomSum += rate * weight;
+						bottomWeight += weight;
+					}
+				}
+				
+				for (unsigned long i = 2 * bucketSize; i > 0; i--) {
+					swap(stocks[i - 1], stocks[swaps[i - 1]]);
+				}
+			
+			} else {
+				
+				// With a single bucket, top and bottom buckets both hold every stock.
+				for (const uint32_t& id : stocks) {
+					if (nextReturn(m, id, rate, weight)) {
+						topSum += rate * weight;
+						topWeight += weight;
+					}
+				}
+				bottomSum = topSum;
+				bottomWeight = topWeight;
+			
+			}
+			
+			sum += bottomSum / bottomWeight - topSum / topWeight;
+		}
+		
+		permutationAverages[r] = sum / static_cast<double>(numPeriods);
+	}
+
+}
+
+/**
+ *
+ * This method is private. It reads next month's return rate of a stock ranked in
+ * a period, and its weight in formation month. Weights are 1 unless value weighted.
+ *
+ * @param period: index of the period, i.e. of its formation month.
+ * @param symbolId: ID of the stock.
+ * @param rate: output parameter receiving the return rate, if it is valid.
+ * @param weight: output parameter receiving the weight, if it is valid.
+ *
+ * return false if the return rate is missing, or the stock has no positive weight.
+ *
+ */
+bool Resampling::nextReturn(unsigned long period, unsigned long symbolId, double& rate, double& weight) const {
+	
+	if (!panel->isValid(symbolId, period + 1)) {
+		return false;
+	}
+	
+	rate = panel->getMonthColumn(period + 1)[symbolId];
+	weight = 1;
+	
+	if (weights != nullptr) {
+		if (!weights->isValid(symbolId, period)) {
+			return false;
+		}
+		weight = weights->getMonthColumn(period)[symbolId];
+	}
+	
+	return weight > 0;
+
+}
+
+/**
+ *
+ * This method is private. It splits replications into tasks of a fixed size, so
+ * every thread keeps its own scratch memory for many replications.
+ *
+ * @param count: number of replications.
+ * @param permutation: true for permutation test, false for bootstrap.
+ * @param pool: thread pool to run tasks on, or null to run serially.
+ *
+ */
+void Resampling::runReplications(unsigned long count, bool permutation, ThreadPool* pool) {
+	
+	auto runTask = [this, count, permutation](unsigned long task) {
+		
+		unsigned long first = task * replicationsPerTask;
+		unsigned long last = min(count, first + replicationsPerTask);
+		
+		if (permutation) {
+			permuteRange(first, last);
+		} else {
+			bootstrapRange(first, last);
+		}
+	};
+	
+	unsigned long numTasks = (count + replicationsPerTask - 1) / replicationsPerTask;
+	
+	if (pool != nullptr) {
+		pool->parallelFor(numTasks, runTask);
+	} else {
+		for (unsigned long task = 0; task < numTasks; task++) {
+			runTask(task);
+		}
+	}
+
+}
+
+/**
+ *
+ * This method runs block bootstrap replications, replacing former ones.
+ *
+ * @param count: number of replications.
+ * @param pool: thread pool to run replications on, or null to run serially.
+ *
+ */
+void Resampling::bootstrap(unsigned long count, ThreadPool* pool) {
+	
+	PROFILE_STAGE(RESAMPLE);
+	
+	auto start = chrono::steady_clock::now();
+	
+	bootstrapAverages.assign(periodReturns.empty() ? 0 : count, NAN);
+	runReplications(bootstrapAverages.size(), false, pool);
+	
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	bootstrapSeconds = elapsed.count();
+
+}
+
+/**
+ *
+ * This method runs permutation replications, replacing former ones.
+ *
+ * @param count: number of replications.
+ * @param pool: thread pool to run replications on, or null to run serially.
+ *
+ */
+void Resampling::permute(unsigned long count, ThreadPool* pool) {
+	
+	PROFILE_STAGE(RESAMPLE);
+	
+	auto start = chrono::steady_clock::now();
+	
+	permutationAverages.assign(periodReturns.empty() ? 0 : count, NAN);
+	runReplications(permutationAverages.size(), true, pool);
+	
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	permutationSeconds = elapsed.count();
+
+}
+
+/**
+ *
+ * This method is inspector to get block length of bootstrap.
+ *
+ * return block length set by setBlockLength(), or the cube root of number of
+ * periods rounded up if it is 0.
+ *
+ */
+unsigned long Resampling::getBlockLength() const {
+	
+	if (blockLength > 0) {
+		return blockLength;
+	}
+	
+	return max(1UL, static_cast<unsigned long>(ceil(cbrt(static_cast<double>(periodReturns.size())))));
+
+}
+
+/**
+ *
+ * This method is inspector to get seconds spent on bootstrap replications.
+ *
+ * return wall-clock seconds of last call to bootstrap().
+ *
+ */
+double Resampling::getBootstrapSeconds() const {
+	
+	return bootstrapSeconds;
+
+}
+
+/**
+ *
+ * This method is inspector to get seconds spent on permutation replications.
+ *
+ * return wall-clock seconds of last call to permute().
+ *
+ */
+double Resampling::getPermutationSeconds() const {
+	
+	return permutationSeconds;
+
+}
+
+/**
+ *
+ * This method gets percentile confidence interval of total average return from
+ * bootstrap replications.
+ *
+ * @param lower: receives lower bound, or NaN without replications.
+ * @param upper: receives upper bound, or NaN without replications.
+ *
+ */
+void Resampling::getConfidenceInterval(double& lower, double& upper) const {
+	
+	lower = quantile(bootstrapAverages, (1 - confidenceLevel) / 2);
+	upper = quantile(bootstrapAverages, (1 + confidenceLevel) / 2);
+
+}
+
+/**
+ *
+ * This method gets two-sided p-value of total average return against zero from
+ * bootstrap replications, which are centered at the observed average.
+ *
+ * return the p-value, or NaN without replications.
+ *
+ */
+double Resampling::getBootstrapPValue() const {
+	
+	return pValue(bootstrapAverages, observedAverage, observedAverage);
+
+}
+
+/**
+ *
+ * This method gets two-sided p-value of total average return from permutation
+ * replications.
+ *
+ * return the p-value, or NaN without replications.
+ *
+ */
+double Resampling::getPermutationPValue() const {
+	
+	return pValue(permutationAverages, 0, observedAverage);
+
+}
+
+/**
+ *
+ * This method appends rows of both tests after results written by writeResults(),
+ * following an empty row. A test without replications has no rows.
+ *
+ * @param writer: the writer of output file. This method does not check if it is
+ *			opened, please check in main function.
+ * @param numColumns: number of cells per row, including the name of the row.
+ *
+ */
+void Resampling::writeCsv(ResultWriter& writer, unsigned long numColumns) const {
+	
+	if (bootstrapAverages.empty() && permutationAverages.empty()) {
+		return;
+	}
+	
+	// Ends a row of the given number of cells with empty ones.
+	auto endRow = [&writer, numColumns](unsigned long cells) {
+		for (unsigned long i = cells; i < numColumns; i++) {
+			writer.append(',');
+		}
+		writer.append('\n');
+	};
+	
+	endRow(1);
+	
+	if (!bootstrapAverages.empty()) {
+		
+		double lower, upper;
+		getConfidenceInterval(lower, upper);
+		
+		writer.append("Bootstrap ");
+		writer.appendNumber(confidenceLevel * 100);
+		writer.append("% confidence interval of total average return (");
+		writer.appendNumber(static_cast<unsigned long>(bootstrapAverages.size()));
+		writer.append(" replications; block length ");
+		writer.appendNumber(getBlockLength());
+		writer.append("),");
+		writer.appendNumber(lower);
+		writer.append(',');
+		writer.appendNumber(upper);
+		endRow(3);
+		
+		writer.append("Bootstrap p-value of total average return,");
+		writer.appendNumber(getBootstrapPValue());
+		endRow(2);
+	
+	}
+	
+	if (!permutationAverages.empty()) {
+		
+		writer.append("Permutation p-value of total average return (");
+		writer.appendNumber(static_cast<unsigned long>(permutationAverages.size()));
+		writer.append(" replications),");
+		writer.appendNumber(getPermutationPValue());
+		endRow(2);
+	
+	}
+
+}
@@ -0,0 +1,122 @@
+//
+//  Resampling.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Resampling_h
+#define Resampling_h
+
+#include <cstdint>
+#include <vector>
+#include "PanelData.h"
+#include "MonthlyData.h"
+#include "ThreadPool.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+/**
+ *
+ * Resampling class header code:
+ *
+ * This header file defines the significance test of total average return of all
+ * periods, by block bootstrap and by cross-sectional permutation.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class estimates how likely total average return of all periods is to come
+ * from chance.
+ *
+ * Block bootstrap draws blocks of consecutive periods with replacement, so serial
+ *	correlation of period returns is kept, and gives a percentile confidence
+ *	interval of total average return and a p-value against zero return.
+ * Permutation test shuffles next month's return rates across stocks of every
+ *	period, i.e. draws top and bottom buckets as random disjoint sets of the same
+ *	sizes among stocks ranked in the period. Next month's return rates are read
+ *	from the panel already in memory, so a replication neither parses nor ranks
+ *	again. Its p-value is the share of replications at least as far from zero as
+ *	the observed return.
+ * Every replication has its own stream of random numbers, made by hashing seed,
+ *	replication number and a counter, so results do not depend on number of
+ *	threads or on order of replications.
+ *
+ */
+class Resampling {
+
+private:
+	
+	// The panel providing return rates, and number of buckets.
+	const PanelData* panel;
+	unsigned long numBuckets;
+	
+	// Period returns in chronological order, and their average.
+	vector<double> periodReturns;
+	double observedAverage;
+	
+	// Panel of values to weight stocks by, or null for equal weights.
+	const PanelData* weights;
+	
+	// IDs of stocks ranked in every period, in ascending order.
+	vector<vector<uint32_t>> periodStocks;
+	
+	// Settings.
+	unsigned long blockLength;
+	double confidenceLevel;
+	uint64_t seed;
+	
+	// Averages of every replication.
+	vector<double> bootstrapAverages;
+	vector<double> permutationAverages;
+	
+	// Wall-clock seconds spent on replications.
+	double bootstrapSeconds;
+	double permutationSeconds;
+	
+	// The method runs replications [first, last) of one test.
+	void bootstrapRange(unsigned long first, unsigned long last);
+	void permuteRange(unsigned long first, unsigned long last);
+	
+	// The method reads next month's return rate and weight of a stock, returns false if either is missing.
+	bool nextReturn(unsigned long period, unsigned long symbolId, double& rate, double& weight) const;
+	
+	// The method runs count replications of a test on a thread pool, or serially.
+	void runReplications(unsigned long count, bool permutation, ThreadPool* pool);
+
+public:
+	
+	// A default constructor specifying panel, number of buckets and results of the panel.
+	Resampling(const PanelData& p, unsigned long buckets, const vector<PeriodResult>& results);
+	
+	// Mutators of settings. Block length 0 selects cube root of number of periods.
+	void setWeights(const PanelData* w);
+	void setBlockLength(unsigned long length);
+	void setConfidenceLevel(double level);
+	void setSeed(uint64_t s);
+	
+	// The methods run replications of each test.
+	void bootstrap(unsigned long count, ThreadPool* pool);
+	void permute(unsigned long count, ThreadPool* pool);
+	
+	// Inspectors of results.
+	unsigned long getBlockLength() const;
+	double getBootstrapSeconds() const;
+	double getPermutationSeconds() const;
+	void getConfidenceInterval(double& lower, double& upper) const;
+	double getBootstrapPValue() const;
+	double getPermutationPValue() const;
+	
+	// The method appends results of both tests to "result.csv", in rows of numColumns cells.
+	void writeCsv(ResultWriter& writer, unsigned long numColumns) const;
+
+};
+
+
+#endif /* Resampling_h */
@@ -0,0 +1,524 @@
+//
+//  ResultCache.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "ResultCache.h"
+#include "Profiler.h"
+#include "MappedFile.h"
+#include "Hashing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of ResultCache class.
+ *
+ * After the header, a results file holds for every period: length and bytes of
+ * its date, top, bottom and total averages, top and bottom turnover, then number
+ * of buckets followed by their averages, stock counts and turnovers. A ranking file
+ * holds for every period: number of buckets, then for every bucket its number of
+ * stocks followed by their symbol IDs. Every number takes 8 bytes.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Magic numbers of both kinds of files, and version of their layout.
+static const char resultsMagic[8] = {'R', 'C', 'R', 'E', 'S', 'U', 'L', 'T'};
+static const char rankingMagic[8] = {'R', 'C', 'R', 'A', 'N', 'K', 'E', 'D'};
+static const uint64_t resultCacheVersion = 1;
+
+/**
+ *
+ * These helpers append an 8 byte word or number to the contents of a file.
+ *
+ */
+static void putWord(string& buffer, uint64_t word) {
+	
+	buffer.append(reinterpret_cast<const char*>(&word), sizeof(word));
+
+}
+
+static void putNumber(string& buffer, double value) {
+	
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+
+}
+
+/**
+ *
+ * These helpers read an 8 byte word or number at cur, and move cur past it.
+ *
+ * return false if the file ends before it.
+ *
+ */
+static bool getWord(const char*& cur, const char* end, uint64_t& word) {
+	
+	if (static_cast<unsigned long>(end - cur) < sizeof(word)) {
+		return false;
+	}
+	
+	memcpy(&word, cur, sizeof(word));
+	cur += sizeof(word);
+	
+	return true;
+
+}
+
+static bool getNumber(const char*& cur, const char* end, double& value) {
+	
+	if (static_cast<unsigned long>(end - cur) < sizeof(value)) {
+		return false;
+	}
+	
+	memcpy(&value, cur, sizeof(value));
+	cur += sizeof(value);
+	
+	return true;
+
+}
+
+/**
+ *
+ * This helper computes content hash of a file, 0 for no file.
+ *
+ * @param fileName: name of the file, empty if the option is not used.
+ * @param hash: output parameter receiving the hash.
+ *
+ * return false if the file is given but can't be read.
+ *
+ */
+static bool hashFile(const string& fileName, uint64_t& hash) {
+	
+	hash = 0;
+	
+	if (fileName.empty()) {
+		return true;
+	}
+	
+	MappedFile file(fileName);
+	if (!file.isOpen()) {
+		return false;
+	}
+	
+	hash = hashBytes(file.getData(), file.getSize());
+	
+	return true;
+
+}
+
+/**
+ *
+ * This helper writes a cache file under a temporary name of this process, then
+ * renames it, so a file of the cache is always complete, even if runs save the
+ * same file at once.
+ *
+ * return false on failure.
+ *
+ */
+static bool replaceFile(const string& fileName, const ResultCacheHeader& header, const string& contents) {
+	
+	string tempName = fileName + ".tmp." + to_string(getpid());
+	ofstream output(tempName, ios::binary | ios::trunc);
+	
+	if (!output.is_open()) {
+		return false;
+	}
+	
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(contents.data(), contents.size());
+	output.close();
+	
+	if (!output || rename(tempName.c_str(), fileName.c_str()) != 0) {
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This helper maps a cache file and checks its header.
+ *
+ * @param file: the mapped file.
+ * @param magic: magic number of its kind.
+ * @param key: key it is named after.
+ * @param numPeriods: output parameter receiving number of periods.
+ *
+ * return false if the file is missing or its header doesn't match.
+ *
+ */
+static bool checkHeader(const MappedFile& file, const char* magic, uint64_t key, uint64_t& numPeriods) {
+	
+	ResultCacheHeader header;
+	
+	if (!file.isOpen() || file.getSize() < sizeof(header)) {
+		return false;
+	}
+	
+	memcpy(&header, file.getData(), sizeof(header));
+	
+	if (memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != resultCacheVersion || header.key != key) {
+		return false;
+	}
+	
+	numPeriods = header.numPeriods;
+	
+	return true;
+
+}
+
+/**
+ *
+ * This is default constructor of a cache in a directory, which exists already.
+ * Keys are computed by setParameters().
+ *
+ * @param cacheDirectory: the directory.
+ *
+ */
+ResultCache::ResultCache(const string& cacheDirectory) {
+	
+	directory = cacheDirectory;
+	resultKey = 0;
+	rankingKey = 0;
+	hasKeys = false;
+
+}
+
+/**
+ *
+ * This method is private. It gets the name of a cache file.
+ *
+ * @param key: key of the file.
+ * @param extension: ".results" or ".ranking".
+ *
+ * return e.g. "DIR/0123456789abcdef.results".
+ *
+ */
+string ResultCache::getFileName(uint64_t key, const string& extension) const {
+	
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	
+	return directory + "/" + name + extension;
+
+}
+
+/**
+ *
+ * This method is a mutator to compute keys of a run: input file, groups, buckets
+ * and rebalancing make the ranking key, which with weights and strategy makes the
+ * result key. Each file is hashed once.
+ *
+ * @param parameters: input files and parameters of the run.
+ *
+ * return false if an input file can't be read, and the cache is then not used.
+ *
+ */
+bool ResultCache::setParameters(const ResultParameters& parameters) {
+	
+	PROFILE_STAGE(CACHE);
+	
+	uint64_t inputHash, weightsHash, groupsHash;
+	
+	hasKeys = hashFile(parameters.inputFileName, inputHash) && hashFile(parameters.weightsFileName, weightsHash) && hashFile(parameters.groupsFileName, groupsHash);
+	
+	if (!hasKeys) {
+		return false;
+	}
+	
+	string ranking;
+	putWord(ranking, resultCacheVersion);
+	putWord(ranking, inputHash);
+	putWord(ranking, parameters.groupsFileName.empty() ? 0 : 1);
+	putWord(ranking, groupsHash);
+	putWord(ranking, parameters.numBuckets);
+	putWord(ranking, parameters.allBuckets ? 1 : 0);
+	putWord(ranking, parameters.rebalanceFrequency);
+	putWord(ranking, parameters.rebalanceEvery);
+	rankingKey = hashBytes(ranking.data(), ranking.size());
+	
+	string result;
+	putWord(result, rankingKey);
+	putWord(result, parameters.weightsFileName.empty() ? 0 : 1);
+	putWord(result, weightsHash);
+	putWord(result, parameters.strategy.direction);
+	putWord(result, parameters.strategy.legs);
+	resultKey = hashBytes(result.data(), result.size());
+	
+	return true;
+
+}
+
+/**
+ *
+ * These methods are inspectors for names of cache files of the run.
+ *
+ */
+string ResultCache::getResultName() const {
+	
+	return getFileName(resultKey, ".results");
+
+}
+
+string ResultCache::getRankingName() const {
+	
+	return getFileName(rankingKey, ".ranking");
+
+}
+
+/**
+ *
+ * This method loads results of the run saved by an earlier run.
+ *
+ * @param results: output results of every period in chronological order.
+ *
+ * return false if there are none, or the file is malformed.
+ *
+ */
+bool ResultCache::loadResults(vector<PeriodResult>& results) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	MappedFile file(getResultName());
+	uint64_t numPeriods;
+	
+	if (!hasKeys || !checkHeader(file, resultsMagic, resultKey, numPeriods)) {
+		return false;
+	}
+	
+	const char* cur = file.getData() + sizeof(ResultCacheHeader);
+	const char* end = file.getData() + file.getSize();
+	vector<PeriodResult> loaded;
+	
+	for (uint64_t p = 0; p < numPeriods; p++) {
+		
+		PeriodResult result;
+		uint64_t length, numBuckets;
+		
+		if (!getWord(cur, end, length) || length > static_cast<unsigned long>(end - cur)) {
+			return false;
+		}
+		result.date.assign(cur, length);
+		cur += length;
+		
+		if (!getNumber(cur, end, result.topAverage) || !getNumber(cur, end, result.bottomAverage) || !getNumber(cur, end, result.average)) {
+			return false;
+		}
+		if (!getNumber(cur, end, result.topTurnover) || !getNumber(cur, end, result.bottomTurnover)) {
+			return false;
+		}
+		
+		// Averages, counts and turnovers of buckets take 24 bytes per bucket.
+		if (!getWord(cur, end, numBuckets) || numBuckets > static_cast<unsigned long>(end - cur) / 24) {
+			return false;
+		}
+		
+		result.bucketAverages.resize(numBuckets);
+		result.bucketCounts.resize(numBuckets);
+		result.bucketTurnovers.resize(numBuckets);
+		
+		for (uint64_t b = 0; b < numBuckets; b++) {
+			getNumber(cur, end, result.bucketAverages[b]);
+		}
+		for (uint64_t b = 0; b < numBuckets; b++) {
+			uint64_t count = 0;
+			getWord(cur, end, count);
+			result.bucketCounts[b] = count;
+		}
+		for (uint64_t b = 0; b < numBuckets; b++) {
+			getNumber(cur, end, result.bucketTurnovers[b]);
+		}
+		
+		loaded.push_back(result);
+	}
+	
+	if (cur != end) {
+		return false;
+	}
+	
+	results.swap(loaded);
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method saves results of the run, replacing results of an earlier run with
+ * the same key.
+ *
+ * @param results: results of every period in chronological order.
+ *
+ * return false on failure.
+ *
+ */
+bool ResultCache::saveResults(const vector<PeriodResult>& results) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	if (!hasKeys) {
+		return false;
+	}
+	
+	string contents;
+	
+	for (const PeriodResult& result : results) {
+		
+		putWord(contents, result.date.size());
+		contents += result.date;
+		
+		putNumber(contents, result.topAverage);
+		putNumber(contents, result.bottomAverage);
+		putNumber(contents, result.average);
+		putNumber(contents, result.topTurnover);
+		putNumber(contents, result.bottomTurnover);
+		
+		// Turnovers of buckets are only counted with their averages.
+		putWord(contents, result.bucketAverages.size());
+		for (unsigned long b = 0; b < result.bucketAverages.size(); b++) {
+			putNumber(contents, result.bucketAverages[b]);
+		}
+		for (unsigned long b = 0; b < result.bucketAverages.size(); b++) {
+			putWord(contents, b < result.bucketCounts.size() ? result.bucketCounts[b] : 0);
+		}
+		for (unsigned long b = 0; b < result.bucketAverages.size(); b++) {
+			putNumber(contents, b < result.bucketTurnovers.size() ? result.bucketTurnovers[b] : 1);
+		}
+	}
+	
+	ResultCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, resultsMagic, sizeof(resultsMagic));
+	header.version = resultCacheVersion;
+	header.key = resultKey;
+	header.numPeriods = results.size();
+	
+	return replaceFile(getResultName(), header, contents);
+
+}
+
+/**
+ *
+ * This method loads selections of every period saved by an earlier run with the
+ * same ranking. Selections are checked against the panel, so a malformed file
+ * never makes a month read outside its column.
+ *
+ * @param numPeriods: number of periods of the panel.
+ * @param numSymbols: number of symbols of the panel.
+ * @param bucketsPerPeriod: buckets kept per period, i.e. number of buckets if all
+ *			buckets are requested, otherwise 2.
+ * @param selections: output selections of every period in chronological order.
+ *
+ * return false if there are none, or they don't fit the panel.
+ *
+ */
+bool ResultCache::loadSelections(unsigned long numPeriods, unsigned long numSymbols, unsigned long bucketsPerPeriod, vector<BucketSelection>& selections) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	MappedFile file(getRankingName());
+	uint64_t numSaved;
+	
+	if (!hasKeys || !checkHeader(file, rankingMagic, rankingKey, numSaved) || numSaved != numPeriods) {
+		return false;
+	}
+	
+	const char* cur = file.getData() + sizeof(ResultCacheHeader);
+	const char* end = file.getData() + file.getSize();
+	vector<BucketSelection> loaded(numPeriods);
+	
+	for (unsigned long p = 0; p < numPeriods; p++) {
+		
+		uint64_t numBuckets;
+		if (!getWord(cur, end, numBuckets) || numBuckets != bucketsPerPeriod) {
+			return false;
+		}
+		
+		loaded[p].resize(numBuckets);
+		
+		for (vector<unsigned long>& bucket : loaded[p]) {
+			
+			uint64_t size;
+			if (!getWord(cur, end, size) || size > static_cast<unsigned long>(end - cur) / sizeof(uint64_t)) {
+				return false;
+			}
+			
+			bucket.resize(size);
+			
+			// IDs are in ascending order within the panel, as turnover merges them.
+			for (uint64_t i = 0; i < size; i++) {
+				uint64_t symbolId = 0;
+				getWord(cur, end, symbolId);
+				if (symbolId >= numSymbols || (i > 0 && symbolId <= bucket[i - 1])) {
+					return false;
+				}
+				bucket[i] = symbolId;
+			}
+		}
+	}
+	
+	if (cur != end) {
+		return false;
+	}
+	
+	selections.swap(loaded);
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method saves selections of every period of the run, replacing selections
+ * of an earlier run with the same ranking.
+ *
+ * @param selections: selections of every period in chronological order.
+ *
+ * return false on failure.
+ *
+ */
+bool ResultCache::saveSelections(const vector<BucketSelection>& selections) const {
+	
+	PROFILE_STAGE(CACHE);
+	
+	if (!hasKeys) {
+		return false;
+	}
+	
+	string contents;
+	
+	for (const BucketSelection& selection : selections) {
+		
+		putWord(contents, selection.size());
+		
+		for (const vector<unsigned long>& bucket : selection) {
+			putWord(contents, bucket.size());
+			for (const unsigned long& symbolId : bucket) {
+				putWord(contents, symbolId);
+			}
+		}
+	}
+	
+	ResultCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, rankingMagic, sizeof(rankingMagic));
+	header.version = resultCacheVersion;
+	header.key = rankingKey;
+	header.numPeriods = selections.size();
+	
+	return replaceFile(getRankingName(), header, contents);
+
+}
@@ -0,0 +1,133 @@
+//
+//  ResultCache.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef ResultCache_h
+#define ResultCache_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "MonthlyData.h"
+#include "Calendar.h"
+#include "Strategy.h"
+
+using namespace std;
+
+/**
+ *
+ * Result cache class header code:
+ *
+ * This header file defines an on-disk cache of results addressed by the contents
+ * of input files and the parameters of a run, so a run which was done before is
+ * answered without parsing its input file.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This struct lists everything results of a run depend on. Input files are given
+ * by name, and only their contents count.
+ *
+ */
+struct ResultParameters {
+	
+	// Input file, and files of values and groups, empty if not used.
+	string inputFileName;
+	string weightsFileName;
+	string groupsFileName;
+	
+	// Buckets, rebalancing periods and strategy.
+	unsigned long numBuckets = 10;
+	bool allBuckets = false;
+	RebalanceFrequency rebalanceFrequency = PERIOD_REBALANCE;
+	unsigned long rebalanceEvery = 1;
+	Strategy strategy;
+
+};
+
+
+/**
+ *
+ * This struct is the fixed header at the start of a cache file.
+ *
+ */
+struct ResultCacheHeader {
+	
+	char magic[8];
+	uint64_t version;
+	
+	// Key the file is named after, and number of periods.
+	uint64_t key;
+	uint64_t numPeriods;
+
+};
+
+
+/**
+ *
+ * This class keeps results and rankings of runs in a cache directory, two files
+ * per run named after hexadecimal keys:
+ *
+ *	"<result key>.results" holds results of every period, which depend on all
+ *		parameters, so a run with the same input and parameters writes its
+ *		output files from it without parsing input file.
+ *	"<ranking key>.ranking" holds selections of every formation month, which only
+ *		depend on input file, buckets, groups and rebalancing. A run which only
+ *		changes weights or strategy still parses input file, but reuses the
+ *		selections instead of ranking every month again.
+ *
+ * Keys are hashes of the contents of input files, each hashed at memory speed, and
+ *	of the parameters, so renaming or touching a file keeps its results, and any
+ *	change of content misses. Numbers are stored in byte order of the machine, as
+ *	in the panel cache, and read back exactly. Files are replaced atomically, so
+ *	runs sharing a directory never read a partial file.
+ * A file which is malformed or doesn't fit the panel counts as a miss.
+ *
+ */
+class ResultCache {
+
+private:
+	
+	// Cache directory.
+	string directory;
+	
+	// Keys of the results and ranking of the run, once computed.
+	uint64_t resultKey;
+	uint64_t rankingKey;
+	bool hasKeys;
+	
+	// The method gets the name of a cache file of a key.
+	string getFileName(uint64_t key, const string& extension) const;
+
+public:
+	
+	// A default constructor of a cache in a directory, without keys.
+	ResultCache(const string& cacheDirectory);
+	
+	// The mutator to compute keys of a run, returns false if an input file can't be read.
+	bool setParameters(const ResultParameters& parameters);
+	
+	// Inspectors for names of cache files of the run.
+	string getResultName() const;
+	string getRankingName() const;
+	
+	// Methods to load and save results of the run, all return false on a miss or failure.
+	bool loadResults(vector<PeriodResult>& results) const;
+	bool saveResults(const vector<PeriodResult>& results) const;
+	
+	// Methods to load and save selections of the run's periods, checked against the panel.
+	bool loadSelections(unsigned long numPeriods, unsigned long numSymbols, unsigned long bucketsPerPeriod, vector<BucketSelection>& selections) const;
+	bool saveSelections(const vector<BucketSelection>& selections) const;
+
+};
+
+
+#endif /* ResultCache_h */
@@ -0,0 +1,470 @@
+//
+//  ResultState.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "ResultState.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of ResultState class.
+ *
+ * State file is a text file in following format, where "rate" is "#N/A" for
+ * missing return rates and bucket columns only exist if all buckets are kept:
+ *
+ *     ReturnCalculator state 3
+ *     buckets <number of buckets> <1 if all buckets are kept, otherwise 0>
+ *     periods <number of periods> <sum of period returns>
+ *     <date> <top> <bottom> <average> [<bucket averages>] [<bucket counts>]
+ *     symbols <number of symbols>
+ *     <symbol>
+ *     month <date> <number of return rates>
+ *     <symbol ID> <rate>
+ *
+ * State files of version 2 wrote the date of latest month as "<year> <month>",
+ * e.g. "16 Mar", and are still read.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// First line of state files, and of state files before dates of any frequency.
+static const string stateMagic = "ReturnCalculator state 3";
+static const string monthlyStateMagic = "ReturnCalculator state 2";
+
+/**
+ *
+ * This helper reads a number written by ostream, including "nan" and "inf",
+ * which operator >> does not accept.
+ *
+ * return false if there is no more word or the word is not a number.
+ *
+ */
+static bool readNumber(istream& input, double& value) {
+	
+	string word;
+	if (!(input >> word)) {
+		return false;
+	}
+	
+	char* end = nullptr;
+	value = strtod(word.c_str(), &end);
+	
+	return *end == '\0';
+
+}
+
+/**
+ *
+ * This is default constructor of a state without any month.
+ *
+ * @param n: number of buckets.
+ * @param all: whether results of every bucket are kept.
+ *
+ */
+ResultState::ResultState(unsigned long n, bool all) {
+	
+	numBuckets = n;
+	allBuckets = all;
+	totalReturn = 0;
+
+}
+
+/**
+ *
+ * This method is private. It ranks latest month, looks up return rates of the
+ * new month, and keeps results of the period. Nothing is calculated for the
+ * first month of an empty state.
+ *
+ * @param month: the month after latest month, IDs refer to the state's symbols.
+ *
+ * It throws runtime_error if the month is not after latest month, e.g. when the
+ * same input is appended twice, so the state is not saved with a wrong period.
+ *
+ */
+void ResultState::addPeriod(const LongMonth& month) {
+	
+	if (!lastMonth.symbolIds.empty()) {
+		
+		if (month.parsedDate <= lastMonth.parsedDate) {
+			throw runtime_error("month \"" + month.date + "\" is not after latest month \"" + lastMonth.date + "\" of the state");
+		}
+		
+		PanelData window;
+		LongCsvReader::makeWindow(symbols, lastMonth, month, window, holdingSlots);
+		
+		MonthlyData formationMonth(window, 0), holdingMonth(window, 1);
+		formationMonth.setBuckets(numBuckets, allBuckets);
+		formationMonth.getMonthReturn(holdingMonth);
+		
+		results.push_back(formationMonth.getResult());
+		totalReturn += results.back().average;
+	
+	}
+	
+	lastMonth = month;
+
+}
+
+/**
+ *
+ * This method replaces the state with results of a full run on wide format input.
+ * Latest month keeps all symbols of the panel, so the next period ranks the
+ * same stocks as a full run on input with one more month.
+ *
+ * @param panel: the panel of the full run.
+ * @param allResults: results of every period of the full run.
+ *
+ */
+void ResultState::reset(const PanelData& panel, const vector<PeriodResult>& allResults) {
+	
+	LongMonth latest;
+	
+	if (panel.getNumMonths() > 0) {
+		
+		unsigned long m = panel.getNumMonths() - 1;
+		const double* column = panel.getMonthColumn(m);
+		
+		latest.parsedDate = panel.getDate(m);
+		latest.date = panel.getDateLabel(m);
+		
+		for (unsigned long s = 0; s < panel.getNumSymbols(); s++) {
+			latest.symbolIds.push_back(s);
+			latest.rates.push_back(column[s]);
+			latest.valid.push_back(panel.isValid(s, m));
+		}
+	
+	}
+	
+	reset(panel.getSymbols(), latest, allResults);
+
+}
+
+/**
+ *
+ * This method replaces the state with results of a full run.
+ *
+ * @param allSymbols: the table which IDs of latest month refer to.
+ * @param latest: return rates of latest month.
+ * @param allResults: results of every period of the full run.
+ *
+ */
+void ResultState::reset(const SymbolTable& allSymbols, const LongMonth& latest, const vector<PeriodResult>& allResults) {
+	
+	symbols = allSymbols;
+	lastMonth = latest;
+	results = allResults;
+	holdingSlots.clear();
+	
+	totalReturn = 0;
+	for (const PeriodResult& result : results) {
+		totalReturn += result.average;
+	}
+
+}
+
+/**
+ *
+ * This method appends all months of a wide format panel in chronological order.
+ * Each new month lists every known symbol, and symbols missing from the panel are
+ * missing in that month, the same as empty cells of a full wide input file.
+ *
+ * @param panel: a panel of new months only.
+ *
+ */
+void ResultState::append(const PanelData& panel) {
+	
+	// IDs of panel symbols in the state's table. New symbols get IDs after known ones.
+	vector<unsigned long> stateIds(panel.getNumSymbols());
+	for (unsigned long s = 0; s < panel.getNumSymbols(); s++) {
+		stateIds[s] = symbols.intern(panel.getSymbols().getSymbol(s));
+	}
+	
+	LongMonth month;
+	
+	for (unsigned long m = 0; m < panel.getNumMonths(); m++) {
+		
+		const double* column = panel.getMonthColumn(m);
+		
+		month.clear();
+		month.parsedDate = panel.getDate(m);
+		month.date = panel.getDateLabel(m);
+		
+		month.symbolIds.resize(symbols.size());
+		month.rates.assign(symbols.size(), 0);
+		month.valid.assign(symbols.size(), 0);
+		
+		for (unsigned long id = 0; id < symbols.size(); id++) {
+			month.symbolIds[id] = id;
+		}
+		for (unsigned long s = 0; s < panel.getNumSymbols(); s++) {
+			month.rates[stateIds[s]] = column[s];
+			month.valid[stateIds[s]] = panel.isValid(s, m);
+		}
+		
+		addPeriod(month);
+	}
+
+}
+
+/**
+ *
+ * This method appends one month of long format input.
+ *
+ * @param month: the new month.
+ * @param monthSymbols: the table which IDs of the new month refer to.
+ *
+ */
+void ResultState::append(const LongMonth& month, const SymbolTable& monthSymbols) {
+	
+	LongMonth translated = month;
+	for (unsigned long& id : translated.symbolIds) {
+		id = symbols.intern(monthSymbols.getSymbol(id));
+	}
+	
+	addPeriod(translated);
+
+}
+
+/**
+ *
+ * This method is inspector to get number of buckets.
+ *
+ * return number of buckets.
+ *
+ */
+unsigned long ResultState::getNumBuckets() const {
+	
+	return numBuckets;
+
+}
+
+/**
+ *
+ * This method is inspector to check whether results of every bucket are kept.
+ *
+ * return true if all buckets are kept.
+ *
+ */
+bool ResultState::hasAllBuckets() const {
+	
+	return allBuckets;
+
+}
+
+/**
+ *
+ * This method is inspector to get results of all periods.
+ *
+ * return a constant reference of results in chronological order.
+ *
+ */
+const vector<PeriodResult>& ResultState::getResults() const {
+	
+	return results;
+
+}
+
+/**
+ *
+ * This method is inspector to get average return of all periods, taken from the
+ * running sum.
+ *
+ * return average return, or 0 if there is no period.
+ *
+ */
+double ResultState::getAverageReturn() const {
+	
+	return results.empty() ? 0 : totalReturn / static_cast<double>(results.size());
+
+}
+
+/**
+ *
+ * This method writes the state into a temporary file of this process, which then
+ * replaces the state file, so a failed run never leaves a partly written state, and
+ * runs saving the same state at once don't write into each other's file.
+ *
+ * @param fileName: path of state file.
+ *
+ * return true if the state file was written.
+ *
+ */
+bool ResultState::save(const string& fileName) const {
+	
+	string tempName = fileName + ".tmp." + to_string(getpid());
+	ofstream output(tempName, ios::trunc);
+	
+	if (!output.is_open()) {
+		return false;
+	}
+	
+	output.precision(17);
+	
+	output << stateMagic << "\n";
+	output << "buckets " << numBuckets << " " << (allBuckets ? 1 : 0) << "\n";
+	output << "periods " << results.size() << " " << totalReturn << "\n";
+	
+	for (const PeriodResult& result : results) {
+		
+		output << result.date << " " << result.topAverage << " " << result.bottomAverage << " " << result.average;
+		for (double average : result.bucketAverages) {
+			output << " " << average;
+		}
+		for (unsigned long count : result.bucketCounts) {
+			output << " " << count;
+		}
+		output << "\n";
+	
+	}
+	
+	output << "symbols " << symbols.size() << "\n";
+	for (unsigned long s = 0; s < symbols.size(); s++) {
+		output << symbols.getSymbol(s) << "\n";
+	}
+	
+	output << "month " << lastMonth.date << " " << lastMonth.symbolIds.size() << "\n";
+	for (unsigned long i = 0; i < lastMonth.symbolIds.size(); i++) {
+		
+		output << lastMonth.symbolIds[i] << " ";
+		if (lastMonth.valid[i]) {
+			output << lastMonth.rates[i] << "\n";
+		} else {
+			output << "#N/A\n";
+		}
+	
+	}
+	
+	output.close();
+	
+	if (!output || rename(tempName.c_str(), fileName.c_str()) != 0) {
+		remove(tempName.c_str());
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This method replaces the state with the one saved in a file. Bucket settings
+ * are taken from the file.
+ *
+ * @param fileName: path of state file.
+ *
+ * return false if the file cannot be opened or is not a valid state file, then
+ * the state is left unchanged.
+ *
+ */
+bool ResultState::load(const string& fileName) {
+	
+	ifstream input(fileName);
+	if (!input.is_open()) {
+		return false;
+	}
+	
+	string line, word;
+	if (!getline(input, line) || (line != stateMagic && line != monthlyStateMagic)) {
+		return false;
+	}
+	bool splitDate = (line == monthlyStateMagic);
+	
+	unsigned long n = 0, all = 0, numPeriods = 0, numSymbols = 0, numRates = 0;
+	double total = 0;
+	
+	if (!(input >> word >> n >> all) || word != "buckets" || !(input >> word >> numPeriods) || word != "periods" || !readNumber(input, total)) {
+		return false;
+	}
+	
+	vector<PeriodResult> loadedResults(numPeriods);
+	for (PeriodResult& result : loadedResults) {
+		
+		if (!(input >> result.date) || !readNumber(input, result.topAverage) || !readNumber(input, result.bottomAverage) || !readNumber(input, result.average)) {
+			return false;
+		}
+		
+		if (all != 0) {
+			
+			result.bucketAverages.resize(n);
+			result.bucketCounts.resize(n);
+			for (double& average : result.bucketAverages) {
+				readNumber(input, average);
+			}
+			for (unsigned long& count : result.bucketCounts) {
+				input >> count;
+			}
+		
+		}
+	
+	}
+	
+	if (!(input >> word >> numSymbols) || word != "symbols") {
+		return false;
+	}
+	
+	// Symbols are read line by line, as they may contain spaces.
+	getline(input, line);
+	
+	SymbolTable loadedSymbols;
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		if (!getline(input, line) || loadedSymbols.intern(line) != s) {
+			return false;
+		}
+	}
+	
+	LongMonth latest;
+	if (!(input >> word >> latest.date) || word != "month") {
+		return false;
+	}
+	
+	if (splitDate && input >> word) {
+		latest.date += "-" + word;
+	}
+	
+	if (!(input >> numRates) || !parseDate(latest.date.data(), latest.date.data() + latest.date.size(), latest.parsedDate)) {
+		return false;
+	}
+	
+	for (unsigned long i = 0; i < numRates; i++) {
+		
+		unsigned long id = 0;
+		if (!(input >> id >> word) || id >= numSymbols) {
+			return false;
+		}
+		
+		latest.symbolIds.push_back(id);
+		if (word == "#N/A") {
+			latest.rates.push_back(0);
+			latest.valid.push_back(0);
+		} else {
+			latest.rates.push_back(strtod(word.c_str(), nullptr));
+			latest.valid.push_back(1);
+		}
+	
+	}
+	
+	if (!input) {
+		return false;
+	}
+	
+	numBuckets = n;
+	allBuckets = (all != 0);
+	reset(loadedSymbols, latest, loadedResults);
+	totalReturn = total;
+	
+	return true;
+
+}
@@ -0,0 +1,93 @@
+//
+//  ResultState.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef ResultState_h
+#define ResultState_h
+
+#include <string>
+#include <vector>
+#include "PanelData.h"
+#include "MonthlyData.h"
+#include "LongCsvReader.h"
+
+using namespace std;
+
+/**
+ *
+ * Result state class header code:
+ *
+ * This header file defines the state kept between runs, so that a new month of
+ * input can be appended without calculating earlier periods again.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps results of all calculated periods, and return rates of the
+ * latest month, which is formation month of the next period.
+ *
+ * Appending a month ranks the latest month and looks up return rates of the new
+ *	month, the same as a full run, then the new month becomes latest month.
+ * The running sum of period returns is updated with each new period, so the
+ *	overall average is known without reading earlier periods.
+ * State is saved as a text file, with return rates written in 17 significant
+ *	digits so that they are read back exactly.
+ *
+ */
+class ResultState {
+
+private:
+	
+	// Bucket settings of all periods.
+	unsigned long numBuckets;
+	bool allBuckets;
+	
+	// Results of calculated periods in chronological order, and sum of their returns.
+	vector<PeriodResult> results;
+	double totalReturn;
+	
+	// All symbols seen, and return rates of the latest month.
+	SymbolTable symbols;
+	LongMonth lastMonth;
+	
+	// Scratch space of window building.
+	vector<long> holdingSlots;
+	
+	// The method calculates the period from latest month to a new month.
+	void addPeriod(const LongMonth& month);
+
+public:
+	
+	// A default constructor with bucket settings of a new state.
+	ResultState(unsigned long n, bool all);
+	
+	// Mutators to start over from a full run on wide or long format input.
+	void reset(const PanelData& panel, const vector<PeriodResult>& allResults);
+	void reset(const SymbolTable& allSymbols, const LongMonth& latest, const vector<PeriodResult>& allResults);
+	
+	// Mutators to append new months in chronological order, all after latest month, or they throw runtime_error.
+	void append(const PanelData& panel);
+	void append(const LongMonth& month, const SymbolTable& monthSymbols);
+	
+	// Inspectors for bucket settings and results.
+	unsigned long getNumBuckets() const;
+	bool hasAllBuckets() const;
+	const vector<PeriodResult>& getResults() const;
+	double getAverageReturn() const;
+	
+	// Methods to save state into a file and load it back, both return false on failure.
+	bool save(const string& fileName) const;
+	bool load(const string& fileName);
+
+};
+
+
+#endif /* ResultState_h */
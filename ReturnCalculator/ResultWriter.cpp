@@ -0,0 +1,306 @@
+//
+//  ResultWriter.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "ResultWriter.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of ResultWriter class, and helpers of output formats.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+// Longest text of a number, e.g. "-1.23457e-308" or an unsigned long.
+static const unsigned long maxNumberLength = 32;
+
+
+/**
+ *
+ * This function reads name of an output format.
+ *
+ * @param name: "csv", "long", "jsonl" or "binary".
+ * @param format: output parameter receiving the format.
+ *
+ * return false if the name is unknown.
+ *
+ */
+bool parseOutputFormat(const string& name, OutputFormat& format) {
+	
+	if (name == "csv") {
+		format = CSV_OUTPUT;
+	} else if (name == "long") {
+		format = LONG_OUTPUT;
+	} else if (name == "jsonl") {
+		format = JSONL_OUTPUT;
+	} else if (name == "binary") {
+		format = BINARY_OUTPUT;
+	} else {
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This function gets what output file names end with in a format, so "result"
+ * becomes "result.csv", "result_long.csv", "result.jsonl" or "result.bin".
+ *
+ * @param format: the format.
+ *
+ * return the suffix.
+ *
+ */
+string getOutputSuffix(OutputFormat format) {
+	
+	switch (format) {
+		case LONG_OUTPUT:
+			return "_long.csv";
+		case JSONL_OUTPUT:
+			return ".jsonl";
+		case BINARY_OUTPUT:
+			return ".bin";
+		default:
+			return ".csv";
+	}
+
+}
+
+/**
+ *
+ * This is default constructor of a writer without any file.
+ *
+ * @param capacity: size of the buffer in bytes.
+ *
+ */
+ResultWriter::ResultWriter(unsigned long capacity) {
+	
+	fd = -1;
+	buffer.resize(max(capacity, maxNumberLength));
+	used = 0;
+	bytesWritten = 0;
+	failed = false;
+
+}
+
+/**
+ *
+ * This is destructor which writes what is left in the buffer, and closes the file.
+ *
+ */
+ResultWriter::~ResultWriter() {
+	
+	close();
+
+}
+
+/**
+ *
+ * This method creates a file, or truncates an existing one, closing the file
+ * written before.
+ *
+ * @param fileName: path of the file.
+ *
+ * return false if the file can't be opened.
+ *
+ */
+bool ResultWriter::open(const string& fileName) {
+	
+	close();
+	
+	fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	used = 0;
+	bytesWritten = 0;
+	failed = false;
+	
+	return fd >= 0;
+
+}
+
+/**
+ *
+ * This method is private. It gets space for n more bytes at the end of the buffer,
+ * writing the buffer first if they don't fit.
+ *
+ * @param n: number of bytes, at most size of the buffer.
+ *
+ * return address the bytes are to be written at.
+ *
+ */
+char* ResultWriter::reserve(unsigned long n) {
+	
+	if (used + n > buffer.size()) {
+		flush();
+	}
+	
+	return buffer.data() + used;
+
+}
+
+/**
+ *
+ * These methods append a character, or a piece of text. Text longer than the
+ * buffer is written in pieces.
+ *
+ */
+void ResultWriter::append(char c) {
+	
+	*reserve(1) = c;
+	used++;
+
+}
+
+void ResultWriter::append(const char* text, unsigned long length) {
+	
+	while (length > 0) {
+		
+		unsigned long n = min(length, buffer.size());
+		memcpy(reserve(n), text, n);
+		used += n;
+		
+		text += n;
+		length -= n;
+	}
+
+}
+
+void ResultWriter::append(const string& text) {
+	
+	append(text.data(), text.size());
+
+}
+
+/**
+ *
+ * This method appends a double as text, in the shortest of fixed and scientific
+ * notation with 6 significant digits, i.e. what ostream writes by default.
+ *
+ * @param value: the number.
+ *
+ */
+void ResultWriter::appendNumber(double value) {
+	
+	char* first = reserve(maxNumberLength);
+	to_chars_result written = to_chars(first, first + maxNumberLength, value, chars_format::general, 6);
+	used += written.ptr - first;
+
+}
+
+/**
+ *
+ * This method appends an unsigned integer as text.
+ *
+ * @param value: the number.
+ *
+ */
+void ResultWriter::appendNumber(unsigned long value) {
+	
+	char* first = reserve(maxNumberLength);
+	to_chars_result written = to_chars(first, first + maxNumberLength, value);
+	used += written.ptr - first;
+
+}
+
+/**
+ *
+ * This method appends raw bytes, e.g. numbers in their binary representation.
+ *
+ * @param data: start of the bytes.
+ * @param length: number of bytes.
+ *
+ */
+void ResultWriter::appendBytes(const void* data, unsigned long length) {
+	
+	append(static_cast<const char*>(data), length);
+
+}
+
+/**
+ *
+ * This method writes the buffer. It takes one write call, unless the system
+ * accepts only part of the buffer or is interrupted.
+ *
+ * return false if this or any earlier write failed.
+ *
+ */
+bool ResultWriter::flush() {
+	
+	const char* data = buffer.data();
+	unsigned long remaining = used;
+	
+	while (remaining > 0 && !failed && fd >= 0) {
+		
+		ssize_t n = ::write(fd, data, remaining);
+		
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			failed = true;
+			break;
+		}
+		
+		data += n;
+		remaining -= n;
+	}
+	
+	bytesWritten += used;
+	used = 0;
+	
+	return !failed && fd >= 0;
+
+}
+
+/**
+ *
+ * This method writes what is left in the buffer and closes the file. Closing
+ * a writer without a file does nothing.
+ *
+ * return false if any write failed, or no file was open.
+ *
+ */
+bool ResultWriter::close() {
+	
+	if (fd < 0) {
+		return false;
+	}
+	
+	flush();
+	
+	if (::close(fd) != 0) {
+		failed = true;
+	}
+	fd = -1;
+	
+	return !failed;
+
+}
+
+/**
+ *
+ * This method is inspector to get number of bytes written since the file was opened.
+ *
+ * return number of bytes, including those still in the buffer.
+ *
+ */
+uint64_t ResultWriter::getBytesWritten() const {
+	
+	return bytesWritten + used;
+
+}
@@ -0,0 +1,101 @@
+//
+//  ResultWriter.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef ResultWriter_h
+#define ResultWriter_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ *
+ * Result writer class header code:
+ *
+ * This header file defines the buffered writer which all output files are
+ * written through, and the formats results can be written in.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+// Formats of results, selected by "--format csv|long|jsonl|binary".
+enum OutputFormat {CSV_OUTPUT, LONG_OUTPUT, JSONL_OUTPUT, BINARY_OUTPUT};
+
+// The function reads a format name, returns false if it is unknown.
+bool parseOutputFormat(const string& name, OutputFormat& format);
+
+// The function gets the file name suffix of a format, e.g. ".csv".
+string getOutputSuffix(OutputFormat format);
+
+
+/**
+ *
+ * This class writes a file through one large buffer which is reused until the
+ * file is closed. Numbers are formatted with to_chars straight into the buffer,
+ * and a full buffer is handed to the system in a single write call, so writing
+ * costs neither stream locale handling nor a flush per line.
+ * Doubles are written with 6 significant digits, the same as ostream by default.
+ * A failed write is remembered and reported by close(), later output is dropped.
+ * Objects are not copyable, since they own the file descriptor.
+ *
+ */
+class ResultWriter {
+
+private:
+	
+	// Descriptor of the output file, -1 if none is open.
+	int fd;
+	
+	// Reusable buffer, and number of bytes in it not yet written.
+	vector<char> buffer;
+	unsigned long used;
+	
+	// Bytes handed to the system so far, and whether any write failed.
+	uint64_t bytesWritten;
+	bool failed;
+	
+	// The method makes room for n more bytes, flushing the buffer if needed.
+	char* reserve(unsigned long n);
+
+public:
+	
+	// A default constructor specifying size of the buffer.
+	ResultWriter(unsigned long capacity = 1 << 20);
+	~ResultWriter();
+	
+	ResultWriter(const ResultWriter&) = delete;
+	ResultWriter& operator = (const ResultWriter&) = delete;
+	
+	// The method creates or truncates a file, returns false if it can't be opened.
+	bool open(const string& fileName);
+	
+	// The methods append text, numbers formatted as text, or raw bytes.
+	void append(char c);
+	void append(const char* text, unsigned long length);
+	void append(const string& text);
+	void appendNumber(double value);
+	void appendNumber(unsigned long value);
+	void appendBytes(const void* data, unsigned long length);
+	
+	// The method writes the buffer with one system call, returns false if any write failed.
+	bool flush();
+	
+	// The method flushes and closes the file, returns false if any write failed.
+	bool close();
+	
+	// Inspector for number of bytes written, including those still buffered.
+	uint64_t getBytesWritten() const;
+
+};
+
+
+#endif /* ResultWriter_h */
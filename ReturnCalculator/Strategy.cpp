@@ -0,0 +1,177 @@
+//
+//  Strategy.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "Strategy.h"
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains parsing of strategy options, and the dispatcher which
+ * maps them to kernels compiled for each combination of policies.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This function parses the direction of a strategy given on command line.
+ *
+ * @param name: "reversal" or "momentum".
+ * @param direction: output parameter receiving the direction.
+ *
+ * return false if the name is not a direction.
+ *
+ */
+bool parseDirection(const string& name, StrategyDirection& direction) {
+	
+	if (name == "reversal") {
+		direction = REVERSAL_STRATEGY;
+	} else if (name == "momentum") {
+		direction = MOMENTUM_STRATEGY;
+	} else {
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This function parses the legs of a strategy given on command line.
+ *
+ * @param name: "long-short", "long" or "short".
+ * @param legs: output parameter receiving the legs.
+ *
+ * return false if the name is not one of them.
+ *
+ */
+bool parseLegs(const string& name, StrategyLegs& legs) {
+	
+	if (name == "long-short") {
+		legs = LONG_SHORT_LEGS;
+	} else if (name == "long") {
+		legs = LONG_ONLY_LEGS;
+	} else if (name == "short") {
+		legs = SHORT_ONLY_LEGS;
+	} else {
+		return false;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * These methods tell whether the top or bottom bucket is held, and so traded, by
+ * the strategy. Reversal buys the bottom bucket and momentum buys the top one.
+ *
+ */
+bool Strategy::holdsTop() const {
+	
+	bool bought = (direction == MOMENTUM_STRATEGY);
+	
+	return legs == LONG_SHORT_LEGS || (legs == LONG_ONLY_LEGS) == bought;
+
+}
+
+bool Strategy::holdsBottom() const {
+	
+	bool bought = (direction == REVERSAL_STRATEGY);
+	
+	return legs == LONG_SHORT_LEGS || (legs == LONG_ONLY_LEGS) == bought;
+
+}
+
+/**
+ *
+ * This method combines averages of top and bottom buckets into return of the
+ * portfolio, testing the options once. It serves paths which average buckets on
+ * their own, e.g. windows of the sweep engine, where it is called once per period.
+ *
+ * @param topAverage: average return of top bucket.
+ * @param bottomAverage: average return of bottom bucket.
+ *
+ * return return of the portfolio.
+ *
+ */
+double Strategy::combine(double topAverage, double bottomAverage) const {
+	
+	double bought = (direction == MOMENTUM_STRATEGY ? topAverage : bottomAverage);
+	double sold = (direction == MOMENTUM_STRATEGY ? bottomAverage : topAverage);
+	
+	switch (legs) {
+		case LONG_ONLY_LEGS:
+			return bought;
+		case SHORT_ONLY_LEGS:
+			return -sold;
+		default:
+			return bought - sold;
+	}
+
+}
+
+/**
+ *
+ * This method gets name of the strategy for output.
+ *
+ * return e.g. "reversal long-short" or "momentum long".
+ *
+ */
+string Strategy::getName() const {
+	
+	static const char* legNames[3] = {"long-short", "long", "short"};
+	
+	return string(direction == MOMENTUM_STRATEGY ? "momentum " : "reversal ") + legNames[legs];
+
+}
+
+/**
+ *
+ * This function is private to this file. It picks the kernel of a leg policy and
+ * weighting policy, for a direction policy.
+ *
+ */
+template <class Direction>
+static StrategyKernel selectLegs(StrategyLegs legs, bool valueWeighted) {
+	
+	switch (legs) {
+		case LONG_ONLY_LEGS:
+			return valueWeighted ? strategyReturn<Direction, LongOnlyPolicy, ValueWeightPolicy> : strategyReturn<Direction, LongOnlyPolicy, EqualWeightPolicy>;
+		case SHORT_ONLY_LEGS:
+			return valueWeighted ? strategyReturn<Direction, ShortOnlyPolicy, ValueWeightPolicy> : strategyReturn<Direction, ShortOnlyPolicy, EqualWeightPolicy>;
+		default:
+			return valueWeighted ? strategyReturn<Direction, LongShortPolicy, ValueWeightPolicy> : strategyReturn<Direction, LongShortPolicy, EqualWeightPolicy>;
+	}
+
+}
+
+/**
+ *
+ * This function is the dispatcher from options of a strategy to the kernel compiled
+ * for them. It is called once per month, and the kernel then runs without testing
+ * any option.
+ *
+ * @param strategy: direction and legs of the strategy.
+ * @param valueWeighted: whether stocks are weighted by value instead of equally.
+ *
+ * return the kernel.
+ *
+ */
+StrategyKernel selectKernel(const Strategy& strategy, bool valueWeighted) {
+	
+	if (strategy.direction == MOMENTUM_STRATEGY) {
+		return selectLegs<MomentumPolicy>(strategy.legs, valueWeighted);
+	}
+	
+	return selectLegs<ReversalPolicy>(strategy.legs, valueWeighted);
+
+}
@@ -0,0 +1,290 @@
+//
+//  Strategy.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef Strategy_h
+#define Strategy_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ *
+ * Strategy header code:
+ *
+ * This header file defines which portfolio is built from top and bottom buckets,
+ * as policy classes, and the kernel which calculates next month's return of a
+ * period for a combination of policies. Every combination is compiled into its
+ * own kernel, so the inner loops carry no test of options, and a dispatcher picks
+ * the kernel of options given on command line once.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+// Which bucket is bought: reversal buys the bottom bucket (losers of formation
+// month) and sells the top one, momentum does the opposite.
+enum StrategyDirection {
+	REVERSAL_STRATEGY,
+	MOMENTUM_STRATEGY
+};
+
+// Which legs are held: both, only the bought bucket, or only the sold one.
+enum StrategyLegs {
+	LONG_SHORT_LEGS,
+	LONG_ONLY_LEGS,
+	SHORT_ONLY_LEGS
+};
+
+// The function parses "reversal" or "momentum", returns false otherwise.
+bool parseDirection(const string& name, StrategyDirection& direction);
+
+// The function parses "long-short", "long" or "short", returns false otherwise.
+bool parseLegs(const string& name, StrategyLegs& legs);
+
+
+/**
+ *
+ * This struct keeps the options of a strategy. The default is the original one,
+ * i.e. buying the bottom bucket and selling the top one.
+ *
+ */
+struct Strategy {
+	
+	StrategyDirection direction = REVERSAL_STRATEGY;
+	StrategyLegs legs = LONG_SHORT_LEGS;
+	
+	// Whether the top or bottom bucket is traded, for trading costs.
+	bool holdsTop() const;
+	bool holdsBottom() const;
+	
+	// Return of the portfolio from averages of both buckets, for paths without a kernel.
+	double combine(double topAverage, double bottomAverage) const;
+	
+	// Name of the strategy for output, e.g. "momentum long".
+	string getName() const;
+
+};
+
+
+/**
+ *
+ * This struct locates the columns a period reads: next month's return rates and
+ * their validity masks, and values of formation month to weight stocks by, which
+ * are null when equally weighted.
+ *
+ */
+struct StrategyColumns {
+	
+	const double* nextRates;
+	const uint64_t* nextValid;
+	const double* weights;
+	const uint64_t* weightsValid;
+
+};
+
+
+/**
+ *
+ * This struct keeps next month's return rates of top and bottom buckets, weights of
+ * the same stocks in the same order when value weighted, and their averages. Its
+ * vectors are reused from period to period.
+ *
+ */
+struct LegReturns {
+	
+	vector<double> topRates;
+	vector<double> topWeights;
+	vector<double> bottomRates;
+	vector<double> bottomWeights;
+	
+	double topAverage = 0;
+	double bottomAverage = 0;
+
+};
+
+
+// Direction policies give the averages of the bought and sold buckets.
+struct ReversalPolicy {
+	static double longAverage(double, double bottom) { return bottom; }
+	static double shortAverage(double top, double) { return top; }
+};
+
+struct MomentumPolicy {
+	static double longAverage(double top, double) { return top; }
+	static double shortAverage(double, double bottom) { return bottom; }
+};
+
+// Leg policies combine both averages into the return of the portfolio.
+struct LongShortPolicy {
+	template <class Direction>
+	static double combine(double top, double bottom) {
+		return Direction::longAverage(top, bottom) - Direction::shortAverage(top, bottom);
+	}
+};
+
+struct LongOnlyPolicy {
+	template <class Direction>
+	static double combine(double top, double bottom) {
+		return Direction::longAverage(top, bottom);
+	}
+};
+
+struct ShortOnlyPolicy {
+	template <class Direction>
+	static double combine(double top, double bottom) {
+		return -Direction::shortAverage(top, bottom);
+	}
+};
+
+// Weighting policies tell whether stocks are weighted by value of formation month.
+struct EqualWeightPolicy {
+	static constexpr bool valueWeighted = false;
+};
+
+struct ValueWeightPolicy {
+	static constexpr bool valueWeighted = true;
+};
+
+
+// Test of one bit of a validity mask.
+inline bool testValid(const uint64_t* mask, unsigned long symbolId) {
+	return (mask[symbolId / 64] >> (symbolId % 64)) & 1;
+}
+
+
+/**
+ *
+ * This function looks up next month's return rates of selected stocks, leaving out
+ * stocks missing next month, and when value weighted, stocks without a positive
+ * value in formation month. Weights are kept next to return rates, so averaging
+ * reads both contiguously.
+ *
+ * @param symbolIds: IDs of selected stocks.
+ * @param columns: columns of the period.
+ * @param rates: output next month's return rates.
+ * @param weights: output weights of the same stocks, only filled when value weighted.
+ *
+ */
+template <class Weighting>
+void collectReturns(const vector<unsigned long>& symbolIds, const StrategyColumns& columns, vector<double>& rates, vector<double>& weights) {
+	
+	rates.clear();
+	rates.reserve(symbolIds.size());
+	weights.clear();
+	if constexpr (Weighting::valueWeighted) {
+		weights.reserve(symbolIds.size());
+	}
+	
+	for (const unsigned long& symbolId : symbolIds) {
+		
+		if (!testValid(columns.nextValid, symbolId)) {
+			continue;
+		}
+		
+		if constexpr (Weighting::valueWeighted) {
+			double weight = columns.weights[symbolId];
+			if (!testValid(columns.weightsValid, symbolId) || !(weight > 0)) {
+				continue;
+			}
+			weights.push_back(weight);
+		}
+		
+		rates.push_back(columns.nextRates[symbolId]);
+	}
+
+}
+
+
+/**
+ *
+ * This function averages return rates collected by collectReturns(). Equal weights
+ * are summed in order. Value weights divide the dot product by sum of weights, with
+ * four running sums of each kind, so the compiler can vectorize the loop and
+ * additions don't wait for each other.
+ *
+ * @param rates: return rates.
+ * @param weights: weights of the same stocks, in the same order, if value weighted.
+ *
+ * return the average, NaN without stocks.
+ *
+ */
+template <class Weighting>
+double averageReturns(const vector<double>& rates, const vector<double>& weights) {
+	
+	unsigned long n = rates.size();
+	
+	if constexpr (!Weighting::valueWeighted) {
+		
+		double sum = 0;
+		for (const double& rate : rates) {
+			sum += rate;
+		}
+		
+		return sum / static_cast<double>(n);
+	}
+	
+	double products[4] = {0, 0, 0, 0};
+	double sums[4] = {0, 0, 0, 0};
+	
+	unsigned long i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (unsigned long k = 0; k < 4; k++) {
+			products[k] += rates[i + k] * weights[i + k];
+			sums[k] += weights[i + k];
+		}
+	}
+	for (; i < n; i++) {
+		products[0] += rates[i] * weights[i];
+		sums[0] += weights[i];
+	}
+	
+	return ((products[0] + products[1]) + (products[2] + products[3])) / ((sums[0] + sums[1]) + (sums[2] + sums[3]));
+
+}
+
+
+/**
+ *
+ * This function is the kernel of a period: it averages next month's return rates of
+ * top and bottom buckets, and combines both averages into the return of the
+ * portfolio, as given by its policies.
+ *
+ * @param top: IDs of stocks of top bucket.
+ * @param bottom: IDs of stocks of bottom bucket.
+ * @param columns: columns of the period.
+ * @param legs: output return rates and averages of both buckets.
+ *
+ * return next month's return of the portfolio.
+ *
+ */
+template <class Direction, class Legs, class Weighting>
+double strategyReturn(const vector<unsigned long>& top, const vector<unsigned long>& bottom, const StrategyColumns& columns, LegReturns& legs) {
+	
+	collectReturns<Weighting>(top, columns, legs.topRates, legs.topWeights);
+	collectReturns<Weighting>(bottom, columns, legs.bottomRates, legs.bottomWeights);
+	
+	legs.topAverage = averageReturns<Weighting>(legs.topRates, legs.topWeights);
+	legs.bottomAverage = averageReturns<Weighting>(legs.bottomRates, legs.bottomWeights);
+	
+	return Legs::template combine<Direction>(legs.topAverage, legs.bottomAverage);
+
+}
+
+
+// A kernel compiled for one combination of policies.
+typedef double (*StrategyKernel)(const vector<unsigned long>& top, const vector<unsigned long>& bottom, const StrategyColumns& columns, LegReturns& legs);
+
+// The function picks the kernel of a strategy, value weighted or not.
+StrategyKernel selectKernel(const Strategy& strategy, bool valueWeighted);
+
+
+#endif /* Strategy_h */
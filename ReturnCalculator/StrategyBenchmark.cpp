@@ -0,0 +1,200 @@
+//
+//  StrategyBenchmark.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "Strategy.h"
+
+using namespace std;
+
+/**
+ *
+ * This file contains a micro-benchmark which compares the strategy kernels, each
+ * compiled for one combination of direction, legs and weighting, against a generic
+ * version which tests the options at run time for every stock.
+ *
+ * For each universe size, random return rates of next month, weights and validity
+ * masks are generated, and random top and bottom ten percent are selected. Return
+ * of every strategy is calculated by both versions repeatedly, and average time per
+ * selected stock is reported. Returns of both versions are checked to agree.
+ *
+ * Usage: strategyBench
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This function is the generic version: one loop serves every strategy, and the
+ * options are tested for every stock looked up and averaged.
+ *
+ * @param selection: IDs of selected stocks.
+ * @param columns: columns of the period.
+ * @param valueWeighted: whether stocks are weighted by value.
+ * @param rates: buffer of return rates.
+ * @param weights: buffer of weights.
+ *
+ * return average next month's return of the stocks.
+ *
+ */
+double genericAverage(const vector<unsigned long>& selection, const StrategyColumns& columns, bool valueWeighted, vector<double>& rates, vector<double>& weights) {
+	
+	rates.clear();
+	weights.clear();
+	
+	for (const unsigned long& symbolId : selection) {
+		
+		bool valid = testValid(columns.nextValid, symbolId);
+		if (valid && valueWeighted) {
+			valid = testValid(columns.weightsValid, symbolId) && columns.weights[symbolId] > 0;
+		}
+		
+		if (valid) {
+			rates.push_back(columns.nextRates[symbolId]);
+			weights.push_back(valueWeighted ? columns.weights[symbolId] : 1.0);
+		}
+	}
+	
+	double sum = 0, totalWeight = 0;
+	for (unsigned long i = 0; i < rates.size(); i++) {
+		sum += valueWeighted ? rates[i] * weights[i] : rates[i];
+		totalWeight += valueWeighted ? weights[i] : 1.0;
+	}
+	
+	return sum / totalWeight;
+
+}
+
+/**
+ *
+ * This function is the generic version of a period, which combines both averages
+ * by testing direction and legs.
+ *
+ */
+double genericReturn(const vector<unsigned long>& top, const vector<unsigned long>& bottom, const StrategyColumns& columns, const Strategy& strategy, bool valueWeighted, vector<double>& rates, vector<double>& weights) {
+	
+	double topAverage = genericAverage(top, columns, valueWeighted, rates, weights);
+	double bottomAverage = genericAverage(bottom, columns, valueWeighted, rates, weights);
+	
+	double bought = strategy.direction == MOMENTUM_STRATEGY ? topAverage : bottomAverage;
+	double sold = strategy.direction == MOMENTUM_STRATEGY ? bottomAverage : topAverage;
+	
+	switch (strategy.legs) {
+		case LONG_ONLY_LEGS:
+			return bought;
+		case SHORT_ONLY_LEGS:
+			return -sold;
+		default:
+			return bought - sold;
+	}
+
+}
+
+
+// Main entry point of the benchmark.
+int main() {
+	
+	const unsigned long sizes[] = {5000, 50000, 500000};
+	
+	// Roughly the same number of stocks are selected for every size.
+	const unsigned long stocksPerSize = 20000000;
+	
+	mt19937_64 generator(2016);
+	normal_distribution<double> returnDistribution(0.01, 0.1);
+	lognormal_distribution<double> valueDistribution(7, 2);
+	bernoulli_distribution missing(0.02);
+	
+	cout << setw(10) << "stocks" << setw(24) << "strategy" << setw(10) << "weights";
+	cout << setw(18) << "generic ns/stock" << setw(18) << "kernel ns/stock";
+	cout << setw(10) << "speedup" << endl;
+	
+	bool allMatched = true;
+	
+	for (unsigned long size : sizes) {
+		
+		// Next month's return rates and formation month's values, 2% of each missing.
+		vector<double> nextRates(size), values(size);
+		vector<uint64_t> nextValid((size + 63) / 64, 0), valuesValid((size + 63) / 64, 0);
+		for (unsigned long id = 0; id < size; id++) {
+			nextRates[id] = returnDistribution(generator);
+			values[id] = valueDistribution(generator);
+			nextValid[id / 64] |= missing(generator) ? 0 : 1ULL << (id % 64);
+			valuesValid[id / 64] |= missing(generator) ? 0 : 1ULL << (id % 64);
+		}
+		
+		StrategyColumns columns = {nextRates.data(), nextValid.data(), values.data(), valuesValid.data()};
+		
+		// Random disjoint top and bottom ten percent, in ascending order as selected.
+		vector<unsigned long> ids(size);
+		for (unsigned long id = 0; id < size; id++) {
+			ids[id] = id;
+		}
+		shuffle(ids.begin(), ids.end(), generator);
+		vector<unsigned long> top(ids.begin(), ids.begin() + size / 10);
+		vector<unsigned long> bottom(ids.begin() + size / 10, ids.begin() + 2 * (size / 10));
+		std::sort(top.begin(), top.end());
+		std::sort(bottom.begin(), bottom.end());
+		
+		unsigned long repeats = max(1UL, stocksPerSize / (2 * (size / 10)));
+		
+		for (int weighted = 0; weighted < 2; weighted++) {
+			for (int direction = REVERSAL_STRATEGY; direction <= MOMENTUM_STRATEGY; direction++) {
+				for (int legs = LONG_SHORT_LEGS; legs <= SHORT_ONLY_LEGS; legs++) {
+					
+					Strategy strategy;
+					strategy.direction = static_cast<StrategyDirection>(direction);
+					strategy.legs = static_cast<StrategyLegs>(legs);
+					
+					// Results are summed, so neither loop can be left out.
+					vector<double> rates, weights;
+					double genericSum = 0;
+					auto genericStart = chrono::steady_clock::now();
+					for (unsigned long r = 0; r < repeats; r++) {
+						genericSum += genericReturn(top, bottom, columns, strategy, weighted != 0, rates, weights);
+					}
+					chrono::duration<double, nano> genericTime = chrono::steady_clock::now() - genericStart;
+					
+					// The kernel is picked every repeat, as it is picked every month.
+					LegReturns legReturns;
+					double kernelSum = 0;
+					auto kernelStart = chrono::steady_clock::now();
+					for (unsigned long r = 0; r < repeats; r++) {
+						StrategyKernel kernel = selectKernel(strategy, weighted != 0);
+						kernelSum += kernel(top, bottom, columns, legReturns);
+					}
+					chrono::duration<double, nano> kernelTime = chrono::steady_clock::now() - kernelStart;
+					
+					// Value weights are summed in another order, so they only agree closely.
+					bool matched = fabs(genericSum - kernelSum) <= 1e-9 * max(1.0, fabs(genericSum));
+					allMatched = allMatched && matched;
+					
+					double stocks = static_cast<double>(repeats) * (top.size() + bottom.size());
+					double genericPerStock = genericTime.count() / stocks;
+					double kernelPerStock = kernelTime.count() / stocks;
+					
+					cout << setw(10) << size << setw(24) << strategy.getName() << setw(10) << (weighted != 0 ? "value" : "equal");
+					cout << fixed << setprecision(2);
+					cout << setw(18) << genericPerStock << setw(18) << kernelPerStock;
+					cout << setw(9) << genericPerStock / kernelPerStock << "x";
+					cout << (matched ? "" : "  MISMATCH") << endl;
+					cout.unsetf(ios::fixed);
+				}
+			}
+		}
+	
+	}
+	
+	return allMatched ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+//
+//  ThreadPool.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of ThreadPool class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This is default constructor which starts worker threads.
+ *
+ * @param numThreads: number of workers, 0 is regarded as 1.
+ *
+ */
+ThreadPool::ThreadPool(unsigned long numThreads) {
+	
+	unfinished = 0;
+	stopping = false;
+	
+	if (numThreads == 0) {
+		numThreads = 1;
+	}
+	
+	for (unsigned long i = 0; i < numThreads; i++) {
+		workers.push_back(thread(&ThreadPool::workerLoop, this));
+	}
+
+}
+
+/**
+ *
+ * This is destructor which lets workers finish queued tasks and joins them.
+ *
+ */
+ThreadPool::~ThreadPool() {
+	
+	{
+		lock_guard<mutex> guard(queueLock);
+		stopping = true;
+	}
+	taskReady.notify_all();
+	
+	for (thread& worker : workers) {
+		worker.join();
+	}
+
+}
+
+/**
+ *
+ * This method is private. Each worker takes tasks from the queue until the
+ * pool is stopping and the queue is empty.
+ *
+ */
+void ThreadPool::workerLoop() {
+	
+	while (true) {
+		
+		function<void()> task;
+		
+		{
+			unique_lock<mutex> guard(queueLock);
+			taskReady.wait(guard, [this] { return stopping || !tasks.empty(); });
+			
+			if (tasks.empty()) {
+				return;
+			}
+			
+			task = move(tasks.front());
+			tasks.pop();
+		}
+		
+		try {
+			task();
+		} catch (...) {
+			lock_guard<mutex> guard(queueLock);
+			if (!failure) {
+				failure = current_exception();
+			}
+		}
+		
+		{
+			lock_guard<mutex> guard(queueLock);
+			if (--unfinished == 0) {
+				allDone.notify_all();
+			}
+		}
+	
+	}
+
+}
+
+/**
+ *
+ * This method is inspector to get number of workers.
+ *
+ * return number of worker threads.
+ *
+ */
+unsigned long ThreadPool::size() const {
+	
+	return workers.size();
+
+}
+
+/**
+ *
+ * This method queues a task, which will be run by the first idle worker.
+ *
+ * @param task: a callable object without parameter and return value.
+ *
+ */
+void ThreadPool::submit(const function<void()>& task) {
+	
+	{
+		lock_guard<mutex> guard(queueLock);
+		tasks.push(task);
+		++unfinished;
+	}
+	taskReady.notify_one();
+
+}
+
+/**
+ *
+ * This method blocks until every submitted task is finished. If any task threw
+ * an exception, the first one is thrown again here.
+ *
+ */
+void ThreadPool::wait() {
+	
+	unique_lock<mutex> guard(queueLock);
+	allDone.wait(guard, [this] { return unfinished == 0; });
+	
+	if (failure) {
+		exception_ptr thrown = failure;
+		failure = nullptr;
+		rethrow_exception(thrown);
+	}
+
+}
+
+/**
+ *
+ * This method runs body for every index in [0, count). One task per worker is
+ * queued, and tasks take indices from a shared counter, so workers finishing
+ * cheap indices early keep taking more. It returns after all indices are done.
+ *
+ * @param count: number of indices.
+ * @param body: a callable object receiving an index.
+ *
+ */
+void ThreadPool::parallelFor(unsigned long count, const function<void(unsigned long)>& body) {
+	
+	shared_ptr<atomic<unsigned long>> next = make_shared<atomic<unsigned long>>(0);
+	
+	unsigned long numTasks = min(count, size());
+	for (unsigned long t = 0; t < numTasks; t++) {
+		
+		submit([next, count, &body] {
+			for (unsigned long i = (*next)++; i < count; i = (*next)++) {
+				body(i);
+			}
+		});
+	
+	}
+	
+	wait();
+
+}
+
+/**
+ *
+ * This method gets number of hardware threads of the machine.
+ *
+ * return number of cores, or 1 if it is unknown.
+ *
+ */
+unsigned long ThreadPool::defaultThreads() {
+	
+	unsigned long cores = thread::hardware_concurrency();
+	return cores == 0 ? 1 : cores;
+
+}
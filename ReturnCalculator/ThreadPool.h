@@ -0,0 +1,92 @@
+//
+//  ThreadPool.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+using namespace std;
+
+/**
+ *
+ * Thread pool class header code:
+ *
+ * This header file defines a fixed size pool of worker threads, which runs
+ * independent tasks such as portfolio formation of different months.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class keeps a queue of tasks, which are run by worker threads created
+ * once in constructor and joined in destructor.
+ *
+ * Tasks must not wait for the pool they run in, otherwise workers may deadlock.
+ * The first exception thrown by a task is kept and thrown again by wait().
+ *
+ */
+class ThreadPool {
+
+private:
+	
+	// Worker threads and tasks waiting to be run.
+	vector<thread> workers;
+	queue<function<void()>> tasks;
+	
+	// Synchronization of the task queue: workers wait on taskReady, and wait()
+	// waits on allDone until no task is queued or running.
+	mutex queueLock;
+	condition_variable taskReady;
+	condition_variable allDone;
+	unsigned long unfinished;
+	bool stopping;
+	
+	// The first exception thrown by a task since last wait().
+	exception_ptr failure;
+	
+	// The loop run by each worker thread.
+	void workerLoop();
+
+public:
+	
+	// A default constructor starting given number of workers, at least one.
+	ThreadPool(unsigned long numThreads);
+	~ThreadPool();
+	
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+	
+	// Inspector for number of workers.
+	unsigned long size() const;
+	
+	// The method queues a task to be run by a worker.
+	void submit(const function<void()>& task);
+	
+	// The method blocks until all queued tasks are finished.
+	void wait();
+	
+	// The method runs body(i) for every i in [0, count) on all workers and waits.
+	void parallelFor(unsigned long count, const function<void(unsigned long)>& body);
+	
+	// Number of threads to use when user asks for 0, i.e. all cores.
+	static unsigned long defaultThreads();
+
+};
+
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,298 @@
+//
+//  TiledPanel.cpp
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#include "TiledPanel.h"
+#include "Profiler.h"
+
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ *
+ * This cpp file contains full codes that implement all member functions
+ * of TiledPanel class.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+/**
+ *
+ * This struct owns matrix and masks of the months of a tile, and is kept alive
+ * by the panel attached to it.
+ *
+ */
+struct TileStorage {
+	
+	vector<double> columns;
+	vector<uint64_t> masks;
+
+};
+
+/**
+ *
+ * This helper reads a whole buffer at an offset of a file.
+ *
+ * return false if the buffer can't be read.
+ *
+ */
+static bool readAt(int fd, void* data, uint64_t size, uint64_t offset) {
+	
+	char* cur = static_cast<char*>(data);
+	while (size > 0) {
+		
+		ssize_t got = pread(fd, cur, size, offset);
+		if (got <= 0) {
+			return false;
+		}
+		
+		cur += got;
+		size -= got;
+		offset += got;
+	}
+	
+	return true;
+
+}
+
+/**
+ *
+ * This is default constructor of a panel without any tile.
+ *
+ */
+TiledPanel::TiledPanel() {
+	
+	header = PanelCacheHeader();
+	tileMonths = 2;
+	converted = false;
+
+}
+
+/**
+ *
+ * This method opens the cache of an input file, and reads dates and symbols of
+ * the panel. If there is no valid cache, input file is converted into one
+ * within the memory budget. Tiles take as many months as half of the budget holds.
+ *
+ * @param cache: the cache of input file.
+ * @param memoryBudget: number of bytes that tiles being processed and read may take.
+ *
+ * return false if the cache can't be written or read. It throws runtime_error on malformed input.
+ *
+ */
+bool TiledPanel::open(PanelCache& cache, unsigned long memoryBudget) {
+	
+	PROFILE_STAGE(CACHE);
+	
+	converted = false;
+	if (!cache.check(header)) {
+		
+		if (!cache.convert(memoryBudget) || !cache.check(header)) {
+			return false;
+		}
+		converted = true;
+	
+	}
+	
+	cacheName = cache.getCacheName();
+	calendar = Calendar();
+	symbols = SymbolTable();
+	
+	if (!cache.loadNames(header, calendar, symbols)) {
+		return false;
+	}
+	
+	unsigned long monthBytes = header.numSymbols * sizeof(double) + (header.numSymbols + 63) / 64 * sizeof(uint64_t);
+	tileMonths = max(2UL, memoryBudget / 2 / max(1UL, monthBytes));
+	
+	return true;
+
+}
+
+/**
+ *
+ * These methods are inspectors for number of months and symbols of the panel,
+ * number of tiles and months per tile, and whether open() converted input file.
+ *
+ */
+unsigned long TiledPanel::getNumMonths() const {
+	
+	return header.numMonths;
+
+}
+
+unsigned long TiledPanel::getNumSymbols() const {
+	
+	return header.numSymbols;
+
+}
+
+unsigned long TiledPanel::getNumTiles() const {
+	
+	if (header.numMonths < 2) {
+		return 0;
+	}
+	
+	return (header.numMonths - 1 + tileMonths - 2) / (tileMonths - 1);
+
+}
+
+unsigned long TiledPanel::getTileMonths() const {
+	
+	return tileMonths;
+
+}
+
+bool TiledPanel::wasConverted() const {
+	
+	return converted;
+
+}
+
+/**
+ *
+ * These methods are inspectors to get dates of all months, and symbols of the
+ * panel, whose IDs are the same in every tile.
+ *
+ */
+const Calendar& TiledPanel::getCalendar() const {
+	
+	return calendar;
+
+}
+
+const SymbolTable& TiledPanel::getSymbols() const {
+	
+	return symbols;
+
+}
+
+/**
+ *
+ * This method reads the months of a tile from the cache file into buffers owned
+ * by the tile, so memory of a tile is released with its panel. The file is opened
+ * for each tile, so tiles can be read by any thread.
+ *
+ * @param tile: index of the tile, less than getNumTiles().
+ * @param panel: the panel receiving months of the tile, attached to its buffers.
+ *
+ * return false if the tile can't be read.
+ *
+ */
+bool TiledPanel::loadTile(unsigned long tile, PanelData& panel) const {
+	
+	unsigned long firstMonth = tile * (tileMonths - 1);
+	if (firstMonth + 1 >= header.numMonths) {
+		return false;
+	}
+	
+	unsigned long numMonths = min(tileMonths, header.numMonths - firstMonth);
+	unsigned long numSymbols = header.numSymbols;
+	unsigned long maskWords = (numSymbols + 63) / 64;
+	
+	shared_ptr<TileStorage> storage = make_shared<TileStorage>();
+	storage->columns.resize(numMonths * numSymbols);
+	storage->masks.resize(numMonths * maskWords);
+	
+	int fd = ::open(cacheName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	
+	bool readable = readAt(fd, storage->columns.data(), storage->columns.size() * sizeof(double), header.matrixOffset + firstMonth * numSymbols * sizeof(double)) &&
+		readAt(fd, storage->masks.data(), storage->masks.size() * sizeof(uint64_t), header.maskOffset + firstMonth * maskWords * sizeof(uint64_t));
+	close(fd);
+	
+	if (!readable) {
+		return false;
+	}
+	
+	PanelData loaded;
+	for (unsigned long m = firstMonth; m < firstMonth + numMonths; m++) {
+		loaded.addMonth(calendar.getDate(m));
+	}
+	
+	loaded.attach(storage, storage->columns.data(), storage->masks.data());
+	
+	for (unsigned long s = 0; s < numSymbols; s++) {
+		loaded.addSymbol(symbols.getSymbol(s));
+	}
+	
+	panel = move(loaded);
+	
+	return true;
+
+}
+
+
+/**
+ *
+ * This function calculates results of every period of a tiled panel, one tile at
+ * a time. While periods of a tile are calculated, the next tile is read by a
+ * thread of its own, so reading overlaps computing and at most two tiles are in
+ * memory. Results of each period are the same as of the whole panel, except that
+ * turnover of the first period of a tile is not known and is left as 1.
+ *
+ * @param tiles: the tiled panel, already opened.
+ * @param numBuckets: number of buckets stocks are split into.
+ * @param allBuckets: whether to calculate results of every bucket.
+ * @param pool: thread pool to process months of a tile on, or null to process them serially.
+ * @param groups: groups of the symbols of the panel, or null to rank all stocks together.
+ * @param strategy: direction and legs of the portfolio built from top and bottom buckets.
+ *
+ * return results of every period in chronological order. It throws runtime_error if a tile can't be read.
+ *
+ */
+vector<PeriodResult> calculateTiledPeriods(const TiledPanel& tiles, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const GroupMap* groups, const Strategy& strategy) {
+	
+	vector<PeriodResult> results;
+	unsigned long numTiles = tiles.getNumTiles();
+	
+	if (numTiles == 0) {
+		return results;
+	}
+	
+	PanelData current, next;
+	if (!tiles.loadTile(0, current)) {
+		throw runtime_error("can't read tile 0 of the panel cache");
+	}
+	
+	// Reading next tile must not wait on the pool computing the current one.
+	ThreadPool reader(1);
+	
+	for (unsigned long tile = 0; tile < numTiles; tile++) {
+		
+		bool nextRead = false;
+		if (tile + 1 < numTiles) {
+			reader.submit([&tiles, &next, &nextRead, tile]() {
+				nextRead = tiles.loadTile(tile + 1, next);
+			});
+		}
+		
+		vector<PeriodResult> tileResults = calculatePeriods(current, numBuckets, allBuckets, pool, nullptr, groups, strategy);
+		results.insert(results.end(), tileResults.begin(), tileResults.end());
+		
+		reader.wait();
+		
+		if (tile + 1 < numTiles && !nextRead) {
+			throw runtime_error("can't read tile " + to_string(tile + 1) + " of the panel cache");
+		}
+		
+		current = move(next);
+		next = PanelData();
+	}
+	
+	return results;
+
+}
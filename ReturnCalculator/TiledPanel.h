@@ -0,0 +1,95 @@
+//
+//  TiledPanel.h
+//  ReturnCalculator
+//
+//  Created by Shangqi Wu on 16/3/17.
+//  Copyright © 2016 Shangqi Wu. All rights reserved.
+//
+
+#ifndef TiledPanel_h
+#define TiledPanel_h
+
+#include <string>
+#include <vector>
+#include "PanelData.h"
+#include "PanelCache.h"
+#include "MonthlyData.h"
+#include "GroupMap.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+/**
+ *
+ * Tiled panel class header code:
+ *
+ * This header file defines out-of-core access to a panel larger than memory,
+ * which is read from its cache file a tile of months at a time.
+ *
+ * @author Shangqi Wu
+ *
+ */
+
+
+/**
+ *
+ * This class reads tiles of a panel stored in its cache file "<input file>.panel",
+ * converting input file into the cache first if there is no valid one.
+ *
+ * Months of the cache are contiguous columns, so a tile of consecutive months is
+ *	read by one pread() for the matrix and one for the masks. Each tile is a panel
+ *	of its own, attached to the buffers read, with all symbols of the panel.
+ * A period needs its formation month and the next one, so consecutive tiles
+ *	share one month, and the periods of all tiles are the periods of the panel.
+ * Tiles are sized so that two of them fit in the memory budget, one being
+ *	processed while the next is read.
+ *
+ */
+class TiledPanel {
+
+private:
+	
+	// Name of the cache file and its header.
+	string cacheName;
+	PanelCacheHeader header;
+	
+	// Dates of all months, earliest first, and all symbols.
+	Calendar calendar;
+	SymbolTable symbols;
+	
+	// Number of months of each tile.
+	unsigned long tileMonths;
+	
+	// Whether input file was converted by open().
+	bool converted;
+
+public:
+	
+	// A default constructor of a panel without any tile.
+	TiledPanel();
+	
+	// The method opens the cache of an input file, converting it if needed, returns false on failure.
+	bool open(PanelCache& cache, unsigned long memoryBudget);
+	
+	// Inspectors for dimensions of the panel, number and size of tiles, and whether input file was converted.
+	unsigned long getNumMonths() const;
+	unsigned long getNumSymbols() const;
+	unsigned long getNumTiles() const;
+	unsigned long getTileMonths() const;
+	bool wasConverted() const;
+	
+	// Inspectors for dates and symbols of the panel, e.g. to load groups.
+	const Calendar& getCalendar() const;
+	const SymbolTable& getSymbols() const;
+	
+	// The method reads a tile into a panel, returns false on failure. It may be called by several threads.
+	bool loadTile(unsigned long tile, PanelData& panel) const;
+
+};
+
+
+// The function calculates results of every period of a tiled panel, reading the next tile while one is processed.
+vector<PeriodResult> calculateTiledPeriods(const TiledPanel& tiles, unsigned long numBuckets, bool allBuckets, ThreadPool* pool, const GroupMap* groups = nullptr, const Strategy& strategy = Strategy());
+
+
+#endif /* TiledPanel_h */
@@ -7,8 +7,32 @@
 //
 
 #include <iostream>
+#include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <charconv>
+#include "PanelData.h"
 #include "MonthlyData.h"
+#include "CsvReader.h"
+#include "PanelCache.h"
+#include "LongCsvReader.h"
+#include "ResultState.h"
+#include "CsvIO.h"
+#include "ThreadPool.h"
+#include "ParameterSweep.h"
+#include "Resampling.h"
+#include "BatchRunner.h"
+#include "Profiler.h"
+#include "PerformanceStats.h"
+#include "GroupMap.h"
+#include "TiledPanel.h"
+#include "QueryServer.h"
+#include "ResultCache.h"
+#include <sys/stat.h>
+#include <cerrno>
 
 using namespace std;
 
@@ -19,29 +43,421 @@ using namespace std;
  * "SP50_test.csv" format exactly. It generates output file under same directory of 
  * executable file. 
  *
- * This program keep stock return rates provided in csv file by months. Then it generates
- * top 10% and bottom 10% return rates respectively. The next step is to examine each
- * stock information in the 2 heaps, and retrieve their next month's return correspondingly.
- * At last, 2 average return rates to top 10% and bottom 10% stocks are calculated, and 
- * the program generates average monthly return by subtractin top 10% average to bottom
- * 10% average.
+ * Usage: returnCalc [--parser mmap|stream] [--cache] [--long] [--threads N]
+ *                   [--buckets N] [--sweep J,K] [--skip S]
+ *                   [--state FILE [--append]] [--bootstrap R] [--permutations R]
+ *                   [--block L] [--seed S] [--output-dir DIR]
+ *                   [--manifest FILE] [--jobs N] [--profile FILE]
+ *                   [--format csv|long|jsonl|binary] [--weights FILE]
+ *                   [--stats [--window W]] [--groups FILE] [--cost BPS]
+ *                   [--out-of-core MB] [--rebalance FREQ]
+ *                   [--strategy reversal|momentum] [--legs long-short|long|short]
+ *                   [--serve SOCKET] [--result-cache DIR]
+ *                   [input file ...]
+ * Without input file name, the program asks for it. Input file is parsed by the
+ * memory-mapped parser by default, "--parser stream" selects the line based parser.
+ * With "--cache", parsed panel is saved into "<input file>.panel" and later runs
+ * map it instead of parsing input file again, until input file changes.
+ * With "--long", input file has one "date,symbol,return" line per return rate,
+ * grouped by date with earliest month first. It is streamed month by month, and
+ * only two months are kept in memory at a time.
+ * With "--state FILE", results and latest month are saved into FILE. Adding
+ * "--append" then reads only new months from input file, calculates the new
+ * periods from saved latest month, and updates FILE and "result.csv".
+ * With "--threads N", months are processed by N threads, and 0 means all cores.
+ * With "--buckets N", stocks are split into N buckets by return rate instead of ten,
+ * and results of every bucket are written as well.
+ * With "--sweep J,K", every formation length up to J months and holding length up
+ * to K months, with S months skipped in between, are evaluated and summarized in
+ * "sweep.csv" instead of "result.csv".
+ * With "--bootstrap R" and "--permutations R", R block bootstrap and permutation
+ * replications test whether total average return differs from zero, and their
+ * confidence interval and p-values are appended to "result.csv". Bootstrap blocks
+ * hold L periods, by default the cube root of number of periods.
+ * With "--output-dir DIR", output files are written into DIR instead of current
+ * directory, and DIR is created if needed.
+ * With more than one input file, or "--manifest FILE" listing one input file per
+ * line, the program runs in batch mode without any prompt: every input file is a
+ * job processed by one of N workers ("--jobs N", 0 means all cores, the default),
+ * results of "a.csv" are written into "DIR/a_result.csv", and one JSON status
+ * line per job is printed. Exit status is 1 if any job failed.
+ * With "--profile FILE", time of every stage and counts of parsed rows and cells,
+ * missing cells, symbol lookups, return lookups and their misses, and bytes
+ * written are recorded in total and per month, and written into FILE as JSON.
+ * With "--format", results are written as long format csv "result_long.csv", JSON
+ * lines "result.jsonl" or binary "result.bin" instead of "result.csv". Significance
+ * tests are only written in csv.
+ * With "--weights FILE", averages are weighted by values in FILE, e.g. market caps,
+ * which has the same layout as input file. Stocks are weighted by their value in
+ * formation month, and matched by symbol and date.
+ * With "--stats", annualized return and volatility, Sharpe ratio, t-statistic,
+ * maximum drawdown and hit rate of top, bottom and total returns are written into
+ * "stats.csv", followed by the same statistics of total return over every window
+ * of W months ("--window W", 12 by default, 0 for none).
+ * With "--groups FILE", stocks are ranked within groups, e.g. sectors, listed in
+ * FILE as one "symbol,group" line per company, and top and bottom buckets of every
+ * group are combined. Groups of a month are ranked by the threads in parallel.
+ * With "--cost BPS", turnover of top and bottom buckets between consecutive
+ * formation months, and average returns net of BPS basis points of trading costs
+ * per unit of turnover, are written into "costs.csv".
+ * With "--out-of-core MB", the panel is never held in memory as a whole: input
+ * file is converted once into "<input file>.panel" in batches of rows, and tiles
+ * of consecutive months that fit in MB megabytes are read from it in turn, the
+ * next tile being read while the current one is processed.
+ * Dates in header line are monthly as "16-Mar" or "2016-03", or daily or weekly
+ * as "2016-03-16". With "--rebalance FREQ", return rates of input periods are
+ * compounded into rebalancing periods, "weekly", "monthly", "quarterly", "yearly"
+ * or every N periods, and stocks are ranked and held over those instead.
+ * With "--strategy momentum", the top bucket is bought and the bottom one sold
+ * instead of the opposite, and with "--legs long" or "--legs short" only the
+ * bought or sold bucket is held, so total return is its average return, negated
+ * when sold. Trading costs then count turnover of the held buckets only.
+ * With "--serve SOCKET", the program runs as a daemon: every input file, and values
+ * of "--weights", are loaded once, and queries of local clients on Unix domain socket
+ * SOCKET are answered by N workers ("--jobs N") until a client shuts it down. Each
+ * query gives its own buckets, windows, date range, weighting and strategy, and its
+ * latency is logged. The protocol is described in QueryServer.h.
+ * With "--result-cache DIR", results of every run are kept in DIR, keyed by hashes
+ * of the contents of input, weights and groups files and by the parameters. A run
+ * which was done before writes its output files from DIR without parsing input
+ * file, and a run which only changes weights or strategy reuses the rankings of
+ * every month.
+ *
+ * This program keeps stock return rates provided in csv file in a panel, which is viewed
+ * month by month through MonthlyData class. Every month, top 10% and bottom 10% return
+ * rate stocks are selected in linear time from the panel column, and their symbol IDs
+ * are kept. Next month's return rates of the selected stocks are then looked up in the
+ * next column by ID. At last, average return rates of top 10% and bottom 10% stocks are
+ * calculated, and the program generates average monthly return by subtracting top 10%
+ * average from bottom 10% average.
  *
  * @author Shangqi Wu
  *
  */
 
 // Signatures for input and output sub programs.
-list<MonthlyData> parseInput(ifstream& inputFile);
-void writeCsv(ofstream& outputFile, const list<MonthlyData>& allData);
+void reportThroughput(const string& stage, unsigned long bytes, double seconds);
+void reportReplications(const string& test, unsigned long count, double seconds);
+void printUsage();
+template <class Number> bool parseNumber(const string& option, const string& text, Number& value);
+bool makeDirectory(const string& directory);
+bool writeStatisticsFile(const string& fileName, const vector<PeriodResult>& results, unsigned long numBuckets, unsigned long window);
+bool writeCostsFile(const string& fileName, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets, double costBps, const Strategy& strategy);
 
 
 // Main entry point of the program. 
 int main(int argc, const char * argv[]) {
 	
-	// Open csv file and parse input data into MonthlyData class.
+	// Read command line options.
 	string inputFileName;
+	vector<string> inputFileNames;
+	string manifestFileName;
+	string outputDirectory = ".";
+	unsigned long numJobs = ThreadPool::defaultThreads();
+	string serveSocket;
+	string resultCacheDirectory;
+	string profileFileName;
+	OutputFormat outputFormat = CSV_OUTPUT;
+	string weightsFileName;
+	string groupsFileName;
+	bool writeStats = false;
+	bool tradingCosts = false;
+	double costBps = 0;
+	unsigned long memoryBudget = 0;
+	bool rebalancing = false;
+	RebalanceFrequency rebalanceFrequency = PERIOD_REBALANCE;
+	unsigned long rebalanceEvery = 1;
+	Strategy strategy;
+	bool customStrategy = false;
+	unsigned long statsWindow = 12;
+	bool useStreamParser = false;
+	bool useCache = false;
+	bool longFormat = false;
+	string stateFileName;
+	bool appendMode = false;
+	unsigned long numThreads = 1;
+	unsigned long numBuckets = 10;
+	bool allBuckets = false;
+	unsigned long sweepFormation = 0, sweepHolding = 0, skipMonths = 0;
+	unsigned long numBootstrap = 0, numPermutations = 0, blockLength = 0, seed = 1;
+	
+	for (int i = 1; i < argc; i++) {
+		
+		string option = argv[i];
+		
+		if (option == "--parser" && i + 1 < argc) {
+			string parser = argv[++i];
+			if (parser != "mmap" && parser != "stream") {
+				cout << "Unknown parser: " << parser << endl;
+				printUsage();
+				return 1;
+			}
+			useStreamParser = (parser == "stream");
+		} else if (option == "--cache") {
+			useCache = true;
+		} else if (option == "--long") {
+			longFormat = true;
+		} else if (option == "--state" && i + 1 < argc) {
+			stateFileName = argv[++i];
+		} else if (option == "--append") {
+			appendMode = true;
+		} else if (option == "--threads" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], numThreads)) {
+				return 1;
+			}
+			if (numThreads == 0) {
+				numThreads = ThreadPool::defaultThreads();
+			}
+		} else if (option == "--buckets" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], numBuckets)) {
+				return 1;
+			}
+			numBuckets = max(1UL, numBuckets);
+			allBuckets = true;
+		} else if (option == "--sweep" && i + 1 < argc) {
+			string grid = argv[++i];
+			unsigned long comma = grid.find(',');
+			if (!parseNumber(option, grid.substr(0, comma), sweepFormation)) {
+				return 1;
+			}
+			sweepHolding = sweepFormation;
+			if (comma != string::npos && !parseNumber(option, grid.substr(comma + 1), sweepHolding)) {
+				return 1;
+			}
+			sweepFormation = max(1UL, sweepFormation);
+			sweepHolding = max(1UL, sweepHolding);
+		} else if (option == "--skip" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], skipMonths)) {
+				return 1;
+			}
+		} else if (option == "--bootstrap" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], numBootstrap)) {
+				return 1;
+			}
+		} else if (option == "--permutations" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], numPermutations)) {
+				return 1;
+			}
+		} else if (option == "--block" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], blockLength)) {
+				return 1;
+			}
+		} else if (option == "--seed" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], seed)) {
+				return 1;
+			}
+		} else if (option == "--output-dir" && i + 1 < argc) {
+			outputDirectory = argv[++i];
+		} else if (option == "--manifest" && i + 1 < argc) {
+			manifestFileName = argv[++i];
+		} else if (option == "--profile" && i + 1 < argc) {
+			profileFileName = argv[++i];
+		} else if (option == "--weights" && i + 1 < argc) {
+			weightsFileName = argv[++i];
+		} else if (option == "--groups" && i + 1 < argc) {
+			groupsFileName = argv[++i];
+		} else if (option == "--cost" && i + 1 < argc) {
+			tradingCosts = true;
+			if (!parseNumber(option, argv[++i], costBps)) {
+				return 1;
+			}
+		} else if (option == "--out-of-core" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], memoryBudget)) {
+				return 1;
+			}
+			memoryBudget = max(1UL, memoryBudget) * 1024 * 1024;
+		} else if (option == "--rebalance" && i + 1 < argc) {
+			if (!parseRebalance(argv[++i], rebalanceFrequency, rebalanceEvery)) {
+				cout << "Unknown rebalancing frequency: " << argv[i] << endl;
+				return 1;
+			}
+			rebalancing = true;
+		} else if (option == "--strategy" && i + 1 < argc) {
+			if (!parseDirection(argv[++i], strategy.direction)) {
+				cout << "Unknown strategy: " << argv[i] << endl;
+				return 1;
+			}
+			customStrategy = true;
+		} else if (option == "--legs" && i + 1 < argc) {
+			if (!parseLegs(argv[++i], strategy.legs)) {
+				cout << "Unknown legs: " << argv[i] << endl;
+				return 1;
+			}
+			customStrategy = true;
+		} else if (option == "--stats") {
+			writeStats = true;
+		} else if (option == "--window" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], statsWindow)) {
+				return 1;
+			}
+		} else if (option == "--format" && i + 1 < argc) {
+			if (!parseOutputFormat(argv[++i], outputFormat)) {
+				cout << "Unknown output format: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (option == "--serve" && i + 1 < argc) {
+			serveSocket = argv[++i];
+		} else if (option == "--result-cache" && i + 1 < argc) {
+			resultCacheDirectory = argv[++i];
+		} else if (option == "--jobs" && i + 1 < argc) {
+			if (!parseNumber(option, argv[++i], numJobs)) {
+				return 1;
+			}
+			if (numJobs == 0) {
+				numJobs = ThreadPool::defaultThreads();
+			}
+		} else if (option.compare(0, 2, "--") == 0) {
+			cout << "Unknown option or missing value: " << option << endl;
+			printUsage();
+			return 1;
+		} else {
+			inputFileName = option;
+			inputFileNames.push_back(option);
+		}
+	
+	}
+	
+	// The report is written when main function returns.
+	ProfileReport profileReport(profileFileName);
+	
+	if (!makeDirectory(outputDirectory)) {
+		cout << "Can't create output directory: " << outputDirectory << endl;
+		return 1;
+	}
+	
+	string resultFileName = outputDirectory + "/result" + getOutputSuffix(outputFormat);
+	
+	if (outputFormat != CSV_OUTPUT && (numBootstrap > 0 || numPermutations > 0)) {
+		cout << "\"--bootstrap\" and \"--permutations\" results are only written with \"--format csv\"." << endl;
+		return 1;
+	}
+	
+	if (rebalancing && (longFormat || !stateFileName.empty() || appendMode || memoryBudget > 0 || !manifestFileName.empty() || inputFileNames.size() > 1)) {
+		cout << "\"--rebalance\" needs all periods in memory, it can't be used with \"--long\", \"--state\", \"--append\", \"--out-of-core\" or in batch mode." << endl;
+		return 1;
+	}
+	
+	if (customStrategy && (longFormat || !stateFileName.empty() || appendMode || sweepFormation > 0 || numPermutations > 0)) {
+		cout << "\"--strategy\" and \"--legs\" can't be used with \"--long\", \"--state\", \"--append\", \"--sweep\" or \"--permutations\", which calculate bottom minus top bucket." << endl;
+		return 1;
+	}
+	
+	if (!resultCacheDirectory.empty() && (longFormat || !stateFileName.empty() || appendMode || sweepFormation > 0 || numBootstrap > 0 || numPermutations > 0 || memoryBudget > 0 || !serveSocket.empty() || !manifestFileName.empty() || inputFileNames.size() > 1)) {
+		cout << "\"--result-cache\" keeps results of single runs, it can't be used with \"--long\", \"--state\", \"--append\", \"--sweep\", \"--bootstrap\", \"--permutations\", \"--out-of-core\", \"--serve\" or in batch mode." << endl;
+		return 1;
+	}
+	
+	// Daemon mode loads every input file once, and answers queries until shut down.
+	if (!serveSocket.empty()) {
+		
+		if (inputFileNames.empty()) {
+			cout << "\"--serve\" needs input files to serve." << endl;
+			return 1;
+		}
+		
+		if (longFormat || !stateFileName.empty() || appendMode || sweepFormation > 0 || numBootstrap > 0 || numPermutations > 0 || !manifestFileName.empty() || writeStats || !groupsFileName.empty() || tradingCosts || memoryBudget > 0 || rebalancing || customStrategy) {
+			cout << "\"--serve\" takes parameters from each query, it can't be used with \"--long\", \"--state\", \"--append\", \"--sweep\", \"--bootstrap\", \"--permutations\", \"--manifest\", \"--stats\", \"--groups\", \"--cost\", \"--out-of-core\", \"--rebalance\", \"--strategy\" or \"--legs\"." << endl;
+			return 1;
+		}
+		
+		QueryServer server(serveSocket);
+		PanelData values;
+		unsigned long inputSize = 0;
+		
+		try {
+			
+			if (!weightsFileName.empty()) {
+				PanelCache valueCache(weightsFileName);
+				if (loadPanel(weightsFileName, useStreamParser, useCache ? &valueCache : nullptr, values, inputSize) != PANEL_CACHE && useCache && !valueCache.save(values)) {
+					cout << "Can't write panel cache: " << valueCache.getCacheName() << endl;
+				}
+			}
+			
+			for (const string& name : inputFileNames) {
+				
+				PanelData panel;
+				PanelCache cache(name);
+				auto loadStart = chrono::steady_clock::now();
+				PanelSource source = loadPanel(name, useStreamParser, useCache ? &cache : nullptr, panel, inputSize);
+				chrono::duration<double> loadTime = chrono::steady_clock::now() - loadStart;
+				
+				reportThroughput(name, inputSize, loadTime.count());
+				
+				if (useCache && source != PANEL_CACHE && !cache.save(panel)) {
+					cout << "Can't write panel cache: " << cache.getCacheName() << endl;
+				}
+				
+				server.addPanel(name, move(panel), weightsFileName.empty() ? nullptr : &values);
+			}
+		
+		} catch (const exception& error) {
+			cout << "Can't parse input file: " << error.what() << endl;
+			return 1;
+		}
+		
+		cout << "serving " << server.getNumPanels() << " panels on " << serveSocket << " with " << numJobs << " workers" << endl;
+		
+		if (!server.run(numJobs, cout)) {
+			cout << "Can't listen on socket: " << serveSocket << endl;
+			return 1;
+		}
+		
+		return 0;
+	}
+	
+	// Batch mode processes every input file as a job, and never prompts.
+	if (!manifestFileName.empty() || inputFileNames.size() > 1) {
+		
+		if (sweepFormation > 0 || !stateFileName.empty() || appendMode || !weightsFileName.empty() || writeStats || !groupsFileName.empty() || tradingCosts || memoryBudget > 0) {
+			cout << "\"--sweep\", \"--state\", \"--append\", \"--weights\", \"--stats\", \"--groups\", \"--cost\" and \"--out-of-core\" can't be used in batch mode." << endl;
+			return 1;
+		}
+		
+		BatchSettings settings;
+		settings.longFormat = longFormat;
+		settings.useStreamParser = useStreamParser;
+		settings.useCache = useCache;
+		settings.numBuckets = numBuckets;
+		settings.allBuckets = allBuckets;
+		settings.strategy = strategy;
+		settings.numBootstrap = numBootstrap;
+		settings.numPermutations = numPermutations;
+		settings.blockLength = blockLength;
+		settings.seed = seed;
+		settings.format = outputFormat;
+		
+		BatchRunner batch(settings, outputDirectory);
+		for (const string& name : inputFileNames) {
+			batch.addInput(name);
+		}
+		
+		if (!manifestFileName.empty() && !batch.addManifest(manifestFileName)) {
+			cout << "Can't read manifest file: " << manifestFileName << endl;
+			return 1;
+		}
+		
+		return batch.run(numJobs, cout) > 0 ? 1 : 0;
+	}
+	
+	if (customStrategy) {
+		cout << "strategy: " << strategy.getName() << endl;
+	}
+	
+	// Open csv file and parse input data into MonthlyData class.
 	ifstream inputFile;
-	cout << "Please enter input file name:" << endl;
+	
+	if (!inputFileName.empty()) {
+		
+		inputFile.open(inputFileName.c_str());
+		
+		if (!inputFile.is_open()) {
+			cout << "File not found: " << inputFileName << endl;
+			return 1;
+		}
+	
+	} else {
+		cout << "Please enter input file name:" << endl;
+	}
 	
 	while (!inputFile.is_open()) {
 		
@@ -49,46 +465,504 @@ int main(int argc, const char * argv[]) {
 			return 0;
 		}
 		
-		cin >> inputFileName;
+		// Nothing more to read, e.g. when input is not a terminal.
+		if (!(cin >> inputFileName)) {
+			return 1;
+		}
+		
 		inputFile.open(inputFileName.c_str());
 		
 		if (!inputFile.is_open()) {
 			cout << "File not found. Please enter a valid file name,";
 			cout << " or type \"q\" to quit." << endl;
 		}
-
+	
+	}
+	
+	// Out-of-core mode processes the panel a tile of months at a time.
+	if (memoryBudget > 0) {
+		
+		inputFile.close();
+		
+		if (longFormat || !stateFileName.empty() || appendMode || sweepFormation > 0 || numBootstrap > 0 || numPermutations > 0 || !weightsFileName.empty() || tradingCosts) {
+			cout << "\"--long\", \"--state\", \"--append\", \"--sweep\", \"--bootstrap\", \"--permutations\", \"--weights\" and \"--cost\" can't be used with \"--out-of-core\"." << endl;
+			return 1;
+		}
+		
+		PanelCache cache(inputFileName);
+		TiledPanel tiles;
+		auto openStart = chrono::steady_clock::now();
+		
+		try {
+			
+			if (!tiles.open(cache, memoryBudget)) {
+				cout << "Can't write panel cache: " << cache.getCacheName() << endl;
+				return 1;
+			}
+		
+		} catch (const exception& error) {
+			cout << "Can't parse input file: " << error.what() << endl;
+			return 1;
+		}
+		
+		if (tiles.wasConverted()) {
+			chrono::duration<double> openTime = chrono::steady_clock::now() - openStart;
+			struct stat status;
+			reportThroughput("out-of-core conversion", stat(inputFileName.c_str(), &status) == 0 ? status.st_size : 0, openTime.count());
+		}
+		
+		cout << "out-of-core: " << tiles.getNumTiles() << " tiles of up to " << tiles.getTileMonths() << " months, " << tiles.getNumSymbols() << " symbols" << endl;
+		
+		GroupMap groups;
+		
+		if (!groupsFileName.empty()) {
+			
+			if (!groups.load(groupsFileName, tiles.getSymbols())) {
+				cout << "Can't read groups file: " << groupsFileName << endl;
+				return 1;
+			}
+			
+			cout << "groups: " << groups.getNumGroups() << " groups, " << groups.getNumMapped() << " of " << tiles.getNumSymbols() << " symbols ranked" << endl;
+		
+		}
+		
+		unique_ptr<ThreadPool> pool;
+		if (numThreads > 1) {
+			pool.reset(new ThreadPool(numThreads));
+		}
+		
+		vector<PeriodResult> results;
+		
+		try {
+			results = calculateTiledPeriods(tiles, numBuckets, allBuckets, pool.get(), groupsFileName.empty() ? nullptr : &groups, strategy);
+		} catch (const exception& error) {
+			cout << "Can't read panel cache: " << error.what() << endl;
+			return 1;
+		}
+		
+		ResultWriter writer;
+		
+		if (!writer.open(resultFileName)) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		writeResults(writer, outputFormat, results, numBuckets, allBuckets);
+		
+		if (!writer.close()) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		if (writeStats && !writeStatisticsFile(outputDirectory + "/stats.csv", results, numBuckets, statsWindow)) {
+			cout << "Can't write statistics file." << endl;
+			return 1;
+		}
+		
+		return 0;
+	}
+	
+	// Append mode only reads new months, and calculates periods starting from saved latest month.
+	if (appendMode) {
+		
+		inputFile.close();
+		
+		if (stateFileName.empty()) {
+			cout << "\"--append\" needs a state file given by \"--state\"." << endl;
+			return 1;
+		}
+		
+		if (numBootstrap > 0 || numPermutations > 0 || !weightsFileName.empty() || !groupsFileName.empty() || tradingCosts) {
+			cout << "\"--bootstrap\", \"--permutations\", \"--weights\", \"--groups\" and \"--cost\" need all months in memory, they can't be used with \"--append\"." << endl;
+			return 1;
+		}
+		
+		ResultState state(numBuckets, allBuckets);
+		if (!state.load(stateFileName)) {
+			cout << "Can't read state file: " << stateFileName << endl;
+			return 1;
+		}
+		
+		unsigned long numPeriods = state.getResults().size();
+		
+		try {
+			
+			if (longFormat) {
+				
+				LongCsvReader reader(inputFileName);
+				LongMonth month;
+				while (reader.readMonth(month)) {
+					state.append(month, reader.getSymbols());
+				}
+			
+			} else {
+				
+				CsvReader reader(inputFileName);
+				
+				if (!reader.isOpen()) {
+					cout << "Can't map input file: " << inputFileName << endl;
+					return 1;
+				}
+				
+				PanelData newMonths;
+				reader.parse(newMonths);
+				state.append(newMonths);
+			
+			}
+		
+		} catch (const exception& error) {
+			cout << "Can't parse input file: " << error.what() << endl;
+			return 1;
+		}
+		
+		const vector<PeriodResult>& results = state.getResults();
+		for (unsigned long m = numPeriods; m < results.size(); m++) {
+			cout << "Appended period " << results[m].date << ": " << results[m].average << endl;
+		}
+		cout << "Total average return of all period: " << state.getAverageReturn() << endl;
+		
+		if (!state.save(stateFileName)) {
+			cout << "Can't write state file: " << stateFileName << endl;
+			return 1;
+		}
+		
+		ResultWriter writer;
+		
+		if (!writer.open(resultFileName)) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		writeResults(writer, outputFormat, results, state.getNumBuckets(), state.hasAllBuckets());
+		
+		if (!writer.close()) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		
+		if (writeStats && !writeStatisticsFile(outputDirectory + "/stats.csv", results, state.getNumBuckets(), statsWindow)) {
+			cout << "Can't write statistics file." << endl;
+			return 1;
+		}
+		
+		return 0;
 	}
 	
-	// Call to input parsing function.
-	list<MonthlyData> allData = parseInput(inputFile);
+	// Long format input is processed while being read, without a panel of all months.
+	if (longFormat) {
+		
+		inputFile.close();
+		
+		if (useCache || sweepFormation > 0 || numBootstrap > 0 || numPermutations > 0 || !weightsFileName.empty() || !groupsFileName.empty() || tradingCosts) {
+			cout << "\"--cache\", \"--sweep\", \"--bootstrap\", \"--permutations\", \"--weights\", \"--groups\" and \"--cost\" need all months in memory, they can't be used with \"--long\"." << endl;
+			return 1;
+		}
+		
+		LongCsvReader reader(inputFileName);
+		vector<PeriodResult> results;
+		LongMonth latest;
+		auto streamStart = chrono::steady_clock::now();
+		
+		try {
+			processLongInput(reader, numBuckets, allBuckets, results, latest);
+		} catch (const exception& error) {
+			cout << "Can't parse input file: " << error.what() << endl;
+			return 1;
+		}
+		
+		chrono::duration<double> streamTime = chrono::steady_clock::now() - streamStart;
+		reportThroughput("long format stream", reader.getBytesRead(), streamTime.count());
+		
+		if (!stateFileName.empty()) {
+			
+			ResultState state(numBuckets, allBuckets);
+			state.reset(reader.getSymbols(), latest, results);
+			
+			if (!state.save(stateFileName)) {
+				cout << "Can't write state file: " << stateFileName << endl;
+			}
+		
+		}
+		
+		ResultWriter writer;
+		
+		if (!writer.open(resultFileName)) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		writeResults(writer, outputFormat, results, numBuckets, allBuckets);
+		
+		if (!writer.close()) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		
+		if (writeStats && !writeStatisticsFile(outputDirectory + "/stats.csv", results, numBuckets, statsWindow)) {
+			cout << "Can't write statistics file." << endl;
+			return 1;
+		}
+		
+		return 0;
+	}
+	
+	// Call to input parsing function, and time it. A valid cache replaces parsing.
 	inputFile.close();
 	
-	// Process helps to generate next month's return.
-	list<MonthlyData>::iterator curMonth = allData.end();
-	--curMonth;
+	// Results of an earlier run with the same input contents and parameters replace the whole run.
+	ResultCache resultCache(resultCacheDirectory);
+	bool useResultCache = false;
+	
+	if (!resultCacheDirectory.empty()) {
+		
+		if (!makeDirectory(resultCacheDirectory)) {
+			cout << "Can't create result cache directory: " << resultCacheDirectory << endl;
+			return 1;
+		}
+		
+		ResultParameters parameters;
+		parameters.inputFileName = inputFileName;
+		parameters.weightsFileName = weightsFileName;
+		parameters.groupsFileName = groupsFileName;
+		parameters.numBuckets = numBuckets;
+		parameters.allBuckets = allBuckets;
+		parameters.rebalanceFrequency = rebalanceFrequency;
+		parameters.rebalanceEvery = rebalanceEvery;
+		parameters.strategy = strategy;
+		
+		vector<PeriodResult> results;
+		auto lookupStart = chrono::steady_clock::now();
+		useResultCache = resultCache.setParameters(parameters);
+		
+		if (useResultCache && resultCache.loadResults(results)) {
+			
+			chrono::duration<double> lookupTime = chrono::steady_clock::now() - lookupStart;
+			cout << "result cache: " << results.size() << " periods from " << resultCache.getResultName() << " in " << lookupTime.count() << " s" << endl;
+			
+			ResultWriter writer;
+			
+			if (!writer.open(resultFileName)) {
+				cout << "Can't write output file." << endl;
+				return 1;
+			}
+			
+			writeResults(writer, outputFormat, results, numBuckets, allBuckets);
+			
+			if (!writer.close()) {
+				cout << "Can't write output file." << endl;
+				return 1;
+			}
+			
+			if (writeStats && !writeStatisticsFile(outputDirectory + "/stats.csv", results, numBuckets, statsWindow)) {
+				cout << "Can't write statistics file." << endl;
+				return 1;
+			}
+			
+			if (tradingCosts && !writeCostsFile(outputDirectory + "/costs.csv", results, numBuckets, allBuckets, costBps, strategy)) {
+				cout << "Can't write costs file." << endl;
+				return 1;
+			}
+			
+			return 0;
+		}
+	
+	}
+	
+	PanelData panel;
+	PanelCache cache(inputFileName);
+	unsigned long inputSize = 0;
+	PanelSource source;
+	auto parseStart = chrono::steady_clock::now();
+	
+	try {
+		source = loadPanel(inputFileName, useStreamParser, useCache ? &cache : nullptr, panel, inputSize);
+	} catch (const exception& error) {
+		cout << "Can't parse input file: " << error.what() << endl;
+		return 1;
+	}
+	
+	chrono::duration<double> parseTime = chrono::steady_clock::now() - parseStart;
+	reportThroughput(source == PANEL_CACHE ? "panel cache" : (source == STREAM_PARSER ? "stream parser" : "mmap parser"), inputSize, parseTime.count());
+	
+	if (useCache && source != PANEL_CACHE && !cache.save(panel)) {
+		cout << "Can't write panel cache: " << cache.getCacheName() << endl;
+	}
+	
+	// Periods of input data are compounded into rebalancing periods, e.g. days into months.
+	if (rebalancing) {
+		
+		unsigned long numPeriods = panel.getNumMonths();
+		panel = panel.resample(panel.getCalendar().getRebalanceEnds(rebalanceFrequency, rebalanceEvery));
+		
+		cout << "rebalance: " << numPeriods << " periods into " << panel.getNumMonths() << " rebalancing periods" << endl;
+	
+	}
+	
+	// Values to weight stocks by are loaded the same way, then laid out like the panel.
+	PanelData weights;
+	
+	if (!weightsFileName.empty()) {
+		
+		if (sweepFormation > 0 || !stateFileName.empty()) {
+			cout << "\"--weights\" can't be used with \"--sweep\" or \"--state\"." << endl;
+			return 1;
+		}
+		
+		PanelData values;
+		PanelCache valueCache(weightsFileName);
+		auto weightsStart = chrono::steady_clock::now();
+		
+		try {
+			source = loadPanel(weightsFileName, useStreamParser, useCache ? &valueCache : nullptr, values, inputSize);
+		} catch (const exception& error) {
+			cout << "Can't parse weights file: " << error.what() << endl;
+			return 1;
+		}
+		
+		if (useCache && source != PANEL_CACHE && !valueCache.save(values)) {
+			cout << "Can't write panel cache: " << valueCache.getCacheName() << endl;
+		}
+		
+		weights = values.alignTo(panel);
+		
+		chrono::duration<double> weightsTime = chrono::steady_clock::now() - weightsStart;
+		reportThroughput("weights", inputSize, weightsTime.count());
+	
+	}
+	
+	// Groups which stocks are ranked within, matched to the panel by symbol.
+	GroupMap groups;
+	
+	if (!groupsFileName.empty()) {
+		
+		if (sweepFormation > 0 || !stateFileName.empty() || numPermutations > 0) {
+			cout << "\"--groups\" can't be used with \"--sweep\", \"--state\" or \"--permutations\"." << endl;
+			return 1;
+		}
+		
+		if (!groups.load(groupsFileName, panel.getSymbols())) {
+			cout << "Can't read groups file: " << groupsFileName << endl;
+			return 1;
+		}
+		
+		cout << "groups: " << groups.getNumGroups() << " groups, " << groups.getNumMapped() << " of " << panel.getNumSymbols() << " symbols ranked" << endl;
+	
+	}
 	
-	while (curMonth != allData.begin()) {
+	// Sweep of formation and holding lengths replaces the single 1 x 1 run.
+	if (sweepFormation > 0) {
+		
+		if (writeStats || tradingCosts) {
+			cout << "\"--stats\" and \"--cost\" can't be used with \"--sweep\", which summarizes every pair of lengths in \"sweep.csv\"." << endl;
+			return 1;
+		}
+		
+		ParameterSweep sweep(panel, numBuckets);
 		
-		list<MonthlyData>::iterator nextMonth = curMonth;
-		--nextMonth;
+		if (numThreads > 1) {
+			ThreadPool pool(numThreads);
+			sweep.run(sweepFormation, sweepHolding, skipMonths, &pool);
+		} else {
+			sweep.run(sweepFormation, sweepHolding, skipMonths, nullptr);
+		}
+		
+		ResultWriter writer;
+		
+		if (!writer.open(outputDirectory + "/sweep.csv")) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
+		
+		sweep.writeCsv(writer);
 		
-		curMonth->getMonthReturn(nextMonth);
-		curMonth = nextMonth;
+		if (!writer.close()) {
+			cout << "Can't write output file." << endl;
+			return 1;
+		}
 		
+		return 0;
+	}
+	
+	// Process helps to generate next month's return of every period. The same
+	// threads run significance tests afterwards.
+	unique_ptr<ThreadPool> pool;
+	if (numThreads > 1) {
+		pool.reset(new ThreadPool(numThreads));
+	}
+	
+	// Rankings of an earlier run with the same input, buckets and groups replace ranking every month.
+	vector<BucketSelection> selections;
+	bool rankedBefore = useResultCache && resultCache.loadSelections(panel.getNumMonths() == 0 ? 0 : panel.getNumMonths() - 1, panel.getNumSymbols(), allBuckets ? numBuckets : 2, selections);
+	
+	if (rankedBefore) {
+		cout << "result cache: rankings of " << selections.size() << " periods from " << resultCache.getRankingName() << endl;
+	}
+	
+	vector<PeriodResult> results = calculatePeriods(panel, numBuckets, allBuckets, pool.get(), weightsFileName.empty() ? nullptr : &weights, groupsFileName.empty() ? nullptr : &groups, strategy, useResultCache ? &selections : nullptr);
+	unsigned long numPeriods = results.size();
+	
+	if (useResultCache && ((!rankedBefore && !resultCache.saveSelections(selections)) || !resultCache.saveResults(results))) {
+		cout << "Can't write result cache: " << resultCacheDirectory << endl;
 	}
 	
 	// Process to generate output csv file.
-	string outputFileName = "./result.csv";
-	ofstream outputFile(outputFileName);
+	ResultWriter writer;
+	
+	if (!writer.open(resultFileName)) {
+		cout << "Can't write output file." << endl;
+		return 1;
+	}
+	
+	writeResults(writer, outputFormat, results, numBuckets, allBuckets);
+	
+	// Significance tests reuse the panel, and their rows follow the results.
+	if (numBootstrap > 0 || numPermutations > 0) {
+		
+		Resampling resampling(panel, numBuckets, results);
+		resampling.setBlockLength(blockLength);
+		resampling.setSeed(seed);
+		resampling.setWeights(weightsFileName.empty() ? nullptr : &weights);
+		
+		if (numBootstrap > 0) {
+			resampling.bootstrap(numBootstrap, pool.get());
+			reportReplications("bootstrap", numBootstrap, resampling.getBootstrapSeconds());
+		}
+		
+		if (numPermutations > 0) {
+			resampling.permute(numPermutations, pool.get());
+			reportReplications("permutation", numPermutations, resampling.getPermutationSeconds());
+		}
+		
+		resampling.writeCsv(writer, numPeriods + 1);
+	}
 	
-	if (!outputFile.is_open()) {
+	if (!writer.close()) {
 		cout << "Can't write output file." << endl;
 		return 1;
 	}
 	
-	writeCsv(outputFile, allData);
+	if (writeStats && !writeStatisticsFile(outputDirectory + "/stats.csv", results, numBuckets, statsWindow)) {
+		cout << "Can't write statistics file." << endl;
+		return 1;
+	}
+	
+	if (tradingCosts && !writeCostsFile(outputDirectory + "/costs.csv", results, numBuckets, allBuckets, costBps, strategy)) {
+		cout << "Can't write costs file." << endl;
+		return 1;
+	}
 	
-	outputFile.close();
+	if (!stateFileName.empty()) {
+		
+		ResultState state(numBuckets, allBuckets);
+		state.reset(panel, results);
+		
+		if (!state.save(stateFileName)) {
+			cout << "Can't write state file: " << stateFileName << endl;
+		}
+	
+	}
 	
 	return 0;
 }
@@ -96,162 +970,188 @@ int main(int argc, const char * argv[]) {
 
 /**
  *
- * This function accepts input file stream and parse the text data, converts 
- * data into a list of MonthlyData class. 
+ * This function prints processing speed of a stage in MB/s.
  *
- * @param inputFile: an opened ifstream object. This function does not check if 
- *			it is open or not, please check it in main function.
+ * @param stage: name of the stage to be reported.
+ * @param bytes: number of bytes processed.
+ * @param seconds: elapsed wall-clock time.
  *
- * return generated a STL linked list of MonthlyData objects.
+ * This function does not return any value.
  *
  */
-list<MonthlyData> parseInput(ifstream& inputFile) {
+void reportThroughput(const string& stage, unsigned long bytes, double seconds) {
 	
-	list<MonthlyData> allData;
+	double megabytes = bytes / (1024.0 * 1024.0);
+	double throughput = seconds > 0 ? megabytes / seconds : 0;
 	
-	// Template string stores each line in csv file.
-	string line;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
 	
-	// Processing month & year: assuming they are in format of
-	// "16-Mar".
-	getline(inputFile, line);
-	int lineSize = static_cast<int>(line.size());
+	cout << fixed << setprecision(3);
+	cout << stage << ": " << megabytes << " MB in " << seconds << " s, ";
+	cout << setprecision(1) << throughput << " MB/s" << endl;
 	
-	for (int i = 1; i < lineSize; i += 7) {
-		string year = line.substr(i, 2);
-		string month = line.substr(i + 3, 3);
-		
-		allData.push_back(MonthlyData(year, month));
-	}
+	cout.flags(flags);
+	cout.precision(precision);
+
+}
+
+
+/**
+ *
+ * This function prints speed of significance test replications.
+ *
+ * @param test: name of the test to be reported.
+ * @param count: number of replications.
+ * @param seconds: elapsed wall-clock time.
+ *
+ * This function does not return any value.
+ *
+ */
+void reportReplications(const string& test, unsigned long count, double seconds) {
 	
-	// Process of real data till to the end of input file.
-	while (getline(inputFile, line)) {
-		int left = 0, right = 0;
-		lineSize = static_cast<int>(line.size());
-		
-		// Skip empty lines.
-		if (line.empty() || line[0] == ',') {
-			continue;
-		}
-		
-		string symbol;
-		list<MonthlyData>::iterator curMonth = allData.begin();
-		while (right <= lineSize) {
-			
-			if (right == lineSize || line[right] == ',') {
-				
-				string content = line.substr(left, right - left);
-				
-				// Handle different new line character in Windows and Linux/Unix.
-				if (content.back() == '\r') {
-					content.pop_back();
-				}
-				
-				// Set stock symbol or return rate.
-				if (symbol.empty()) {
-					symbol = content;
-				} else {
-					
-					double value = 0;
-					// Some data marked as "#N/A" will be kept as 0.
-					if (content != "#N/A") {
-						// Return rate conversion.
-						value = stod(content);
-					}
-					
-					// Insert parsed data into MonthlyData database.
-					curMonth->addData(symbol, value);
-					++curMonth;
-				}
-				
-				left = ++right;
-				
-			} else {
-				right++;
-			}
-		}
-	}
+	double rate = seconds > 0 ? count / seconds : 0;
 	
-	return allData;
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	
+	cout << fixed << setprecision(3);
+	cout << test << ": " << count << " replications in " << seconds << " s, ";
+	cout << setprecision(1) << rate << " replications/s" << endl;
+	
+	cout.flags(flags);
+	cout.precision(precision);
+
 }
 
 
 /**
  *
- * This funciton accepts processed MonthlyData objects and output file stream to write csv file.
- * 
- * @param outputFile: the output destination file stream for the csv file. 
- *			This function does not check if it is opened, please check in main function.
- * @param allData: processed month data information object with calculated average return rates. 
+ * This function prints command line options, for a wrong option.
  *
  * This function does not return any value.
  *
  */
-void writeCsv(ofstream& outputFile, const list<MonthlyData>& allData) {
+void printUsage() {
 	
-	// All data are generated by prevously appointed csv format.
-	int numMonth = static_cast<int>(allData.size());
+	cout << "Usage: returnCalc [--parser mmap|stream] [--cache] [--long] [--threads N]" << endl;
+	cout << "                  [--buckets N] [--sweep J,K] [--skip S]" << endl;
+	cout << "                  [--state FILE [--append]] [--bootstrap R] [--permutations R]" << endl;
+	cout << "                  [--block L] [--seed S] [--output-dir DIR]" << endl;
+	cout << "                  [--manifest FILE] [--jobs N] [--profile FILE]" << endl;
+	cout << "                  [--format csv|long|jsonl|binary] [--weights FILE]" << endl;
+	cout << "                  [--stats [--window W]] [--groups FILE] [--cost BPS]" << endl;
+	cout << "                  [--out-of-core MB] [--rebalance FREQ]" << endl;
+	cout << "                  [--strategy reversal|momentum] [--legs long-short|long|short]" << endl;
+	cout << "                  [--serve SOCKET] [--result-cache DIR]" << endl;
+	cout << "                  [input file ...]" << endl;
+
+}
+
+
+/**
+ *
+ * This function parses the number given to a numeric option, which must be the
+ * whole text. Counts are unsigned, so "-1" is not taken for a huge count.
+ *
+ * @param option: name of the option, for the error message.
+ * @param text: text given to the option.
+ * @param value: output parameter receiving the number.
+ *
+ * return false after printing the usage if the text is not a number.
+ *
+ */
+template <class Number>
+bool parseNumber(const string& option, const string& text, Number& value) {
 	
-	// Please note latest month is omitted since average cannot be
-	// generated without a later month's data.
-	outputFile << "Period";
-	for (auto curMonth = allData.begin(); curMonth != allData.end(); ++curMonth) {
-		
-		if (curMonth != allData.begin()) {
-			outputFile << "," << curMonth->getYearMonth();
-		}
-		
-	}
-	outputFile << endl;
+	from_chars_result parsed = from_chars(text.data(), text.data() + text.size(), value);
 	
-	outputFile << "Average return of first 10% percentile/each period";
-	for (auto curMonth = allData.begin(); curMonth != allData.end(); ++curMonth) {
-		
-		if (curMonth != allData.begin()) {
-			outputFile << "," << curMonth->getTopTenPercentReturn();
-		}
-		
-	}
-	outputFile << endl;
-	
-	outputFile << "Average return of last 10% percentile/each period";
-	for (auto curMonth = allData.begin(); curMonth != allData.end(); ++curMonth) {
-		
-		if (curMonth != allData.begin()) {
-			outputFile << "," << curMonth->getBottomTenPercentReturn();
-		}
-		
+	if (text.empty() || parsed.ec != errc() || parsed.ptr != text.data() + text.size()) {
+		cout << "Invalid number for " << option << ": " << text << endl;
+		printUsage();
+		return false;
 	}
-	outputFile << endl;
 	
-	double finalAverage = 0;
+	return true;
+
+}
+
+
+/**
+ *
+ * This function creates a directory for output files, unless it already exists.
+ * Parent directories are not created.
+ *
+ * @param directory: path of the directory.
+ *
+ * return true if the directory exists afterwards.
+ *
+ */
+bool makeDirectory(const string& directory) {
 	
-	outputFile << "Total average return/each period";
-	for (auto curMonth = allData.begin(); curMonth != allData.end(); ++curMonth) {
-		
-		if (curMonth != allData.begin()) {
-			outputFile << "," << curMonth->getMonthReturn();
-			finalAverage += curMonth->getMonthReturn();
-		}
-		
-		
+	struct stat info;
+	if (stat(directory.c_str(), &info) == 0) {
+		return S_ISDIR(info.st_mode);
 	}
-	outputFile << endl;
 	
-	for (int i = 1; i < numMonth; i++) {
-		outputFile << ",";
-	}
-	outputFile << endl;
+	return mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+
+}
+
+
+/**
+ *
+ * This function writes performance statistics of all periods and rolling windows
+ * into a csv file.
+ *
+ * @param fileName: path of the file.
+ * @param results: results of every period, in chronological order.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param window: number of months in rolling window, 0 for no rolling statistics.
+ *
+ * return false if the file can't be written.
+ *
+ */
+bool writeStatisticsFile(const string& fileName, const vector<PeriodResult>& results, unsigned long numBuckets, unsigned long window) {
 	
-	finalAverage /= numMonth - 1;
-	outputFile << "Total average return of all period";
-	outputFile << "," << finalAverage;
+	ResultWriter writer;
 	
-	for (int i = 2; i < numMonth; i++) {
-		outputFile << ",";
+	if (!writer.open(fileName)) {
+		return false;
 	}
-	outputFile << endl;
 	
+	writeStatistics(writer, results, numBuckets, window);
+	
+	return writer.close();
+
 }
 
 
+/**
+ *
+ * This function writes turnover and returns net of trading costs of every period
+ * into a csv file.
+ *
+ * @param fileName: path of the file.
+ * @param results: results of every period, in chronological order.
+ * @param numBuckets: number of buckets stocks were split into.
+ * @param allBuckets: whether results of every bucket were calculated.
+ * @param costBps: trading costs in basis points per unit of turnover.
+ * @param strategy: the strategy results were calculated with.
+ *
+ * return false if the file can't be written.
+ *
+ */
+bool writeCostsFile(const string& fileName, const vector<PeriodResult>& results, unsigned long numBuckets, bool allBuckets, double costBps, const Strategy& strategy) {
+	
+	ResultWriter writer;
+	
+	if (!writer.open(fileName)) {
+		return false;
+	}
+	
+	writeCosts(writer, results, numBuckets, allBuckets, costBps, strategy);
+	
+	return writer.close();
+
+}